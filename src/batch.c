@@ -0,0 +1,348 @@
+#include "batch.h"
+#include "process-simulator.h"
+#include "program-cache.h"
+#include "external-catalog.h"
+#include "name-table.h"
+#include "loader.h"
+#include "thread-pool.h"
+#include "random.h"
+#include "sim-alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// inputs shared by the jobs, read-only while the pool runs
+typedef struct
+{
+    BatchManifest *manifest;
+    const SimulationOptions *options;
+    ProgramCache *cache;
+    ExternalCatalog *catalogs; // by BatchJob.catalog
+    int (*vector_tables)[VECTOR_TABLE_SIZE]; // by BatchJob.vectors
+} Batch;
+
+// Function to copy a field of the manifest into a string
+/**
+ * @param field Pointer to the start of the field
+ * @param length Length of the field
+ * @return Heap copy of the field, NULL if it cannot be allocated
+ */
+static char *copy_field(const char *field, size_t length)
+{
+    char *copy = (char *)sim_malloc(length + 1);
+    if (copy != NULL)
+    {
+        memcpy(copy, field, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+// Function to name the system status of a job after its execution log
+/**
+ * "logs/run1.txt" becomes "logs/run1_status.txt", a name without an extension gets "_status" appended.
+ * @param output Execution log name
+ * @return Heap string with the status file name, NULL if it cannot be allocated
+ */
+static char *status_name(const char *output)
+{
+    const char *slash = strrchr(output, '/');
+    const char *dot = strrchr(output, '.');
+    size_t stem = (dot != NULL && (slash == NULL || dot > slash + 1)) ? (size_t)(dot - output) : strlen(output);
+
+    size_t length = strlen(output) + sizeof("_status");
+    char *status = (char *)sim_malloc(length);
+    if (status != NULL)
+    {
+        snprintf(status, length, "%.*s_status%s", (int)stem, output, output + stem);
+    }
+    return status;
+}
+
+// Function to load a batch manifest
+/**
+ * One job per line: "<trace>, <external_files>, <vector_table>, <output>[, <status>]".
+ * @param filename Name of the manifest
+ * @param manifest Pointer to the manifest to fill in
+ * @return 0 on success, -1 on a malformed line (the error is printed)
+ */
+int batch_load_manifest(const char *filename, BatchManifest *manifest)
+{
+    manifest->jobs = NULL;
+    manifest->count = 0;
+    manifest->capacity = 0;
+
+    MappedFile file;
+    if (mapped_file_open(&file, filename) != 0)
+    {
+        printf("Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Scanner scanner;
+    scanner_init(&scanner, &file, filename);
+    int result = 0;
+    while (result == 0 && scanner_next_line(&scanner))
+    {
+        const char *fields[5];
+        size_t lengths[5];
+        int count = 0;
+        for (; count < 4 && result == 0; count++)
+        {
+            if ((count > 0 && scanner_expect(&scanner, ',') != 0) || scanner_field(&scanner, &fields[count], &lengths[count]) != 0)
+            {
+                result = -1;
+            }
+        }
+        if (result == 0 && scanner_accept(&scanner, ','))
+        {
+            result = scanner_field(&scanner, &fields[4], &lengths[4]);
+            count = 5;
+        }
+        if (result != 0 || scanner_end_line(&scanner) != 0)
+        {
+            result = -1;
+            break;
+        }
+
+        if (manifest->count == manifest->capacity)
+        {
+            size_t capacity = (manifest->capacity == 0) ? 16 : manifest->capacity * 2;
+            BatchJob *jobs = (BatchJob *)sim_realloc(manifest->jobs, capacity * sizeof(BatchJob));
+            if (jobs == NULL)
+            {
+                result = scanner_fail(&scanner, "cannot allocate job %zu", manifest->count + 1);
+                break;
+            }
+            manifest->jobs = jobs;
+            manifest->capacity = capacity;
+        }
+
+        BatchJob *job = &manifest->jobs[manifest->count++];
+        memset(job, 0, sizeof(*job));
+        job->trace = copy_field(fields[0], lengths[0]);
+        job->external_files = copy_field(fields[1], lengths[1]);
+        job->vector_table = copy_field(fields[2], lengths[2]);
+        job->output = copy_field(fields[3], lengths[3]);
+        if (job->output != NULL)
+        {
+            job->status = (count == 5) ? copy_field(fields[4], lengths[4]) : status_name(job->output);
+        }
+        if (job->trace == NULL || job->external_files == NULL || job->vector_table == NULL || job->output == NULL || job->status == NULL)
+        {
+            result = scanner_fail(&scanner, "cannot allocate job %zu", manifest->count);
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("Error: %s\n", scanner.error);
+    }
+    else if (manifest->count == 0)
+    {
+        printf("Error: No jobs in %s\n", filename);
+        result = -1;
+    }
+    mapped_file_close(&file);
+    return result;
+}
+
+// Function run by the pool for every job
+/**
+ * @param context Pointer to the batch
+ * @param item Index of the job
+ * @param worker Index of the thread running it
+ */
+static void run_job(void *context, size_t item, unsigned worker)
+{
+    (void)worker;
+    Batch *batch = (Batch *)context;
+    BatchJob *job = &batch->manifest->jobs[item];
+
+    SimulationInputs inputs = {
+        .cache = batch->cache,
+        .catalog = &batch->catalogs[job->catalog],
+        .vector_table = batch->vector_tables[job->vectors],
+    };
+
+    // the report is kept until the end, so the batch output does not depend on the order jobs finish in
+    size_t length = 0;
+    FILE *report = open_memstream(&job->report, &length);
+    if (report == NULL)
+    {
+        job->exit_code = 1; // counted as a failed job, with an empty report
+        return;
+    }
+    job->exit_code = simulation_run(batch->options, &inputs, job->trace, job->output, job->status, job->seed, report);
+    fclose(report);
+}
+
+// Function to run every job of a manifest on a pool of threads
+/**
+ * Each distinct external files and vector table is loaded once, every trace the jobs can EXEC is
+ * parsed once into a shared program cache, which is frozen before the first job starts.
+ * Every job gets its own random stream, split off the batch seed in manifest order, so the jobs of a sweep
+ * over the same files draw different durations; a job's outputs match a single run of its files with --seed
+ * and the seed printed for it.
+ * @param manifest Pointer to the manifest
+ * @param options Pointer to the settings used by every job
+ * @param thread_count Number of threads
+ * @param seed Seed the streams of the jobs are split off
+ * @return 0 if every job succeeded, -1 if an input could not be loaded or a job failed
+ */
+int batch_run(BatchManifest *manifest, const SimulationOptions *options, unsigned thread_count, uint64_t seed)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    ProgramCache cache;
+    int result = program_cache_init(&cache);
+    cache.programs_dir = options->programs_dir;
+
+    // -----------------------------------------------------------
+    // Shared inputs
+    // -----------------------------------------------------------
+
+    NameTable catalog_paths, vector_paths;
+    if (name_table_init(&catalog_paths) != 0)
+    {
+        result = -1;
+    }
+    if (name_table_init(&vector_paths) != 0)
+    {
+        result = -1;
+    }
+    ExternalCatalog *catalogs = (ExternalCatalog *)sim_malloc(manifest->count * sizeof(ExternalCatalog));
+    int (*vector_tables)[VECTOR_TABLE_SIZE] = sim_calloc(manifest->count, sizeof(*vector_tables));
+    if (result != 0 || catalogs == NULL || vector_tables == NULL)
+    {
+        printf("Error: Cannot allocate the shared inputs of %zu jobs\n", manifest->count);
+        result = -1;
+    }
+
+    // a catalog or vector table is loaded by the first job naming it
+    uint32_t catalog_count = 0;
+    for (size_t i = 0; i < manifest->count && result == 0; i++)
+    {
+        BatchJob *job = &manifest->jobs[i];
+
+        job->catalog = name_table_intern(&catalog_paths, job->external_files);
+        uint32_t vector_count = vector_paths.count;
+        job->vectors = name_table_intern(&vector_paths, job->vector_table);
+        if (job->catalog == NAME_NOT_FOUND || job->vectors == NAME_NOT_FOUND)
+        {
+            printf("Error: Cannot allocate the input names of job %zu\n", i + 1);
+            result = -1;
+            break;
+        }
+
+        if (job->catalog == catalog_count)
+        {
+            external_catalog_init(&catalogs[catalog_count++], &cache);
+            result = load_external_files(job->external_files, &catalogs[job->catalog]);
+        }
+        if (result == 0 && job->vectors == vector_count)
+        {
+            // the traces are shared by every job, so they may only use the vectors of the shortest table
+            uint32_t loaded = 0;
+            result = load_vector_table(job->vector_table, vector_tables[job->vectors], &loaded);
+            cache.vector_count = (loaded < cache.vector_count) ? loaded : cache.vector_count;
+        }
+    }
+
+    // every trace and everything it can EXEC is parsed before any thread starts
+    for (size_t i = 0; i < manifest->count && result == 0; i++)
+    {
+        uint32_t trace_id = program_cache_intern(&cache, manifest->jobs[i].trace);
+        if (trace_id == NAME_NOT_FOUND)
+        {
+            printf("Error: Cannot allocate the name of %s\n", manifest->jobs[i].trace);
+            result = -1;
+            break;
+        }
+        result = program_cache_load_all(&cache, trace_id);
+    }
+
+    // -----------------------------------------------------------
+    // Jobs
+    // -----------------------------------------------------------
+
+    size_t failed = 0;
+    uint64_t steals = 0;
+    if (result == 0)
+    {
+        // the streams are split before the pool starts, so a job's seed does not depend on the thread that runs it
+        Rng streams;
+        rng_seed(&streams, seed);
+        for (size_t i = 0; i < manifest->count; i++)
+        {
+            Rng stream;
+            rng_split(&streams, &stream);
+            manifest->jobs[i].seed = rng_next(&stream); // a simulation is started from a seed
+        }
+
+        program_cache_freeze(&cache);
+        Batch batch = {
+            .manifest = manifest,
+            .options = options,
+            .cache = &cache,
+            .catalogs = catalogs,
+            .vector_tables = vector_tables,
+        };
+        steals = thread_pool_run(manifest->count, thread_count, run_job, &batch);
+
+        for (size_t i = 0; i < manifest->count; i++)
+        {
+            BatchJob *job = &manifest->jobs[i];
+            printf("Job %zu: %s -> %s (seed %llu)\n%s", i + 1, job->trace, job->output, (unsigned long long)job->seed, (job->report != NULL) ? job->report : "");
+            if (job->exit_code != 0)
+            {
+                failed++;
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+        program_cache_report(&cache, stdout);
+        printf("Batch: %zu jobs on %u threads in %.3f s, %llu steals, %zu failed\n",
+               manifest->count, (thread_count < manifest->count) ? thread_count : (unsigned)manifest->count, seconds, (unsigned long long)steals, failed);
+    }
+
+    // -----------------------------------------------------------
+    // Cleanup
+    // -----------------------------------------------------------
+
+    for (uint32_t i = 0; i < catalog_count; i++)
+    {
+        external_catalog_free(&catalogs[i]);
+    }
+    name_table_free(&catalog_paths);
+    name_table_free(&vector_paths);
+    sim_free(catalogs);
+    sim_free(vector_tables);
+    program_cache_free(&cache);
+    return (result == 0 && failed == 0) ? 0 : -1;
+}
+
+// Function to free a manifest
+/**
+ * @param manifest Pointer to the manifest
+ */
+void batch_free_manifest(BatchManifest *manifest)
+{
+    for (size_t i = 0; i < manifest->count; i++)
+    {
+        BatchJob *job = &manifest->jobs[i];
+        sim_free(job->trace);
+        sim_free(job->external_files);
+        sim_free(job->vector_table);
+        sim_free(job->output);
+        sim_free(job->status);
+        free(job->report); // written by open_memstream
+    }
+    sim_free(manifest->jobs);
+    manifest->jobs = NULL;
+    manifest->count = 0;
+    manifest->capacity = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include "sim-context.h"
+
+// structs
+
+// one simulation of the batch, a line of the manifest
+typedef struct
+{
+    char *trace;          // trace booted in init
+    char *external_files; // external files of the run (shared with every job naming the same file)
+    char *vector_table;   // vector table of the run (shared the same way)
+    char *output;         // execution log
+    char *status;         // system status (fifth column, or the output name with _status before its extension)
+    uint32_t catalog;     // index of the shared external files
+    uint32_t vectors;     // index of the shared vector table
+    uint64_t seed;        // seed of the job's random stream, split off the batch seed in manifest order
+    char *report;         // end of run report, printed once the whole batch is done
+    int exit_code;        // 0 if the run succeeded
+} BatchJob;
+
+typedef struct
+{
+    BatchJob *jobs;   // jobs in manifest order
+    size_t count;     // number of jobs
+    size_t capacity;  // allocated slots in jobs
+} BatchManifest;
+
+// -----------------------------------------------------------
+
+int batch_load_manifest(const char *filename, BatchManifest *manifest);
+int batch_run(BatchManifest *manifest, const SimulationOptions *options, unsigned thread_count, uint64_t seed);
+void batch_free_manifest(BatchManifest *manifest);
+
+// -----------------------------------------------------------
+
+#endif // BATCH_H
@@ -0,0 +1,560 @@
+#include "checkpoint.h"
+#include "sim-alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -----------------------------------------------------------
+// Saving
+// -----------------------------------------------------------
+
+// Function to round a file offset up to the next section boundary
+/**
+ * @param offset File offset
+ * @return Offset rounded up to a multiple of 8
+ */
+static uint64_t align_section(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// Function to write a section of a checkpoint, after the padding that puts it at its offset
+/**
+ * @param file Checkpoint being written
+ * @param position Pointer to the number of bytes written so far
+ * @param offset Offset of the section
+ * @param data Pointer to the section
+ * @param size Size of the section
+ */
+static void write_section(FILE *file, uint64_t *position, uint64_t offset, const void *data, size_t size)
+{
+    static const char zeros[8] = {0};
+    fwrite(zeros, 1, (size_t)(offset - *position), file);
+    fwrite(data, 1, size, file);
+    *position = offset + size;
+}
+
+// Function to copy a PCB into its checkpoint record
+/**
+ * @param process Pointer to the process
+ * @param partition Index of its partition in address order (CHECKPOINT_NONE for none)
+ * @param record Pointer to the record
+ */
+static void save_process(const PCB *process, uint32_t partition, CheckpointProcess *record)
+{
+    memset(record, 0, sizeof(*record));
+    record->cpu_time = process->cpu_time;
+    record->io_time = process->io_time;
+    record->arrival_time = process->arrival_time;
+    record->ready_since = process->ready_since;
+    record->wake_time = process->wake_time;
+    record->wait_time = process->wait_time;
+    record->ready_key = process->ready_key;
+    record->ready_seq = process->ready_seq;
+    record->pc = process->pc;
+    record->remaining_cpu_time = process->remaining_cpu_time;
+    record->partition_number = process->partition_number;
+    record->program_size = process->program_size;
+    record->program = (process->program != NULL) ? process->program->id : CHECKPOINT_NONE;
+    record->partition = partition;
+    record->pid = process->pid;
+    record->ppid = process->ppid;
+    record->which_syscall = process->which_syscall;
+    record->shares_parent_trace = process->shares_parent_trace;
+    record->state = process->state;
+    record->priority = process->priority;
+    memcpy(record->program_name, process->program_name, sizeof(record->program_name));
+}
+
+// Function to write the whole simulator state to a checkpoint file
+/**
+ * Called between two engine steps. The outputs are not part of the checkpoint, a restored run writes its own.
+ * @param engine Pointer to the engine
+ * @param path Checkpoint file
+ * @return 0 on success, -1 if the state cannot be saved (the error is printed)
+ */
+int checkpoint_save(const Engine *engine, const char *path)
+{
+    const PcbTable *pcbs = engine->pcbs;
+    const MemoryManager *memory = engine->memory;
+    const Scheduler *scheduler = &engine->scheduler;
+    const NameTable *names = &engine->cache->names;
+
+    if (engine->failed)
+    {
+        fprintf(engine->report, "Error: Cannot checkpoint a run that failed\n");
+        return -1;
+    }
+    if (scheduler->core_count != 1)
+    {
+        fprintf(engine->report, "Error: Cannot checkpoint a run on %u cores, only single-core runs are saved\n", scheduler->core_count);
+        return -1;
+    }
+    const RunQueue *queue = &scheduler->queues[0];
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.byte_order = CHECKPOINT_BYTE_ORDER;
+    header.header_size = sizeof(CheckpointHeader);
+    header.process_size = sizeof(CheckpointProcess);
+    header.partition_size = sizeof(CheckpointPartition);
+
+    header.current_time = engine->current_time;
+    header.slice_start = engine->slice_start;
+    header.events = engine->events;
+    memcpy(header.rng, engine->rng.state, sizeof(header.rng));
+    header.current_pid = (engine->current != NULL) ? engine->current->pid : 0;
+    header.last_run_pid = (engine->last_run != NULL) ? engine->last_run->pid : 0;
+
+    header.policy = scheduler->policy;
+    header.quantum = scheduler->quantum;
+    header.sequence = scheduler->sequence;
+    header.dispatches = scheduler->dispatches;
+    header.preemptions = scheduler->preemptions;
+    header.completed = scheduler->completed;
+    header.total_turnaround = scheduler->total_turnaround;
+    header.total_waiting = scheduler->total_waiting;
+    header.total_cpu = scheduler->total_cpu;
+    header.total_io = scheduler->total_io;
+
+    header.next_pid = pcbs->next_pid;
+    header.reaped = pcbs->reaped;
+
+    header.fit = memory->fit;
+    header.variable = memory->variable;
+    header.next_number = memory->next_number;
+    header.allocations = memory->allocations;
+    header.failures = memory->failures;
+    header.releases = memory->releases;
+
+    header.name_count = names->count;
+    for (uint32_t i = 0; i < names->count; i++)
+    {
+        header.names_size += (uint32_t)strlen(names->names[i]) + 1;
+    }
+    header.process_count = (uint32_t)pcbs->live;
+    header.partition_count = (uint32_t)memory->partition_count;
+    header.ready_count = (uint32_t)queue->ready_count;
+    header.blocked_count = (uint32_t)scheduler->blocked_count;
+
+    header.names_offset = align_section(sizeof(header));
+    header.processes_offset = align_section(header.names_offset + header.names_size);
+    header.partitions_offset = align_section(header.processes_offset + (uint64_t)header.process_count * sizeof(CheckpointProcess));
+    header.ready_offset = align_section(header.partitions_offset + (uint64_t)header.partition_count * sizeof(CheckpointPartition));
+    header.blocked_offset = align_section(header.ready_offset + (uint64_t)header.ready_count * sizeof(uint16_t));
+
+    // partitions are saved by index, a process finds its own through the owner pid
+    uint32_t *partition_of = (uint32_t *)sim_malloc(CHECKPOINT_MAX_PIDS * sizeof(uint32_t));
+    if (partition_of == NULL)
+    {
+        fprintf(engine->report, "Error: Cannot allocate the checkpoint of %s\n", path);
+        return -1;
+    }
+    memset(partition_of, 0xff, CHECKPOINT_MAX_PIDS * sizeof(uint32_t)); // CHECKPOINT_NONE
+    header.cursor = CHECKPOINT_NONE;
+    uint32_t index = 0;
+    for (const MemoryPartition *partition = memory->head; partition != NULL; partition = partition->next, index++)
+    {
+        if (memory->cursor == partition)
+        {
+            header.cursor = index;
+        }
+        const PCB *owner = partition->free ? NULL : pcb_table_find(pcbs, partition->owner);
+        if (owner != NULL && owner->partition == partition)
+        {
+            partition_of[owner->pid] = index;
+        }
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(engine->report, "Error: Cannot open checkpoint file %s\n", path);
+        sim_free(partition_of);
+        return -1;
+    }
+
+    uint64_t position = 0;
+    write_section(file, &position, 0, &header, sizeof(header));
+    for (uint32_t i = 0; i < names->count; i++)
+    {
+        write_section(file, &position, (i == 0) ? header.names_offset : position, names->names[i], strlen(names->names[i]) + 1);
+    }
+
+    CheckpointProcess process_record;
+    uint64_t offset = header.processes_offset;
+    for (const PCB *process = pcbs->head; process != NULL; process = process->next)
+    {
+        save_process(process, partition_of[process->pid], &process_record);
+        write_section(file, &position, offset, &process_record, sizeof(process_record));
+        offset = position;
+    }
+
+    CheckpointPartition partition_record;
+    offset = header.partitions_offset;
+    for (const MemoryPartition *partition = memory->head; partition != NULL; partition = partition->next)
+    {
+        memset(&partition_record, 0, sizeof(partition_record));
+        partition_record.start = partition->start;
+        partition_record.partition_number = partition->partition_number;
+        partition_record.size = partition->size;
+        partition_record.used = partition->used;
+        partition_record.region = partition->region;
+        partition_record.owner = partition->owner;
+        partition_record.free = partition->free;
+        memcpy(partition_record.code, partition->code, sizeof(partition_record.code));
+        write_section(file, &position, offset, &partition_record, sizeof(partition_record));
+        offset = position;
+    }
+
+    // the queues are saved in heap order, the pushes of the restore rebuild the same heaps
+    offset = header.ready_offset;
+    for (size_t i = 0; i < queue->ready_count; i++)
+    {
+        write_section(file, &position, offset, &queue->ready[i]->pid, sizeof(uint16_t));
+        offset = position;
+    }
+    offset = header.blocked_offset;
+    for (size_t i = 0; i < scheduler->blocked_count; i++)
+    {
+        write_section(file, &position, offset, &scheduler->blocked[i]->pid, sizeof(uint16_t));
+        offset = position;
+    }
+    write_section(file, &position, align_section(position), "", 0); // every section offset lies inside the file, empty ones too
+
+    sim_free(partition_of);
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed)
+    {
+        fprintf(engine->report, "Error: Cannot write checkpoint file %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------
+// Restoring
+// -----------------------------------------------------------
+
+// Function to check that a section lies inside the checkpoint
+/**
+ * @param length Size of the checkpoint
+ * @param offset Offset of the section
+ * @param count Number of records
+ * @param size Size of a record
+ * @return true if the section is aligned and complete
+ */
+static bool section_fits(size_t length, uint64_t offset, uint32_t count, size_t size)
+{
+    return offset % 8 == 0 && offset <= length && (uint64_t)count * size <= length - offset;
+}
+
+// Function to map a checkpoint file and check its layout
+/**
+ * @param checkpoint Pointer to the checkpoint
+ * @param path Checkpoint file
+ * @param report Stream errors are printed to
+ * @return 0 on success, -1 if the file cannot be read or is not a checkpoint of this build (the error is printed)
+ */
+int checkpoint_open(Checkpoint *checkpoint, const char *path, FILE *report)
+{
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    if (mapped_file_open(&checkpoint->file, path) != 0)
+    {
+        fprintf(report, "Error: Cannot open checkpoint file %s\n", path);
+        return -1;
+    }
+
+    const char *data = checkpoint->file.data;
+    size_t length = checkpoint->file.length;
+    const CheckpointHeader *header = (const CheckpointHeader *)data;
+    if (length < sizeof(CheckpointHeader) || memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0)
+    {
+        fprintf(report, "Error: %s is not a checkpoint\n", path);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+    if (header->version != CHECKPOINT_VERSION || header->byte_order != CHECKPOINT_BYTE_ORDER || header->header_size != sizeof(CheckpointHeader) ||
+        header->process_size != sizeof(CheckpointProcess) || header->partition_size != sizeof(CheckpointPartition))
+    {
+        fprintf(report, "Error: Checkpoint %s was written by another version of the simulator or a host of another byte order\n", path);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+    if (!section_fits(length, header->names_offset, header->names_size, 1) ||
+        !section_fits(length, header->processes_offset, header->process_count, sizeof(CheckpointProcess)) ||
+        !section_fits(length, header->partitions_offset, header->partition_count, sizeof(CheckpointPartition)) ||
+        !section_fits(length, header->ready_offset, header->ready_count, sizeof(uint16_t)) ||
+        !section_fits(length, header->blocked_offset, header->blocked_count, sizeof(uint16_t)) ||
+        header->policy > SCHEDULER_SJF || header->fit > FIT_NEXT || header->process_count == 0 || header->partition_count == 0)
+    {
+        fprintf(report, "Error: Checkpoint %s is truncated or corrupt\n", path);
+        checkpoint_close(checkpoint);
+        return -1;
+    }
+
+    checkpoint->header = header;
+    checkpoint->names = data + header->names_offset;
+    checkpoint->processes = (const CheckpointProcess *)(data + header->processes_offset);
+    checkpoint->partitions = (const CheckpointPartition *)(data + header->partitions_offset);
+    checkpoint->ready = (const uint16_t *)(data + header->ready_offset);
+    checkpoint->blocked = (const uint16_t *)(data + header->blocked_offset);
+    return 0;
+}
+
+// Function to intern the checkpointed program names again, in their saved order
+/**
+ * With the same external files the names get their saved ids back, otherwise the ids are translated.
+ * @param checkpoint Pointer to the checkpoint
+ * @param cache Pointer to the program cache of the restored run
+ * @param ids Array receiving the id of each saved name in the restored run
+ * @return 0 on success, -1 if the names section is corrupt, -2 if a name cannot be interned
+ */
+static int restore_names(const Checkpoint *checkpoint, ProgramCache *cache, uint32_t *ids)
+{
+    const char *name = checkpoint->names;
+    const char *end = name + checkpoint->header->names_size;
+    for (uint32_t i = 0; i < checkpoint->header->name_count; i++)
+    {
+        const char *terminator = memchr(name, '\0', (size_t)(end - name));
+        if (terminator == NULL)
+        {
+            return -1;
+        }
+        ids[i] = program_cache_intern(cache, name);
+        if (ids[i] == NAME_NOT_FOUND)
+        {
+            return -2;
+        }
+        name = terminator + 1;
+    }
+    return 0;
+}
+
+// Function to restore the memory partitions in address order
+/**
+ * @param checkpoint Pointer to the checkpoint
+ * @param memory Pointer to the memory manager (initialized, without partitions)
+ * @param partitions Array receiving the restored partitions by index
+ * @param report Stream errors are printed to
+ * @return 0 on success, -1 if a partition cannot be allocated (the error is printed)
+ */
+static int restore_partitions(const Checkpoint *checkpoint, MemoryManager *memory, MemoryPartition **partitions, FILE *report)
+{
+    const CheckpointHeader *header = checkpoint->header;
+    for (uint32_t i = 0; i < header->partition_count; i++)
+    {
+        const CheckpointPartition *record = &checkpoint->partitions[i];
+        MemoryPartition saved;
+        memset(&saved, 0, sizeof(saved));
+        saved.partition_number = record->partition_number;
+        saved.size = record->size;
+        memcpy(saved.code, record->code, sizeof(saved.code));
+        saved.code[sizeof(saved.code) - 1] = '\0';
+        saved.owner = record->owner;
+        saved.used = record->used;
+        saved.start = record->start;
+        saved.region = record->region;
+        saved.free = record->free != 0;
+        partitions[i] = memory_restore_partition(memory, &saved);
+        if (partitions[i] == NULL)
+        {
+            fprintf(report, "Error: Cannot allocate the restored partitions\n");
+            return -1;
+        }
+    }
+
+    memory->next_number = header->next_number;
+    memory->cursor = (header->cursor < header->partition_count) ? partitions[header->cursor] : NULL;
+    memory->allocations = header->allocations;
+    memory->failures = header->failures;
+    memory->releases = header->releases;
+    return 0;
+}
+
+// Function to restore the PCB table, every process pointing at its program and partition again
+/**
+ * @param checkpoint Pointer to the checkpoint
+ * @param engine Pointer to the engine
+ * @param ids Restored id of each saved program name
+ * @param partitions Restored partitions by index
+ * @return 0 on success, -1 if a process is corrupt or its trace cannot be loaded (the error is printed)
+ */
+static int restore_processes(const Checkpoint *checkpoint, Engine *engine, const uint32_t *ids, MemoryPartition **partitions)
+{
+    const CheckpointHeader *header = checkpoint->header;
+    PcbTable *pcbs = engine->pcbs;
+
+    for (uint32_t i = 0; i < header->process_count; i++)
+    {
+        const CheckpointProcess *record = &checkpoint->processes[i];
+
+        // the init template heads the table, it exists already
+        PCB *process = (i == 0 && record->pid == PCB_TABLE_TEMPLATE_PID) ? pcbs->head : pcb_table_restore(pcbs, record->pid);
+        if (process == NULL || (record->program != CHECKPOINT_NONE && record->program >= header->name_count) ||
+            (record->partition != CHECKPOINT_NONE && record->partition >= header->partition_count))
+        {
+            fprintf(engine->report, "Error: Corrupt checkpoint, process %u cannot be restored\n", record->pid);
+            return -1;
+        }
+
+        process->cpu_time = record->cpu_time;
+        process->io_time = record->io_time;
+        process->arrival_time = record->arrival_time;
+        process->ready_since = record->ready_since;
+        process->wake_time = record->wake_time;
+        process->wait_time = record->wait_time;
+        process->ready_key = record->ready_key;
+        process->ready_seq = record->ready_seq;
+        process->pc = (size_t)record->pc;
+        process->remaining_cpu_time = record->remaining_cpu_time;
+        process->partition_number = record->partition_number;
+        process->program_size = record->program_size;
+        process->partition = (record->partition != CHECKPOINT_NONE) ? partitions[record->partition] : NULL;
+        process->ppid = record->ppid;
+        process->which_syscall = record->which_syscall != 0;
+        process->shares_parent_trace = record->shares_parent_trace != 0;
+        process->state = record->state;
+        process->priority = record->priority;
+        memcpy(process->program_name, record->program_name, sizeof(process->program_name));
+        process->program_name[sizeof(process->program_name) - 1] = '\0';
+
+        // the trace is parsed again (or found in the cache), the position in it comes from the checkpoint
+        process->program = NULL;
+        if (record->program != CHECKPOINT_NONE)
+        {
+            process->program = program_cache_get(engine->cache, ids[record->program]);
+            if (process->program == NULL)
+            {
+                return -1;
+            }
+        }
+    }
+
+    pcbs->next_pid = header->next_pid;
+    pcbs->reaped = header->reaped;
+    return 0;
+}
+
+// Function to put the processes of a queue back in the scheduler
+/**
+ * @param engine Pointer to the engine
+ * @param pids Pids of the queue in saved order
+ * @param count Number of pids
+ * @param blocked true for the blocked queue
+ * @return 0 on success, -1 if a pid is not in the table
+ */
+static int restore_queue(Engine *engine, const uint16_t *pids, uint32_t count, bool blocked)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        PCB *process = pcb_table_find(engine->pcbs, pids[i]);
+        if (process == NULL)
+        {
+            fprintf(engine->report, "Error: Corrupt checkpoint, queued process %u is not in the PCB table\n", pids[i]);
+            return -1;
+        }
+        scheduler_restore(&engine->scheduler, process, blocked);
+    }
+    return 0;
+}
+
+// Function to find the process of a checkpointed engine pointer
+/**
+ * @param engine Pointer to the engine
+ * @param pid Saved pid (0 for none)
+ * @param process Pointer to the restored pointer
+ * @return 0 on success, -1 if the pid is not in the table
+ */
+static int restore_pointer(Engine *engine, uint16_t pid, PCB **process)
+{
+    *process = (pid != 0) ? pcb_table_find(engine->pcbs, pid) : NULL;
+    if (pid != 0 && *process == NULL)
+    {
+        fprintf(engine->report, "Error: Corrupt checkpoint, process %u is not in the PCB table\n", pid);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to load the state of a checkpoint into a fresh engine
+/**
+ * The engine is initialized with the checkpoint's policy and quantum, its PCB table holds only the init
+ * template and its memory manager has the checkpoint's fit policy and no partitions.
+ * @param checkpoint Pointer to the opened checkpoint
+ * @param engine Pointer to the engine
+ * @return 0 on success, -1 if the checkpoint is corrupt or a trace cannot be loaded (the error is printed)
+ */
+int checkpoint_restore(const Checkpoint *checkpoint, Engine *engine)
+{
+    const CheckpointHeader *header = checkpoint->header;
+    uint32_t *ids = (uint32_t *)sim_malloc(((size_t)header->name_count + 1) * sizeof(uint32_t));
+    MemoryPartition **partitions = (MemoryPartition **)sim_malloc(header->partition_count * sizeof(MemoryPartition *));
+    if (ids == NULL || partitions == NULL)
+    {
+        fprintf(engine->report, "Error: Cannot allocate the restore tables\n");
+        sim_free(ids);
+        sim_free(partitions);
+        return -1;
+    }
+
+    int result = restore_names(checkpoint, engine->cache, ids);
+    if (result == -2)
+    {
+        fprintf(engine->report, "Error: Cannot allocate the restored program names\n");
+        result = -1;
+    }
+    else if (result != 0)
+    {
+        fprintf(engine->report, "Error: Corrupt checkpoint, the program names are truncated\n");
+    }
+    if (result == 0)
+    {
+        result = restore_partitions(checkpoint, engine->memory, partitions, engine->report);
+        result = (result == 0) ? restore_processes(checkpoint, engine, ids, partitions) : result;
+    }
+    if (result == 0 && scheduler_reserve(&engine->scheduler, engine->pcbs->live) != 0)
+    {
+        fprintf(engine->report, "Error: Cannot allocate the restored queues\n");
+        result = -1;
+    }
+    result = (result == 0) ? restore_queue(engine, checkpoint->ready, header->ready_count, false) : result;
+    result = (result == 0) ? restore_queue(engine, checkpoint->blocked, header->blocked_count, true) : result;
+    result = (result == 0) ? restore_pointer(engine, header->current_pid, &engine->current) : result;
+    result = (result == 0) ? restore_pointer(engine, header->last_run_pid, &engine->last_run) : result;
+
+    if (result == 0)
+    {
+        Scheduler *scheduler = &engine->scheduler;
+        scheduler->sequence = header->sequence;
+        scheduler->dispatches = header->dispatches;
+        scheduler->queues[0].dispatches = header->dispatches;
+        scheduler->preemptions = header->preemptions;
+        scheduler->completed = header->completed;
+        scheduler->total_turnaround = header->total_turnaround;
+        scheduler->total_waiting = header->total_waiting;
+        scheduler->total_cpu = header->total_cpu;
+        scheduler->total_io = header->total_io;
+
+        engine->current_time = header->current_time;
+        engine->slice_start = header->slice_start;
+        engine->events = header->events;
+        memcpy(engine->rng.state, header->rng, sizeof(engine->rng.state));
+    }
+
+    sim_free(ids);
+    sim_free(partitions);
+    return result;
+}
+
+// Function to unmap a checkpoint
+/**
+ * @param checkpoint Pointer to the checkpoint
+ */
+void checkpoint_close(Checkpoint *checkpoint)
+{
+    mapped_file_close(&checkpoint->file);
+    memset(checkpoint, 0, sizeof(*checkpoint));
+}
@@ -0,0 +1,140 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+// configurations
+#define CHECKPOINT_MAGIC "SIMCKP01"       // first 8 bytes of a checkpoint file
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_BYTE_ORDER 0x01020304u // written in host order, a checkpoint only restores on a host of the same byte order
+#define CHECKPOINT_NONE UINT32_MAX        // no program / partition / cursor
+#define CHECKPOINT_MAX_PIDS 65536         // pids are 16 bits
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "engine.h"
+#include "loader.h"
+
+// structs
+
+// A checkpoint is the header followed by its sections, each one an array of fixed size records starting on an
+// 8 byte boundary. Every field has its natural alignment and there is no implicit padding, so a mapped checkpoint
+// is read in place: the restore never parses or copies the file.
+
+typedef struct
+{
+    char magic[8];               // CHECKPOINT_MAGIC
+    uint32_t version;            // CHECKPOINT_VERSION
+    uint32_t byte_order;         // CHECKPOINT_BYTE_ORDER
+    // engine
+    uint64_t current_time;       // simulated clock (ms)
+    uint64_t slice_start;        // round-robin slice start of the process on the CPU
+    uint64_t events;             // trace events executed so far
+    uint64_t rng[4];             // random duration splits, the restored run draws the same values
+    // scheduler
+    uint64_t sequence;           // ready and blocked queue tie breaker
+    uint64_t dispatches;
+    uint64_t preemptions;
+    uint64_t completed;
+    uint64_t total_turnaround;
+    uint64_t total_waiting;
+    uint64_t total_cpu;
+    uint64_t total_io;
+    // PCB table
+    uint64_t reaped;
+    // memory
+    uint64_t allocations;
+    uint64_t failures;
+    uint64_t releases;
+    // sections (file offsets)
+    uint64_t names_offset;       // program names in id order, each one NUL terminated
+    uint64_t processes_offset;   // CheckpointProcess records in PCB table order (the init template first)
+    uint64_t partitions_offset;  // CheckpointPartition records in address order
+    uint64_t ready_offset;       // uint16_t pids of the ready queue
+    uint64_t blocked_offset;     // uint16_t pids of the blocked queue
+    // record sizes, a checkpoint from another build of the structs is refused
+    uint32_t header_size;
+    uint32_t process_size;
+    uint32_t partition_size;
+    // run settings the state depends on (they replace the command-line ones on restore)
+    uint32_t policy;             // SchedulerPolicy
+    uint32_t quantum;
+    uint32_t fit;                // FitPolicy
+    uint32_t variable;
+    uint32_t next_number;        // partition number handed to the next split
+    uint32_t cursor;             // index of the next fit cursor partition (CHECKPOINT_NONE for none)
+    // section sizes
+    uint32_t name_count;
+    uint32_t names_size;         // bytes of the names section
+    uint32_t process_count;
+    uint32_t partition_count;
+    uint32_t ready_count;
+    uint32_t blocked_count;
+    uint32_t reserved;
+    uint16_t current_pid;        // process on the CPU (0 for none)
+    uint16_t last_run_pid;       // process that had the CPU last (0 for none)
+    uint16_t next_pid;           // next pid handed out by a fork
+    uint16_t padding;
+} CheckpointHeader;
+
+typedef struct
+{
+    uint64_t cpu_time;
+    uint64_t io_time;
+    uint64_t arrival_time;
+    uint64_t ready_since;
+    uint64_t wake_time;
+    uint64_t wait_time;
+    uint64_t ready_key;
+    uint64_t ready_seq;
+    uint64_t pc;                 // trace position, the next event the process executes
+    uint32_t remaining_cpu_time;
+    uint32_t partition_number;
+    uint32_t program_size;
+    uint32_t program;            // program id of the trace being executed (CHECKPOINT_NONE for none)
+    uint32_t partition;          // index of its partition in address order (CHECKPOINT_NONE for none)
+    uint16_t pid;
+    uint16_t ppid;
+    uint8_t which_syscall;
+    uint8_t shares_parent_trace;
+    uint8_t state;
+    uint8_t priority;
+    char program_name[20];
+} CheckpointProcess;
+
+typedef struct
+{
+    uint64_t start;
+    uint32_t partition_number;
+    uint32_t size;
+    uint32_t used;
+    uint32_t region;
+    uint16_t owner;
+    uint8_t free;
+    uint8_t padding;
+    char code[20];
+} CheckpointPartition;
+
+// a checkpoint file opened for a restore, its records point into the mapping
+typedef struct
+{
+    MappedFile file;
+    const CheckpointHeader *header;
+    const char *names;
+    const CheckpointProcess *processes;
+    const CheckpointPartition *partitions;
+    const uint16_t *ready;
+    const uint16_t *blocked;
+} Checkpoint;
+
+// -----------------------------------------------------------
+
+int checkpoint_save(const Engine *engine, const char *path);
+int checkpoint_open(Checkpoint *checkpoint, const char *path, FILE *report);
+int checkpoint_restore(const Checkpoint *checkpoint, Engine *engine);
+void checkpoint_close(Checkpoint *checkpoint);
+
+// -----------------------------------------------------------
+
+#endif // CHECKPOINT_H
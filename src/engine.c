@@ -0,0 +1,1032 @@
+#include "engine.h"
+#include "profile.h"
+#include "sim-alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdint.h>
+
+// -----------------------------------------------------------
+// Execution log
+// -----------------------------------------------------------
+
+// Function to add a step to the execution log, starting now
+/**
+ * @param engine Pointer to the engine
+ * @param record Step to log (time and pid are filled in)
+ */
+static void emit(Engine *engine, LogRecord record)
+{
+    record.time = engine->current_time;
+    record.pid = (engine->current != NULL) ? engine->current->pid : 0;
+    record.core = (engine->cores != NULL) ? (uint8_t)(engine->active + 1) : 0;
+    log_emitter_emit(engine->log, &record);
+}
+
+// Function to log the vector table lookup shared by every interrupt
+/**
+ * @param engine Pointer to the engine
+ * @param vector Vector number
+ */
+static void emit_vector_lookup(Engine *engine, uint8_t vector)
+{
+    emit(engine, (LogRecord){.code = LOG_FIND_VECTOR, .duration = 1, .vector = vector});
+    engine->current_time += 1;
+    emit(engine, (LogRecord){.code = LOG_LOAD_ADDRESS, .duration = 1, .arg = (uint32_t)engine->vector_table[vector]});
+    engine->current_time += 1;
+}
+
+// Function to draw a random part of a duration (the steps of an interrupt split its duration at random)
+/**
+ * @param engine Pointer to the engine
+ * @param duration Duration left to split
+ * @return Uniform value in [0, duration]
+ */
+static uint32_t random_share(Engine *engine, uint32_t duration)
+{
+    return (uint32_t)rng_below(&engine->rng, (uint64_t)duration + 1);
+}
+
+// Function to snapshot the PCB table, followed by the paging counters in a paged run
+/**
+ * @param engine Pointer to the engine
+ */
+static void save_status(Engine *engine)
+{
+    save_system_status(engine->status, engine->current_time, engine->pcbs);
+    if (engine->paging != NULL)
+    {
+        virtual_memory_save_status(engine->paging, engine->status, engine->current_time);
+    }
+}
+
+// -----------------------------------------------------------
+// Processes
+// -----------------------------------------------------------
+
+// Function to give the memory partition (or the frames and page table) of a process back
+/**
+ * @param engine Pointer to the engine
+ * @param process Pointer to the process (a forked child that never exec'd owns no partition)
+ */
+static void release_partition(Engine *engine, PCB *process)
+{
+    if (process->partition != NULL)
+    {
+        memory_release(engine->memory, process->partition);
+        process->partition = NULL;
+    }
+    if (engine->paging != NULL)
+    {
+        virtual_memory_release(engine->paging, process);
+    }
+}
+
+// Function to end a process: free its partition and reap its PCB
+/**
+ * @param engine Pointer to the engine
+ * @param process Pointer to the process
+ */
+static void terminate(Engine *engine, PCB *process)
+{
+    scheduler_exit(&engine->scheduler, process, engine->current_time);
+    release_partition(engine, process);
+
+    // nothing waits on exit in a trace, so the PCB is reaped right away and recycled by the next fork
+    if (engine->last_run == process)
+    {
+        engine->last_run = NULL;
+    }
+    if (engine->current == process)
+    {
+        engine->current = NULL;
+    }
+    // a waiting parent ended by its child may have last run on another core
+    for (uint32_t i = 0; engine->cores != NULL && i < engine->scheduler.core_count; i++)
+    {
+        if (engine->cores[i].last_run == process)
+        {
+            engine->cores[i].last_run = NULL;
+        }
+    }
+    pcb_table_release(engine->pcbs, process);
+}
+
+// Function to hand the shared trace back to the parent of a forked process
+/**
+ * A forked child carries on with its parent's trace while the parent waits. Once the child
+ * execs (or runs off the end of the trace) the parent picks the trace up where the child left it.
+ * @param engine Pointer to the engine
+ * @param process Pointer to the forked process
+ */
+static void return_trace_to_parent(Engine *engine, PCB *process)
+{
+    PCB *child = process;
+    while (process->shares_parent_trace)
+    {
+        // a parent waiting on a shared trace cannot have exited, the lookup always succeeds
+        PCB *parent = pcb_table_find(engine->pcbs, process->ppid);
+        assert(parent != NULL);
+        parent->pc = process->pc;
+        parent->which_syscall = process->which_syscall;
+        process->shares_parent_trace = false;
+
+        // inline scheduling keeps the parent in the ready queue behind the child, everything else wakes it now
+        if (engine->scheduler.policy == SCHEDULER_INLINE)
+        {
+            break;
+        }
+        TraceEvent next;
+        if (program_event(parent->program, parent->pc, &next))
+        {
+            scheduler_ready(&engine->scheduler, parent, engine->current_time);
+            break;
+        }
+
+        // nothing left for the parent either, it ends here and hands the trace on to its own parent
+        if (process != child)
+        {
+            terminate(engine, process);
+        }
+        process = parent;
+    }
+    if (process != child)
+    {
+        terminate(engine, process);
+    }
+}
+
+// Function to leave the CPU idle until a given time
+/**
+ * @param engine Pointer to the engine
+ * @param time Time the CPU has work again
+ */
+static void idle_until(Engine *engine, uint64_t time)
+{
+    emit(engine, (LogRecord){.code = LOG_CPU_IDLE, .duration = (uint32_t)(time - engine->current_time)}); // at most one I/O duration
+    if (engine->cores != NULL)
+    {
+        engine->cores[engine->active].idle += time - engine->current_time;
+    }
+    if (engine->interrupts != NULL)
+    {
+        interrupt_controller_cpu_idle(engine->interrupts, engine->current_time, time);
+    }
+    engine->current_time = time;
+}
+
+// Function to find the time the next blocked process can run again
+/**
+ * @param engine Pointer to the engine
+ * @param time Pointer to the time of the next I/O completion
+ * @return false if no process waits for I/O
+ */
+static bool next_wake(const Engine *engine, uint64_t *time)
+{
+    bool blocked = scheduler_next_wake(&engine->scheduler, time);
+    uint64_t completion;
+    if (engine->interrupts != NULL && interrupt_controller_next_event(engine->interrupts, &completion))
+    {
+        *time = (blocked && *time < completion) ? *time : completion;
+        blocked = true;
+    }
+    return blocked;
+}
+
+// Function to take the interrupts raised by now, most urgent first
+/**
+ * The CPU masks interrupts while it runs a trap: the controller latches what the devices raise meanwhile and
+ * the CPU takes it at the next event boundary. A handler runs in front of the process it interrupts (if any)
+ * and makes the process whose request completed ready.
+ * @param engine Pointer to the engine (with devices)
+ */
+static void service_interrupts(Engine *engine)
+{
+    InterruptController *controller = engine->interrupts;
+    uint64_t *current_time = &engine->current_time;
+    Interrupt interrupt;
+
+    bool latched = interrupt_controller_poll(controller, *current_time) == 0;
+    while (latched && interrupt_controller_take(controller, *current_time, &interrupt))
+    {
+        emit(engine, (LogRecord){.code = LOG_CHECK_PRIORITY, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_CHECK_MASKED, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_SWITCH_KERNEL, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SAVED, .duration = 3});
+        *current_time += 3;
+        emit_vector_lookup(engine, interrupt.vector);
+        emit(engine, (LogRecord){.code = LOG_END_IO, .duration = interrupt.handler});
+        *current_time += interrupt.handler;
+        emit(engine, (LogRecord){.code = LOG_IRET, .duration = 1});
+
+        if (interrupt.pid != 0)
+        {
+            // a process waiting on a request cannot exit, the lookup always succeeds
+            PCB *process = pcb_table_find(engine->pcbs, interrupt.pid);
+            assert(process != NULL && process->state == PROCESS_BLOCKED);
+            scheduler_ready(&engine->scheduler, process, *current_time);
+        }
+        save_status(engine);
+        *current_time += 1;
+
+        // requests completing while the handler ran are latched behind it
+        latched = interrupt_controller_poll(controller, *current_time) == 0;
+    }
+
+    if (!latched)
+    {
+        // the completion is lost and its process would never wake up
+        fprintf(engine->report, "Error: Cannot allocate an interrupt at %llu ms, the run stops here\n", (unsigned long long)*current_time);
+        engine->failed = true;
+    }
+}
+
+// Function to switch the CPU to a dispatched process
+/**
+ * @param engine Pointer to the engine
+ * @param next Pointer to the process (already dispatched by the scheduler)
+ */
+static void switch_to(Engine *engine, PCB *next)
+{
+    if (engine->scheduler.policy != SCHEDULER_INLINE && next != engine->last_run)
+    {
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SWITCH, .duration = 1, .arg = next->pid});
+        engine->current_time += 1;
+    }
+
+    engine->current = next;
+    engine->last_run = next;
+    engine->slice_start = engine->current_time;
+}
+
+// Function to give the CPU to the next ready process
+/**
+ * @param engine Pointer to the engine
+ * @return false if no process is ready or blocked (the simulation is over)
+ */
+static bool dispatch(Engine *engine)
+{
+    Scheduler *scheduler = &engine->scheduler;
+    uint64_t *current_time = &engine->current_time;
+
+    while (scheduler_wake(scheduler, *current_time) != NULL)
+    {
+    }
+
+    PCB *next = scheduler_next(scheduler, *current_time);
+    while (next == NULL)
+    {
+        // nothing ready: idle until the next I/O completes
+        uint64_t wake_time;
+        if (!next_wake(engine, &wake_time))
+        {
+            return false;
+        }
+        idle_until(engine, wake_time);
+        if (engine->interrupts != NULL)
+        {
+            service_interrupts(engine);
+            if (engine->failed)
+            {
+                return false;
+            }
+        }
+        while (scheduler_wake(scheduler, *current_time) != NULL)
+        {
+        }
+        next = scheduler_next(scheduler, *current_time);
+    }
+
+    // a core running behind the others can take a process another core made ready later on its own clock
+    if (next->ready_since > *current_time)
+    {
+        idle_until(engine, next->ready_since);
+    }
+
+    switch_to(engine, next);
+    return true;
+}
+
+// Function to end the current process once it reaches the end of its trace
+/**
+ * @param engine Pointer to the engine
+ * @param process Pointer to the process
+ */
+static void finish(Engine *engine, PCB *process)
+{
+    return_trace_to_parent(engine, process);
+    terminate(engine, process);
+    engine->current = NULL;
+}
+
+// Function to preempt the current process when its round-robin slice is used up
+/**
+ * @param engine Pointer to the engine
+ */
+static void check_quantum(Engine *engine)
+{
+    Scheduler *scheduler = &engine->scheduler;
+    PCB *process = engine->current;
+
+    if (scheduler->policy != SCHEDULER_RR || process == NULL || engine->current_time - engine->slice_start < scheduler->quantum)
+    {
+        return;
+    }
+
+    while (scheduler_wake(scheduler, engine->current_time) != NULL)
+    {
+    }
+
+    if (scheduler->queues[scheduler->core].ready_count == 0)
+    {
+        engine->slice_start = engine->current_time; // nobody to hand the CPU to, start a new slice
+        return;
+    }
+
+    scheduler->preemptions++;
+    scheduler_ready(scheduler, process, engine->current_time);
+    engine->current = NULL;
+}
+
+// -----------------------------------------------------------
+// Events
+// -----------------------------------------------------------
+
+// function to handle the exec event
+/**
+ * @param engine Pointer to the engine
+ * @param process Pointer to the process calling exec
+ * @param program_id Interned name of the program to execute
+ * @param duration Duration of the event
+ */
+static void run_exec(Engine *engine, PCB *process, uint32_t program_id, uint32_t duration)
+{
+    uint64_t *current_time = &engine->current_time;
+    const char *program_name = program_cache_name(engine->cache, program_id);
+    // Check if the current process is not the FIRST call to exec() (init process)
+    bool is_init = process->pid == PCB_TABLE_INIT_PID;
+    int64_t program_size = -1;
+    uint8_t priority = 0;
+
+    // a streamed trace is read front to back once, by the process it was booted in
+    if (process->program != NULL && program_cache_is_streamed(engine->cache, program_id))
+    {
+        fprintf(engine->report, "Error: Program %s is streamed and cannot be executed again\n", program_name);
+        return;
+    }
+
+    if (!(is_init))
+    {
+        // 1. Find the size of the program from the external files (indexed by the interned program name)
+        const ExternalFile *external_file = external_catalog_find(engine->catalog, program_id);
+        if (external_file != NULL)
+        {
+            program_size = external_file->size;
+            priority = external_file->priority;
+        }
+
+        if (program_size == -1)
+        {
+            fprintf(engine->report, "Error: Program %s not found in external files\n", program_name);
+            return;
+        }
+    }
+    else
+    {
+        program_size = 1; // init process size is 1
+    }
+
+    // 2. Load the program into a free partition picked by the fit policy (the partition is marked as occupied with the program name)
+    MemoryPartition *candidate_partition = NULL;
+    if (engine->paging != NULL)
+    {
+        // paged: the old image goes now, the new one starts with no page resident and pages come in as they are touched
+        release_partition(engine, process);
+        if (virtual_memory_map(engine->paging, process, (uint32_t)program_size) != 0)
+        {
+            fprintf(engine->report, "Error: Cannot allocate the page table of program %s, the run stops here\n", program_name);
+            engine->failed = true;
+            return;
+        }
+    }
+    else
+    {
+        candidate_partition = memory_allocate(engine->memory, (uint32_t)program_size, process->pid, program_name);
+        // Check if a suitable partition was found
+        if (candidate_partition == NULL)
+        {
+            fprintf(engine->report, "Error: No suitable partition found for program %s\n", program_name);
+            return;
+        }
+    }
+
+    // Check if the current process is not the FIRST call to exec() (init process)
+    // now that we have all the information we can start the fprintf process
+    if ((!is_init))
+    {
+
+        // Random values for EXEC events THAT match the duration of the event.
+        uint32_t a = random_share(engine, duration);         // load program into memory
+        uint32_t b = random_share(engine, duration - a);     // find partition
+        uint32_t c = random_share(engine, duration - a - b); // mark partition as occupied
+        uint32_t d = duration - a - b - c;                   // update PCB with new information
+
+        emit(engine, (LogRecord){.code = LOG_EXEC_LOAD, .duration = a, .name = program_id, .arg = (uint32_t)program_size});
+        *current_time += a;
+        if (candidate_partition == NULL)
+        {
+            emit(engine, (LogRecord){.code = LOG_PAGE_TABLE, .duration = b + c, .arg = process->page_count});
+            *current_time += b + c;
+        }
+        else
+        {
+            emit(engine, (LogRecord){.code = LOG_FOUND_PARTITION, .duration = b, .partition = candidate_partition->partition_number, .arg = (uint32_t)program_size});
+            *current_time += b;
+            emit(engine, (LogRecord){.code = LOG_PARTITION_OCCUPIED, .duration = c, .partition = candidate_partition->partition_number});
+            *current_time += c;
+        }
+        emit(engine, (LogRecord){.code = LOG_UPDATE_PCB, .duration = d});
+        *current_time += d;
+        emit(engine, (LogRecord){.code = LOG_SCHEDULER_CALLED, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_IRET, .duration = 1});
+    }
+
+    // 3. The old program image goes away
+    if (candidate_partition != NULL)
+    {
+        release_partition(engine, process);
+        process->partition = candidate_partition;
+    }
+
+    // 4. Update the PCB with the new information (a paged image is in no partition)
+    process->partition_number = (candidate_partition != NULL) ? candidate_partition->partition_number : 0;
+    snprintf(process->program_name, sizeof(process->program_name), "%s", (is_init) ? "init" : program_name);
+    process->program_size = (uint32_t)program_size;
+    process->priority = priority;
+
+    if (!is_init)
+    {
+        save_status(engine);
+        *current_time += 1;
+    }
+
+    // 5. The parent gets the rest of the old trace back, it resumes once this program is done
+    return_trace_to_parent(engine, process);
+
+    // 6. Point the process at the parsed trace (loaded on the first EXEC, shared afterwards)
+    process->program = program_cache_get(engine->cache, program_id);
+    if (process->program == NULL)
+    {
+        // the trace cannot be loaded (the error has been printed), the run stops here
+        engine->failed = true;
+        return;
+    }
+    process->pc = 0;
+    process->which_syscall = false;
+}
+
+// Function to make the memory references of a CPU burst in a paged run
+/**
+ * The pages are translated before the burst runs: a TLB miss walks the page table and a page fault brings the
+ * page in, taking the frame of a victim page when none is free.
+ * @param engine Pointer to the engine (paged)
+ * @param process Pointer to the process starting the burst
+ * @param event Pointer to the CPU event
+ */
+static void touch_pages(Engine *engine, PCB *process, const TraceEvent *event)
+{
+    uint64_t *current_time = &engine->current_time;
+
+    // a forked child that has not exec'd yet runs in the image of its nearest ancestor that did
+    // (a parent waiting on a shared trace cannot have exited, so its pid still names it and not a later process)
+    PCB *image = process;
+    while (image->page_table == NULL && image->shares_parent_trace)
+    {
+        image = pcb_table_find(engine->pcbs, image->ppid);
+        assert(image != NULL);
+    }
+    if (image->page_table == NULL)
+    {
+        return;
+    }
+
+    size_t index = process->pc - 1;
+    uint32_t first;
+    uint32_t count = virtual_memory_references(image->page_count, index, event->duration, &first);
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t page = (first + i) % image->page_count;
+        PageAccess access;
+        virtual_memory_access(engine->paging, image, page, index, &access);
+        misses += access.tlb_hit ? 0 : 1;
+        if (access.evicted)
+        {
+            emit(engine, (LogRecord){.code = LOG_PAGE_EVICT, .duration = VIRTUAL_MEMORY_EVICT_TIME, .arg = access.evicted_page, .partition = access.evicted_pid});
+            *current_time += VIRTUAL_MEMORY_EVICT_TIME;
+        }
+        if (access.fault)
+        {
+            emit(engine, (LogRecord){.code = LOG_PAGE_FAULT, .duration = VIRTUAL_MEMORY_FAULT_TIME, .arg = page, .partition = access.frame});
+            *current_time += VIRTUAL_MEMORY_FAULT_TIME;
+        }
+    }
+    emit(engine, (LogRecord){.code = LOG_TLB_LOOKUP, .duration = misses * VIRTUAL_MEMORY_WALK_TIME, .arg = count, .partition = misses});
+    *current_time += misses * VIRTUAL_MEMORY_WALK_TIME;
+}
+
+// Function to execute one trace event of the current process
+/**
+ * @param engine Pointer to the engine
+ * @param event Pointer to the event to execute
+ */
+static void run_event(Engine *engine, const TraceEvent *event)
+{
+    uint64_t *current_time = &engine->current_time;
+    PCB *current_process = engine->current;
+
+    switch (event->type)
+    {
+    case EVENT_CPU:
+    {
+        // a burst cut short by the round-robin quantum resumes with what is left of it
+        uint32_t burst = (current_process->remaining_cpu_time > 0) ? current_process->remaining_cpu_time : event->duration;
+        uint32_t run = burst;
+        if (engine->scheduler.policy == SCHEDULER_RR)
+        {
+            uint64_t used = *current_time - engine->slice_start;
+            uint32_t left = (used < engine->scheduler.quantum) ? engine->scheduler.quantum - (uint32_t)used : 0;
+            run = (burst > left && left > 0) ? left : burst;
+        }
+        if (engine->paging != NULL && current_process->remaining_cpu_time == 0)
+        {
+            touch_pages(engine, current_process, event);
+        }
+        if (engine->interrupts != NULL)
+        {
+            // a request completing during the burst interrupts it, the process carries on once the handler is done
+            uint64_t completion;
+            if (interrupt_controller_next_event(engine->interrupts, &completion) && completion > *current_time && completion - *current_time < run)
+            {
+                run = (uint32_t)(completion - *current_time);
+            }
+        }
+
+        emit(engine, (LogRecord){.code = LOG_CPU_EXECUTION, .duration = run});
+        *current_time += run;
+        current_process->cpu_time += run;
+
+        current_process->remaining_cpu_time = burst - run;
+        if (current_process->remaining_cpu_time > 0)
+        {
+            current_process->pc--; // run the rest of this event on the next dispatch
+        }
+        break;
+    }
+    case EVENT_SYSCALL:
+    {
+        // Random values for the SYSCALL events THAT match the duration of the event.
+        uint32_t duration = event->duration;
+        uint32_t a = random_share(engine, duration);     // for run the ISR
+        uint32_t b = random_share(engine, duration - a); // for transfer data
+        uint32_t c = duration - a - b;                   // check for errors
+
+        emit(engine, (LogRecord){.code = LOG_SWITCH_KERNEL, .duration = 1});
+        *current_time += 1;
+        uint32_t context_time = (uint32_t)rng_below(&engine->rng, 3) + 1; // random context switch time (1-3)
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SAVED, .duration = context_time});
+        *current_time += context_time;
+        emit_vector_lookup(engine, event->vector);
+        emit(engine, (LogRecord){.code = LOG_SYSCALL_ISR, .duration = a});
+        *current_time += a;
+
+        // inline, the CPU also transfers the data and checks for errors; otherwise the ISR only starts
+        // the request and the device does the rest (b + c) while the process waits off the CPU
+        bool blocking = engine->interrupts != NULL || engine->scheduler.policy != SCHEDULER_INLINE;
+        if (!blocking)
+        {
+            // Used to alternate between the two SYSCALL events (display and transfer data)
+            if (current_process->which_syscall)
+            {
+                emit(engine, (LogRecord){.code = LOG_TRANSFER_DISPLAY, .duration = b});
+            }
+            else
+            {
+                emit(engine, (LogRecord){.code = LOG_TRANSFER_DATA, .duration = b});
+            }
+            *current_time += b;
+            emit(engine, (LogRecord){.code = LOG_CHECK_ERRORS, .duration = c});
+            *current_time += c;
+        }
+        current_process->which_syscall = !current_process->which_syscall;
+
+        emit(engine, (LogRecord){.code = LOG_IRET, .duration = 1});
+        save_status(engine);
+        *current_time += 1;
+
+        uint32_t service = b + c; // the device part of the call
+        if (engine->interrupts != NULL)
+        {
+            // the device behind the vector queues the request, its completion interrupt makes the process ready
+            if (interrupt_controller_submit(engine->interrupts, event->vector, current_process->pid, *current_time, service, &current_process->wake_time) != 0)
+            {
+                fprintf(engine->report, "Error: Cannot allocate the request of process %u at %llu ms, the run stops here\n", current_process->pid, (unsigned long long)*current_time);
+                engine->failed = true;
+                break;
+            }
+            current_process->io_time += service;
+            current_process->state = PROCESS_BLOCKED;
+            engine->current = NULL;
+        }
+        else if (blocking)
+        {
+            current_process->io_time += service;
+            scheduler_block(&engine->scheduler, current_process, *current_time + service);
+            engine->current = NULL;
+        }
+        break;
+    }
+    case EVENT_END_IO:
+    {
+        if (engine->interrupts != NULL)
+        {
+            // the device raises it now, the CPU takes it at the event boundary behind any more urgent one
+            if (interrupt_controller_raise(engine->interrupts, event->vector, 0, event->duration, *current_time) != 0)
+            {
+                fprintf(engine->report, "Error: Cannot allocate an interrupt at %llu ms, the run stops here\n", (unsigned long long)*current_time);
+                engine->failed = true;
+            }
+            break;
+        }
+        emit(engine, (LogRecord){.code = LOG_CHECK_PRIORITY, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_CHECK_MASKED, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_SWITCH_KERNEL, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SAVED, .duration = 3});
+        *current_time += 3;
+        emit_vector_lookup(engine, event->vector);
+        emit(engine, (LogRecord){.code = LOG_END_IO, .duration = event->duration});
+        *current_time += event->duration;
+        emit(engine, (LogRecord){.code = LOG_IRET, .duration = 1});
+        save_status(engine);
+        *current_time += 1;
+        break;
+    }
+    case EVENT_FORK:
+    {
+        // "Random" values for FORK events THAT match the duration of the event.
+        uint32_t duration = event->duration;
+        uint32_t a = random_share(engine, duration); // for copy parent PCB to child PCB
+        uint32_t b = duration - a;                   // for scheduler called
+
+        emit(engine, (LogRecord){.code = LOG_SWITCH_KERNEL, .duration = 1});
+        *current_time += 1;
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SAVED, .duration = 3});
+        *current_time += 3;
+        emit_vector_lookup(engine, event->vector);
+        emit(engine, (LogRecord){.code = LOG_FORK_COPY, .duration = a});
+        *current_time += a;
+        emit(engine, (LogRecord){.code = LOG_SCHEDULER_CALLED, .duration = b});
+        *current_time += b;
+        emit(engine, (LogRecord){.code = LOG_IRET, .duration = 1});
+
+        // the queues get room for the child first, so making processes ready or blocking them never allocates
+        PCB *child = (scheduler_reserve(&engine->scheduler, engine->pcbs->live + 1) == 0) ? pcb_table_fork(engine->pcbs, current_process) : NULL;
+        if (child == NULL)
+        {
+            // like a fork returning -1: no child, the parent carries on with the trace
+            fprintf(engine->report, "Error: Fork failed at %llu ms, every pid is in use or the child cannot be allocated\n", (unsigned long long)*current_time);
+            *current_time += 1;
+            break;
+        }
+
+        // the child runs first and carries on with the trace, the parent waits for it
+        if (engine->scheduler.policy == SCHEDULER_INLINE)
+        {
+            scheduler_ready(&engine->scheduler, current_process, *current_time);
+        }
+        else
+        {
+            current_process->state = PROCESS_WAITING;
+        }
+        engine->current = child;
+        child->shares_parent_trace = true;
+        child->partition = NULL; // the child runs in its parent's image until it execs
+        child->page_table = NULL;
+        child->page_count = 0;
+        child->arrival_time = *current_time;
+        child->ready_since = *current_time;
+        child->cpu_time = 0;
+        child->io_time = 0;
+        child->remaining_cpu_time = 0;
+        child->wait_time = 0;
+        scheduler_dispatch(&engine->scheduler, child, *current_time);
+        save_status(engine);
+        *current_time += 1; // insure we take a snapshot of PCB table before we increment time
+        switch_to(engine, child);
+        break;
+    }
+    case EVENT_EXEC:
+    {
+        emit(engine, (LogRecord){.code = LOG_SWITCH_KERNEL, .duration = 1});
+        *current_time += 1;
+        uint32_t context_time = (uint32_t)rng_below(&engine->rng, 3) + 1; // random context switch time (1-3)
+        emit(engine, (LogRecord){.code = LOG_CONTEXT_SAVED, .duration = context_time});
+        *current_time += context_time;
+        emit_vector_lookup(engine, event->vector);
+        run_exec(engine, current_process, event->program_id, event->duration);
+        break;
+    }
+    }
+}
+
+// -----------------------------------------------------------
+// Cores
+// -----------------------------------------------------------
+
+// Function to switch the engine to the core that runs the next step
+/**
+ * Every step goes to the core with the earliest clock among those with something to do: a process on it,
+ * a ready process anywhere (it can steal one), or an I/O completion to idle until. The clocks of the cores
+ * move forward together, each one only when it runs.
+ * @param engine Pointer to the engine (multi-core)
+ * @return false once no core has anything left to do (the clock is left at the end of the run)
+ */
+static bool switch_core(Engine *engine)
+{
+    Scheduler *scheduler = &engine->scheduler;
+    Core *cores = engine->cores;
+
+    // save the registers of the core that ran the last step
+    Core *core = &cores[engine->active];
+    core->current = engine->current;
+    core->last_run = engine->last_run;
+    core->clock = engine->current_time;
+    core->slice_start = engine->slice_start;
+
+    uint64_t wake_time;
+    bool blocked = scheduler_next_wake(scheduler, &wake_time);
+    uint32_t next = scheduler->core_count;
+    uint64_t next_time = UINT64_MAX;
+    uint64_t end_time = 0;
+    for (uint32_t i = 0; i < scheduler->core_count; i++)
+    {
+        uint64_t time = cores[i].clock;
+        end_time = (time > end_time) ? time : end_time;
+        if (cores[i].current == NULL && scheduler->ready_count == 0)
+        {
+            if (!blocked)
+            {
+                continue; // nothing for this core until another one makes a process ready
+            }
+            time = (wake_time > time) ? wake_time : time;
+        }
+        if (time < next_time)
+        {
+            next = i;
+            next_time = time;
+        }
+    }
+
+    if (next == scheduler->core_count)
+    {
+        // the run is over: the clock of the engine is the one of the last core to finish
+        engine->current = NULL;
+        engine->current_time = end_time;
+        return false;
+    }
+
+    core = &cores[next];
+    engine->active = next;
+    scheduler->core = next;
+    engine->current = core->current;
+    engine->last_run = core->last_run;
+    engine->current_time = core->clock;
+    engine->slice_start = core->slice_start;
+    return true;
+}
+
+// Function to print the utilization of every core at the end of a multi-core run
+/**
+ * @param engine Pointer to the engine
+ * @param out Stream to print to
+ */
+void engine_report(const Engine *engine, FILE *out)
+{
+    if (engine->cores == NULL)
+    {
+        return;
+    }
+
+    uint64_t end_time = engine->current_time;
+    for (uint32_t i = 0; i < engine->scheduler.core_count; i++)
+    {
+        const Core *core = &engine->cores[i];
+        const RunQueue *queue = &engine->scheduler.queues[i];
+        uint64_t busy = core->clock - core->idle; // a core that finished early is idle until the end
+        fprintf(out, "Core %u: %.1f%% busy, %llu events, %llu dispatches (%llu stolen), %llu migrated in, idle %llu ms\n", i + 1,
+                (end_time > 0) ? 100.0 * (double)busy / (double)end_time : 0.0, (unsigned long long)core->events, (unsigned long long)queue->dispatches,
+                (unsigned long long)queue->steals, (unsigned long long)queue->migrations, (unsigned long long)(end_time - busy));
+    }
+}
+
+// -----------------------------------------------------------
+// Engine
+// -----------------------------------------------------------
+
+// Function to initialize the engine
+/**
+ * @param engine Pointer to the engine
+ * @param vector_table Pointer to the vector table
+ * @param log Pointer to the execution log emitter
+ * @param catalog Pointer to the external files catalog
+ * @param memory Pointer to the memory manager
+ * @param cache Pointer to the program cache
+ * @param status Pointer to the system status sink
+ * @param pcbs Pointer to the PCB table (init template at its head)
+ * @param policy Scheduling policy
+ * @param quantum Round-robin time slice
+ * @param core_count Number of simulated cores (1 for the original single CPU)
+ * @param seed Seed of the simulation's random stream (equal seeds give identical outputs)
+ * @return 0 on success, -1 if the run queues cannot be allocated (the engine can still be freed)
+ */
+int engine_init(Engine *engine, const int *vector_table, LogEmitter *log, const ExternalCatalog *catalog, MemoryManager *memory, ProgramCache *cache, StatusSink *status, PcbTable *pcbs, SchedulerPolicy policy, uint32_t quantum, uint32_t core_count, uint64_t seed)
+{
+    engine->vector_table = vector_table;
+    engine->log = log;
+    engine->catalog = catalog;
+    engine->memory = memory;
+    engine->cache = cache;
+    engine->status = status;
+
+    engine->pcbs = pcbs;
+    engine->current = NULL;
+    engine->last_run = NULL;
+    int result = scheduler_init(&engine->scheduler, policy, quantum, core_count);
+    engine->current_time = 0;
+    engine->slice_start = 0;
+    engine->events = 0;
+    engine->report = stdout;
+    engine->failed = false;
+    rng_seed(&engine->rng, seed);
+
+    // the boot runs on the first core, the registers of the others start at time 0
+    engine->cores = NULL;
+    engine->active = 0;
+    engine->interrupts = NULL;
+    engine->paging = NULL;
+    if (result == 0 && core_count > 1)
+    {
+        engine->cores = (Core *)sim_calloc(core_count, sizeof(Core));
+        result = (engine->cores != NULL) ? 0 : -1;
+    }
+    return result;
+}
+
+// Function to fork init from the template and exec the top-level trace in it
+/**
+ * @param engine Pointer to the engine
+ * @param program_id Interned name of the trace passed on the command line
+ * @return 0 on success, -1 if init cannot be allocated (nothing has run)
+ */
+int engine_boot(Engine *engine, uint32_t program_id)
+{
+    // Fork the init process (the table only holds the template, so only an allocation can fail)
+    PCB *init = (scheduler_reserve(&engine->scheduler, engine->pcbs->live + 1) == 0) ? pcb_table_fork(engine->pcbs, engine->pcbs->head) : NULL;
+    if (init == NULL)
+    {
+        return -1;
+    }
+    // snapshot the pcb table
+    save_status(engine);
+    // exec the trace in init, the simulation starts with the first event
+    run_exec(engine, init, program_id, 0);
+    if (init->program != NULL)
+    {
+        init->arrival_time = engine->current_time;
+        scheduler_ready(&engine->scheduler, init, engine->current_time);
+    }
+    return 0;
+}
+
+// Function to run a trace directly in a process, without fork and exec
+/**
+ * @param engine Pointer to the engine
+ * @param process Pointer to the process that runs the trace
+ * @param program_id Interned name of the trace
+ */
+void engine_start(Engine *engine, PCB *process, uint32_t program_id)
+{
+    process->program = program_cache_get(engine->cache, program_id);
+    if (process->program == NULL || scheduler_reserve(&engine->scheduler, engine->pcbs->live) != 0)
+    {
+        engine->failed = true;
+        return;
+    }
+    process->pc = 0;
+    process->which_syscall = false;
+    process->arrival_time = engine->current_time;
+    scheduler_ready(&engine->scheduler, process, engine->current_time);
+}
+
+// Function to execute the next trace event
+/**
+ * @param engine Pointer to the engine
+ * @return false once there is no process left to run
+ */
+bool engine_step(Engine *engine)
+{
+    if (engine->failed)
+    {
+        return false;
+    }
+    if (engine->cores != NULL && !switch_core(engine))
+    {
+        return false;
+    }
+
+    if (engine->interrupts != NULL)
+    {
+        service_interrupts(engine);
+        if (engine->failed)
+        {
+            return false;
+        }
+    }
+    if (engine->current == NULL)
+    {
+        PROFILE_START(schedule);
+        bool dispatched = dispatch(engine);
+        PROFILE_STOP(schedule, PROFILE_SCHEDULE);
+        if (!dispatched)
+        {
+            return false;
+        }
+    }
+
+    PCB *process = engine->current;
+    TraceEvent event;
+    if (!program_event(process->program, process->pc, &event))
+    {
+        // end of the trace: the scheduler picks who runs next
+        finish(engine, process);
+        return true;
+    }
+
+    // a streamed trace can drop what came before (the event itself stays, a preempted burst reads it again)
+    program_release(process->program, process->pc);
+    process->pc++;
+    engine->events++;
+    if (engine->cores != NULL)
+    {
+        engine->cores[engine->active].events++;
+    }
+    PROFILE_COUNT(PROFILE_EVENTS, 1);
+    PROFILE_START(event);
+    run_event(engine, &event);
+    PROFILE_STOP(event, PROFILE_EVENT_CPU + event.type);
+    if (engine->failed)
+    {
+        return false;
+    }
+
+    // a process that just ran its last event ends right away instead of on its next dispatch
+    TraceEvent next;
+    if (engine->current == process && !program_event(process->program, process->pc, &next))
+    {
+        finish(engine, process);
+    }
+    check_quantum(engine);
+    return true;
+}
+
+// Function to run the simulation until every process is done
+/**
+ * @param engine Pointer to the engine
+ */
+void engine_run(Engine *engine)
+{
+    while (engine_step(engine))
+    {
+    }
+}
+
+// Function to free the engine state (the PCB table belongs to the caller)
+/**
+ * @param engine Pointer to the engine
+ */
+void engine_free(Engine *engine)
+{
+    scheduler_free(&engine->scheduler);
+    sim_free(engine->cores);
+    engine->cores = NULL;
+    engine->current = NULL;
+}
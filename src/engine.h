@@ -0,0 +1,72 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "process-simulator.h"
+#include "program-cache.h"
+#include "scheduler.h"
+#include "pcb-table.h"
+#include "memory-manager.h"
+#include "external-catalog.h"
+#include "log-emitter.h"
+#include "random.h"
+#include "interrupt-controller.h"
+#include "virtual-memory.h"
+
+// structs
+
+// registers of a simulated core, swapped into the engine while the core runs (multi-core runs only)
+typedef struct
+{
+    PCB *current;            // process on the core, NULL between dispatches
+    PCB *last_run;           // process that had the core last
+    uint64_t clock;          // the core's own simulated clock (ms)
+    uint64_t slice_start;    // time the current process was dispatched (round robin)
+    uint64_t idle;           // ms the core spent idle
+    uint64_t events;         // trace events executed on the core
+} Core;
+
+typedef struct
+{
+    // inputs shared with the rest of the simulator (not owned by the engine)
+    const int *vector_table;
+    LogEmitter *log;
+    const ExternalCatalog *catalog;
+    MemoryManager *memory;
+    ProgramCache *cache;
+    StatusSink *status;
+
+    // simulation state
+    PcbTable *pcbs;          // every live process, headed by the init template
+    PCB *current;            // process on the CPU, NULL between dispatches
+    PCB *last_run;           // process that had the CPU last (context switches are logged when it changes)
+    Scheduler scheduler;     // ready and blocked queues
+    uint64_t current_time;   // simulated clock (ms)
+    uint64_t slice_start;    // time the current process was dispatched (round robin)
+    uint64_t events;         // trace events executed so far
+    Rng rng;                 // random duration splits, private to this simulation
+    Core *cores;             // per-core registers, NULL on a single core (current, last_run, current_time and slice_start are the running core's)
+    uint32_t active;         // core whose registers are loaded
+    InterruptController *interrupts; // devices behind the vectors (--devices), NULL for I/O that completes after a fixed delay
+    VirtualMemory *paging;   // paged memory (--paging), NULL when programs are loaded into partitions
+    FILE *report;            // errors met during the run (stdout unless the caller redirects them)
+    bool failed;             // a trace could not be loaded, the run stops at that EXEC
+} Engine;
+
+// -----------------------------------------------------------
+
+int engine_init(Engine *engine, const int *vector_table, LogEmitter *log, const ExternalCatalog *catalog, MemoryManager *memory, ProgramCache *cache, StatusSink *status, PcbTable *pcbs, SchedulerPolicy policy, uint32_t quantum, uint32_t core_count, uint64_t seed);
+int engine_boot(Engine *engine, uint32_t program_id);
+void engine_start(Engine *engine, PCB *process, uint32_t program_id);
+bool engine_step(Engine *engine);
+void engine_run(Engine *engine);
+void engine_report(const Engine *engine, FILE *out);
+void engine_free(Engine *engine);
+
+// -----------------------------------------------------------
+
+#endif // ENGINE_H
@@ -0,0 +1,86 @@
+#include "external-catalog.h"
+#include "sim-alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Function to initialize an empty catalog
+/**
+ * @param catalog Pointer to the catalog
+ * @param cache Pointer to the program cache the names are interned in
+ */
+void external_catalog_init(ExternalCatalog *catalog, ProgramCache *cache)
+{
+    memset(catalog, 0, sizeof(*catalog));
+    catalog->cache = cache;
+}
+
+// Function to add a program to the catalog
+/**
+ * @param catalog Pointer to the catalog
+ * @param program_name Name of the program
+ * @param size Size of the program (Mb)
+ * @param priority Priority of the program
+ * @return 1 if the program was added, 0 if it was already listed (the first entry wins), -1 if it cannot be stored
+ */
+int external_catalog_add(ExternalCatalog *catalog, const char *program_name, uint32_t size, uint8_t priority)
+{
+    uint32_t id = program_cache_intern(catalog->cache, program_name);
+    if (id == NAME_NOT_FOUND)
+    {
+        return -1;
+    }
+
+    if (id >= catalog->capacity)
+    {
+        // grow to cover every id interned so far, new slots are not listed
+        uint32_t capacity = (catalog->capacity == 0) ? 64 : catalog->capacity;
+        while (capacity <= id)
+        {
+            capacity *= 2;
+        }
+        ExternalFile *files = (ExternalFile *)sim_realloc(catalog->files, capacity * sizeof(ExternalFile));
+        if (files == NULL)
+        {
+            return -1;
+        }
+        catalog->files = files;
+        memset(&catalog->files[catalog->capacity], 0, (capacity - catalog->capacity) * sizeof(ExternalFile));
+        catalog->capacity = capacity;
+    }
+
+    ExternalFile *file = &catalog->files[id];
+    if (file->present)
+    {
+        return 0;
+    }
+    file->size = size;
+    file->priority = priority;
+    file->present = true;
+    catalog->count++;
+    return 1;
+}
+
+// Function to look up a program by its interned id
+/**
+ * @param catalog Pointer to the catalog
+ * @param program_id Interned name of the program (see program_cache_intern)
+ * @return Pointer to the external file, or NULL if the program is not listed
+ */
+const ExternalFile *external_catalog_find(const ExternalCatalog *catalog, uint32_t program_id)
+{
+    if (program_id >= catalog->capacity || !catalog->files[program_id].present)
+    {
+        return NULL;
+    }
+    return &catalog->files[program_id];
+}
+
+// Function to free the catalog
+/**
+ * @param catalog Pointer to the catalog
+ */
+void external_catalog_free(ExternalCatalog *catalog)
+{
+    sim_free(catalog->files);
+    memset(catalog, 0, sizeof(*catalog));
+}
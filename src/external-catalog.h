@@ -0,0 +1,36 @@
+#ifndef EXTERNAL_CATALOG_H
+#define EXTERNAL_CATALOG_H
+
+// includes
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for int types
+#include <stdbool.h> // for bool
+#include "program-cache.h"
+
+// structs
+
+typedef struct
+{
+    uint32_t size;    // program size (Mb)
+    uint8_t priority; // optional third column, 0 (highest) when missing
+    bool present;     // listed in the external files
+} ExternalFile;
+
+typedef struct ExternalCatalog
+{
+    ProgramCache *cache;  // program names are interned in the cache, the program id indexes the catalog
+    ExternalFile *files;  // external files indexed by program id
+    uint32_t capacity;    // allocated slots in files
+    uint32_t count;       // number of listed programs
+} ExternalCatalog;
+
+// -----------------------------------------------------------
+
+void external_catalog_init(ExternalCatalog *catalog, ProgramCache *cache);
+int external_catalog_add(ExternalCatalog *catalog, const char *program_name, uint32_t size, uint8_t priority);
+const ExternalFile *external_catalog_find(const ExternalCatalog *catalog, uint32_t program_id);
+void external_catalog_free(ExternalCatalog *catalog);
+
+// -----------------------------------------------------------
+
+#endif // EXTERNAL_CATALOG_H
@@ -0,0 +1,437 @@
+#include "interrupt-controller.h"
+#include "sim-alloc.h"
+#include "loader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// -----------------------------------------------------------
+// Pending interrupts
+// -----------------------------------------------------------
+
+// Function to order the pending interrupts
+/**
+ * @param a Pointer to the first interrupt
+ * @param b Pointer to the second interrupt
+ * @return true if a is taken before b
+ */
+static bool interrupt_less(const Interrupt *a, const Interrupt *b)
+{
+    return (a->priority != b->priority) ? a->priority < b->priority : a->sequence < b->sequence;
+}
+
+// Function to latch an interrupt until the CPU takes it
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param interrupt Pointer to the interrupt
+ * @return 0 on success, -1 if the heap cannot be grown
+ */
+static int pending_push(InterruptController *controller, const Interrupt *interrupt)
+{
+    if (controller->pending_count == controller->pending_capacity)
+    {
+        size_t capacity = (controller->pending_capacity == 0) ? INTERRUPT_INITIAL_CAPACITY : controller->pending_capacity * 2;
+        Interrupt *pending = (Interrupt *)sim_realloc(controller->pending, capacity * sizeof(Interrupt));
+        if (pending == NULL)
+        {
+            return -1;
+        }
+        controller->pending = pending;
+        controller->pending_capacity = capacity;
+    }
+
+    Interrupt *heap = controller->pending;
+    size_t i = controller->pending_count++;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!interrupt_less(interrupt, &heap[parent]))
+        {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = *interrupt;
+    return 0;
+}
+
+// Function to take the most urgent pending interrupt off the heap
+/**
+ * @param controller Pointer to the interrupt controller (at least one interrupt pending)
+ * @return The interrupt
+ */
+static Interrupt pending_pop(InterruptController *controller)
+{
+    Interrupt *heap = controller->pending;
+    Interrupt first = heap[0];
+    Interrupt last = heap[--controller->pending_count];
+    size_t count = controller->pending_count;
+
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= count)
+        {
+            break;
+        }
+        if (child + 1 < count && interrupt_less(&heap[child + 1], &heap[child]))
+        {
+            child++;
+        }
+        if (!interrupt_less(&heap[child], &last))
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (count > 0)
+    {
+        heap[i] = last;
+    }
+    return first;
+}
+
+// Function to hold an interrupt raised on a masked line
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param interrupt Pointer to the interrupt
+ * @return 0 on success, -1 if the held list cannot be grown
+ */
+static int held_push(InterruptController *controller, const Interrupt *interrupt)
+{
+    if (controller->held_count == controller->held_capacity)
+    {
+        size_t capacity = (controller->held_capacity == 0) ? INTERRUPT_INITIAL_CAPACITY : controller->held_capacity * 2;
+        Interrupt *held = (Interrupt *)sim_realloc(controller->held, capacity * sizeof(Interrupt));
+        if (held == NULL)
+        {
+            return -1;
+        }
+        controller->held = held;
+        controller->held_capacity = capacity;
+    }
+    controller->held[controller->held_count++] = *interrupt;
+    return 0;
+}
+
+// Function to latch the held interrupts of the lines unmasked by a given time
+/**
+ * They keep their raise time and order, so the time they were held counts in their latency.
+ * @param controller Pointer to the interrupt controller
+ * @param time Current time
+ * @return 0 on success, -1 if an interrupt cannot be latched (it stays held)
+ */
+static int release_held(InterruptController *controller, uint64_t time)
+{
+    size_t kept = 0;
+    int result = 0;
+    for (size_t i = 0; i < controller->held_count; i++)
+    {
+        Interrupt *interrupt = &controller->held[i];
+        if (result != 0 || controller->devices[interrupt->vector].masked_until > time)
+        {
+            controller->held[kept++] = *interrupt;
+        }
+        else if (pending_push(controller, interrupt) != 0)
+        {
+            controller->held[kept++] = *interrupt;
+            result = -1;
+        }
+    }
+    controller->held_count = kept;
+    return result;
+}
+
+// -----------------------------------------------------------
+// Controller
+// -----------------------------------------------------------
+
+// Function to initialize the interrupt controller with one idle device per vector
+/**
+ * @param controller Pointer to the interrupt controller
+ */
+void interrupt_controller_init(InterruptController *controller)
+{
+    memset(controller, 0, sizeof(*controller));
+    for (uint32_t vector = 0; vector < VECTOR_TABLE_SIZE; vector++)
+    {
+        controller->devices[vector].priority = (uint8_t)vector; // like a PIC, the lower line is the more urgent one
+        controller->devices[vector].handler = INTERRUPT_DEFAULT_HANDLER;
+    }
+    timer_wheel_init(&controller->completions, 0);
+}
+
+// Function to load the priorities and handler times of the devices from a file
+/**
+ * One device per line: "<vector>, <priority>[, <handler ms>[, <masked until ms>]]", a lower priority value is more
+ * urgent and a line masked until a time holds its interrupts until then. Lines starting with # are comments, vectors
+ * not listed keep their defaults (unmasked).
+ * @param controller Pointer to the interrupt controller
+ * @param filename Name of the file to load
+ * @return 0 on success, -1 if the file cannot be read or a line is malformed (the error is printed)
+ */
+int interrupt_controller_load_devices(InterruptController *controller, const char *filename)
+{
+    MappedFile file;
+    if (mapped_file_open(&file, filename) != 0)
+    {
+        printf("Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Scanner scanner;
+    scanner_init(&scanner, &file, filename);
+    int result = 0;
+    while (result == 0 && scanner_next_line(&scanner))
+    {
+        uint32_t vector;
+        uint32_t priority;
+        uint32_t handler = INTERRUPT_DEFAULT_HANDLER;
+        uint32_t masked_until = 0;
+        result = scanner_uint(&scanner, VECTOR_TABLE_SIZE - 1, &vector);
+        result = (result == 0) ? scanner_expect(&scanner, ',') : result;
+        result = (result == 0) ? scanner_uint(&scanner, UINT8_MAX, &priority) : result;
+        if (result == 0 && scanner_accept(&scanner, ','))
+        {
+            result = scanner_uint(&scanner, UINT32_MAX, &handler);
+            if (result == 0 && scanner_accept(&scanner, ','))
+            {
+                result = scanner_uint(&scanner, UINT32_MAX, &masked_until);
+            }
+        }
+        result = (result == 0) ? scanner_end_line(&scanner) : result;
+
+        if (result == 0)
+        {
+            controller->devices[vector].priority = (uint8_t)priority;
+            controller->devices[vector].handler = handler;
+            interrupt_controller_mask(controller, (uint8_t)vector, masked_until);
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("Error: %s\n", scanner.error);
+    }
+    mapped_file_close(&file);
+    return result;
+}
+
+// Function to hand an I/O request to the device behind a vector
+/**
+ * The device works on it once it is done with the requests before it; its completion interrupt is raised then.
+ * @param controller Pointer to the interrupt controller
+ * @param vector Vector of the device
+ * @param pid Process waiting for the request
+ * @param time Time the request is made
+ * @param service ms the device needs for the request
+ * @param completion Pointer to the time the request completes
+ * @return 0 on success, -1 if the request cannot be queued (nothing changes)
+ */
+int interrupt_controller_submit(InterruptController *controller, uint8_t vector, uint16_t pid, uint64_t time, uint32_t service, uint64_t *completion)
+{
+    Device *device = &controller->devices[vector];
+    uint64_t start = (device->busy_until > time) ? device->busy_until : time;
+    *completion = start + service;
+    if (timer_wheel_add(&controller->completions, *completion, ((uint64_t)vector << 16) | pid) != 0)
+    {
+        return -1;
+    }
+
+    device->busy_until = *completion;
+    device->outstanding++;
+    device->peak_outstanding = (device->outstanding > device->peak_outstanding) ? device->outstanding : device->peak_outstanding;
+    device->requests++;
+    device->busy += service;
+    device->queued += start - time;
+
+    // every device busy from now on is busy up to the horizon, so the union of their busy times only grows past it
+    uint64_t covered = (controller->io_horizon > time) ? controller->io_horizon : time;
+    if (*completion > covered)
+    {
+        controller->io_busy += *completion - covered;
+        controller->io_horizon = *completion;
+    }
+    return 0;
+}
+
+// Function to set the mask bit of a line until a given time
+/**
+ * Interrupts raised on the line before then are held, not latched; the CPU cannot take them until it is unmasked.
+ * @param controller Pointer to the interrupt controller
+ * @param vector Vector of the line
+ * @param until Time the mask bit clears (0 or a past time unmasks the line at the next poll)
+ */
+void interrupt_controller_mask(InterruptController *controller, uint8_t vector, uint64_t until)
+{
+    controller->devices[vector].masked_until = until;
+}
+
+// Function to latch an interrupt raised by a device (or hold it if its line is masked)
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param vector Vector of the device
+ * @param pid Process whose request completed (0 for none)
+ * @param handler ms the handler runs on the CPU
+ * @param time Time the interrupt is raised
+ * @return 0 on success, -1 if the interrupt cannot be latched
+ */
+int interrupt_controller_raise(InterruptController *controller, uint8_t vector, uint16_t pid, uint32_t handler, uint64_t time)
+{
+    Device *device = &controller->devices[vector];
+    Interrupt interrupt = {.raised = time, .sequence = controller->sequence++, .handler = handler, .pid = pid, .vector = vector, .priority = device->priority};
+    if (time < device->masked_until)
+    {
+        if (held_push(controller, &interrupt) != 0)
+        {
+            return -1;
+        }
+        device->held++;
+        controller->held_interrupts++;
+        return 0;
+    }
+    return pending_push(controller, &interrupt);
+}
+
+// Function to raise the completion interrupts of the requests done by a given time and unmask the lines due
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param time Current time
+ * @return 0 on success, -1 if a completion interrupt cannot be latched (its request is lost)
+ */
+int interrupt_controller_poll(InterruptController *controller, uint64_t time)
+{
+    if (controller->held_count > 0 && release_held(controller, time) != 0)
+    {
+        return -1;
+    }
+
+    uint64_t expires;
+    uint64_t payload;
+    while (timer_wheel_expire(&controller->completions, time, &expires, &payload))
+    {
+        uint8_t vector = (uint8_t)(payload >> 16);
+        Device *device = &controller->devices[vector];
+        device->outstanding--;
+        if (interrupt_controller_raise(controller, vector, (uint16_t)payload, device->handler, expires) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to find the time of the next request completion or unmasking of a line with held interrupts
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param time Pointer to the time of the next event
+ * @return false if no request is outstanding and no interrupt is held
+ */
+bool interrupt_controller_next_event(const InterruptController *controller, uint64_t *time)
+{
+    bool found = timer_wheel_next(&controller->completions, time);
+    for (size_t i = 0; i < controller->held_count; i++)
+    {
+        uint64_t unmasked = controller->devices[controller->held[i].vector].masked_until;
+        *time = (found && *time < unmasked) ? *time : unmasked;
+        found = true;
+    }
+    return found;
+}
+
+// Function to hand the most urgent latched interrupt to the CPU
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param time Time the CPU takes it
+ * @param interrupt Pointer to the interrupt taken
+ * @return false if no interrupt is pending
+ */
+bool interrupt_controller_take(InterruptController *controller, uint64_t time, Interrupt *interrupt)
+{
+    if (controller->pending_count == 0)
+    {
+        return false;
+    }
+
+    *interrupt = pending_pop(controller);
+    uint64_t latency = (time > interrupt->raised) ? time - interrupt->raised : 0;
+    controller->delivered++;
+    controller->devices[interrupt->vector].interrupts++;
+    controller->total_latency += latency;
+    controller->max_latency = (latency > controller->max_latency) ? latency : controller->max_latency;
+    if (latency > 0)
+    {
+        controller->late++; // it came in while the CPU was in a trap or a more urgent handler, or its line was masked
+    }
+    return true;
+}
+
+// Function to account for a stretch of CPU idle time in the I/O overlap
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param from Time the CPU went idle
+ * @param to Time it has work again
+ */
+void interrupt_controller_cpu_idle(InterruptController *controller, uint64_t from, uint64_t to)
+{
+    uint64_t busy_until = (controller->io_horizon < to) ? controller->io_horizon : to;
+    if (busy_until > from)
+    {
+        controller->io_only += busy_until - from;
+    }
+}
+
+// Function to print the device, interrupt and I/O overlap statistics
+/**
+ * @param controller Pointer to the interrupt controller
+ * @param end_time Time the run ended
+ * @param out Stream to print to
+ */
+void interrupt_controller_report(const InterruptController *controller, uint64_t end_time, FILE *out)
+{
+    uint64_t requests = 0;
+    uint32_t used = 0;
+    for (uint32_t vector = 0; vector < VECTOR_TABLE_SIZE; vector++)
+    {
+        const Device *device = &controller->devices[vector];
+        if (device->requests == 0 && device->interrupts == 0)
+        {
+            continue;
+        }
+        requests += device->requests;
+        used++;
+        fprintf(out, "Device %u: priority %u, %llu requests, busy %llu ms, queued %llu ms, peak %u outstanding, %llu interrupts (%llu held while masked)\n", vector,
+                device->priority, (unsigned long long)device->requests, (unsigned long long)device->busy, (unsigned long long)device->queued, device->peak_outstanding,
+                (unsigned long long)device->interrupts, (unsigned long long)device->held);
+    }
+
+    const TimerWheel *wheel = &controller->completions;
+    fprintf(out, "Interrupts: %llu delivered on %u vectors, %llu late, %llu held by a masked line, average latency %.1f ms, max %llu ms; %llu requests, timer wheel peak %zu timers, %llu cascades\n",
+            (unsigned long long)controller->delivered, used, (unsigned long long)controller->late, (unsigned long long)controller->held_interrupts,
+            (controller->delivered > 0) ? (double)controller->total_latency / (double)controller->delivered : 0.0, (unsigned long long)controller->max_latency,
+            (unsigned long long)requests, wheel->peak, (unsigned long long)wheel->cascades);
+
+    uint64_t overlap = controller->io_busy - controller->io_only;
+    fprintf(out, "I/O overlap: devices busy %llu ms of %llu ms, %llu ms of it while the CPU worked (%.1f%%)\n", (unsigned long long)controller->io_busy,
+            (unsigned long long)end_time, (unsigned long long)overlap, (controller->io_busy > 0) ? 100.0 * (double)overlap / (double)controller->io_busy : 0.0);
+}
+
+// Function to free the interrupt controller
+/**
+ * @param controller Pointer to the interrupt controller
+ */
+void interrupt_controller_free(InterruptController *controller)
+{
+    timer_wheel_free(&controller->completions);
+    sim_free(controller->pending);
+    sim_free(controller->held);
+    controller->pending = NULL;
+    controller->pending_count = 0;
+    controller->pending_capacity = 0;
+    controller->held = NULL;
+    controller->held_count = 0;
+    controller->held_capacity = 0;
+}
@@ -0,0 +1,86 @@
+#ifndef INTERRUPT_CONTROLLER_H
+#define INTERRUPT_CONTROLLER_H
+
+// configurations
+#define INTERRUPT_DEFAULT_HANDLER 10   // ms the completion handler of a device runs when the devices file does not say
+#define INTERRUPT_INITIAL_CAPACITY 16
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "process-simulator.h"
+#include "timer-wheel.h"
+
+// structs
+
+// simulated device behind one vector, it serves its requests one at a time in the order they came
+typedef struct
+{
+    uint8_t priority;          // lower value, more urgent (the vector number unless the devices file says otherwise)
+    uint32_t handler;          // ms its completion handler runs on the CPU
+    uint64_t busy_until;       // time the device is done with every request submitted so far
+    uint32_t outstanding;      // requests submitted and not completed yet
+    uint64_t masked_until;     // mask bit of the line: set before this time, its interrupts are held until it clears
+
+    // statistics
+    uint64_t requests;         // requests submitted
+    uint64_t busy;             // ms spent serving requests
+    uint64_t queued;           // ms requests waited for the device to be free
+    uint64_t interrupts;       // interrupts delivered for the vector
+    uint64_t held;             // interrupts raised while the line was masked
+    uint32_t peak_outstanding; // most requests outstanding at once
+} Device;
+
+// interrupt latched by the controller until the CPU takes it
+typedef struct
+{
+    uint64_t raised;           // time the device raised it
+    uint64_t sequence;         // raise order, breaks priority ties
+    uint32_t handler;          // ms the handler runs on the CPU
+    uint16_t pid;              // process whose request completed (0 for an interrupt no process waits on)
+    uint8_t vector;
+    uint8_t priority;
+} Interrupt;
+
+typedef struct
+{
+    Device devices[VECTOR_TABLE_SIZE]; // by vector
+    TimerWheel completions;            // outstanding requests by completion time
+    Interrupt *pending;                // binary min-heap on (priority, sequence)
+    size_t pending_count;
+    size_t pending_capacity;
+    Interrupt *held;                   // raised on a masked line, in raise order, moved to pending when it is unmasked
+    size_t held_count;
+    size_t held_capacity;
+    uint64_t sequence;                 // next raise order
+    uint64_t io_horizon;               // time the last busy device becomes free
+
+    // statistics
+    uint64_t delivered;                // interrupts taken by the CPU
+    uint64_t late;                     // of those, taken after they were raised (the CPU was in a trap or the line masked)
+    uint64_t held_interrupts;          // raised on a masked line
+    uint64_t total_latency;            // ms from raise to delivery
+    uint64_t max_latency;
+    uint64_t io_busy;                  // ms at least one device was busy
+    uint64_t io_only;                  // of those, ms the CPU was idle (no overlap)
+} InterruptController;
+
+// -----------------------------------------------------------
+
+void interrupt_controller_init(InterruptController *controller);
+int interrupt_controller_load_devices(InterruptController *controller, const char *filename);
+int interrupt_controller_submit(InterruptController *controller, uint8_t vector, uint16_t pid, uint64_t time, uint32_t service, uint64_t *completion);
+void interrupt_controller_mask(InterruptController *controller, uint8_t vector, uint64_t until);
+int interrupt_controller_raise(InterruptController *controller, uint8_t vector, uint16_t pid, uint32_t handler, uint64_t time);
+int interrupt_controller_poll(InterruptController *controller, uint64_t time);
+bool interrupt_controller_next_event(const InterruptController *controller, uint64_t *time);
+bool interrupt_controller_take(InterruptController *controller, uint64_t time, Interrupt *interrupt);
+void interrupt_controller_cpu_idle(InterruptController *controller, uint64_t from, uint64_t to);
+void interrupt_controller_report(const InterruptController *controller, uint64_t end_time, FILE *out);
+void interrupt_controller_free(InterruptController *controller);
+
+// -----------------------------------------------------------
+
+#endif // INTERRUPT_CONTROLLER_H
@@ -0,0 +1,441 @@
+#include "loader.h"
+#include "sim-alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Function to read a stream that cannot be mapped (pipe, terminal) into the heap
+/**
+ * @param file Pointer to the file to fill in
+ * @param fd Open file descriptor
+ * @return 0 on success, -1 on a read error or if the memory cannot be allocated
+ */
+static int read_unmapped(MappedFile *file, int fd)
+{
+    size_t capacity = 1 << 16;
+    char *data = (char *)sim_malloc(capacity);
+    if (data == NULL)
+    {
+        return -1;
+    }
+    size_t length = 0;
+
+    ssize_t n;
+    while ((n = read(fd, data + length, capacity - length)) > 0)
+    {
+        length += (size_t)n;
+        if (length == capacity)
+        {
+            char *grown = (char *)sim_realloc(data, capacity * 2);
+            if (grown == NULL)
+            {
+                n = -1;
+                break;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+    }
+
+    if (n < 0)
+    {
+        sim_free(data);
+        return -1;
+    }
+
+    file->data = data;
+    file->length = length;
+    file->mapped = false;
+    return 0;
+}
+
+// Function to map a whole input file read-only
+/**
+ * Regular files are mmap'd and read sequentially, anything else is read into memory.
+ * @param file Pointer to the file to fill in
+ * @param path Name of the file to open
+ * @return 0 on success, -1 if the file cannot be opened or read
+ */
+int mapped_file_open(MappedFile *file, const char *path)
+{
+    file->data = NULL;
+    file->length = 0;
+    file->mapped = false;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct stat info;
+    int result = 0;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        // an empty file maps to nothing, mmap rejects a zero length
+        if (info.st_size > 0)
+        {
+            void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                result = -1;
+            }
+            else
+            {
+                madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+                file->data = (const char *)data;
+                file->length = (size_t)info.st_size;
+                file->mapped = true;
+            }
+        }
+    }
+    else
+    {
+        result = read_unmapped(file, fd);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    return result;
+}
+
+// Function to count the lines of a file, so loaders can size their arrays once
+/**
+ * @param file Pointer to the mapped file
+ * @return Number of lines (a last line without a newline counts)
+ */
+size_t mapped_file_lines(const MappedFile *file)
+{
+    size_t lines = 0;
+    const char *cursor = file->data;
+    const char *end = file->data + file->length;
+    while (cursor < end && (cursor = (const char *)memchr(cursor, '\n', (size_t)(end - cursor))) != NULL)
+    {
+        lines++;
+        cursor++;
+    }
+
+    if (file->length > 0 && file->data[file->length - 1] != '\n')
+    {
+        lines++;
+    }
+    return lines;
+}
+
+// Function to unmap (or free) a file
+/**
+ * @param file Pointer to the mapped file
+ */
+void mapped_file_close(MappedFile *file)
+{
+    if (file->mapped)
+    {
+        munmap((void *)file->data, file->length);
+    }
+    else
+    {
+        sim_free((void *)file->data);
+    }
+
+    file->data = NULL;
+    file->length = 0;
+    file->mapped = false;
+}
+
+// -----------------------------------------------------------
+
+// Function to skip spaces and tabs
+/**
+ * @param scanner Pointer to the scanner
+ */
+static void skip_blanks(Scanner *scanner)
+{
+    while (scanner->cursor < scanner->end && (*scanner->cursor == ' ' || *scanner->cursor == '\t'))
+    {
+        scanner->cursor++;
+    }
+}
+
+// Function to check if the scanner is at the end of the current line
+/**
+ * @param scanner Pointer to the scanner
+ * @return true at a newline, a carriage return or the end of the file
+ */
+static bool at_line_end(const Scanner *scanner)
+{
+    return scanner->cursor == scanner->end || *scanner->cursor == '\n' || *scanner->cursor == '\r';
+}
+
+// Function to start scanning a file
+/**
+ * @param scanner Pointer to the scanner
+ * @param file Pointer to the mapped file
+ * @param path Name of the file, for error messages
+ */
+void scanner_init(Scanner *scanner, const MappedFile *file, const char *path)
+{
+    scanner->path = path;
+    scanner->line = 0;
+    scanner->error[0] = '\0';
+    scanner_feed(scanner, file->data, file->length);
+}
+
+// Function to continue scanning in a new buffer of whole lines (streamed files)
+/**
+ * The line count carries on from the previous buffer.
+ * @param scanner Pointer to the scanner
+ * @param data First character of the buffer
+ * @param length Size of the buffer
+ */
+void scanner_feed(Scanner *scanner, const char *data, size_t length)
+{
+    scanner->cursor = data;
+    scanner->end = data + length;
+    scanner->line_start = data;
+}
+
+// Function to move to the start of the next line that holds something
+/**
+ * Blank lines and lines starting with # are skipped.
+ * @param scanner Pointer to the scanner
+ * @return true if a line was found, false at the end of the file
+ */
+bool scanner_next_line(Scanner *scanner)
+{
+    while (scanner->cursor < scanner->end)
+    {
+        scanner->line++;
+        scanner->line_start = scanner->cursor;
+        skip_blanks(scanner);
+
+        if (!at_line_end(scanner) && *scanner->cursor != '#')
+        {
+            return true;
+        }
+
+        // nothing on this line, go past its newline
+        const char *newline = (const char *)memchr(scanner->cursor, '\n', (size_t)(scanner->end - scanner->cursor));
+        scanner->cursor = (newline != NULL) ? newline + 1 : scanner->end;
+    }
+    return false;
+}
+
+// Function to check that nothing but blanks is left on the line and move past it
+/**
+ * @param scanner Pointer to the scanner
+ * @return 0 on success, -1 if there is trailing text
+ */
+int scanner_end_line(Scanner *scanner)
+{
+    skip_blanks(scanner);
+    if (scanner->cursor < scanner->end && *scanner->cursor == '\r')
+    {
+        scanner->cursor++;
+    }
+
+    if (scanner->cursor == scanner->end)
+    {
+        return 0;
+    }
+    if (*scanner->cursor != '\n')
+    {
+        return scanner_fail(scanner, "unexpected '%c' at the end of the line", *scanner->cursor);
+    }
+    scanner->cursor++;
+    return 0;
+}
+
+// Function to scan a keyword made of letters and underscores
+/**
+ * @param scanner Pointer to the scanner
+ * @param word Pointer to the start of the word (a view into the file)
+ * @param length Pointer to the length of the word
+ * @return 0 on success, -1 if there is no word
+ */
+int scanner_word(Scanner *scanner, const char **word, size_t *length)
+{
+    skip_blanks(scanner);
+    const char *start = scanner->cursor;
+    while (scanner->cursor < scanner->end && (*scanner->cursor == '_' || (*scanner->cursor >= 'A' && *scanner->cursor <= 'Z') || (*scanner->cursor >= 'a' && *scanner->cursor <= 'z')))
+    {
+        scanner->cursor++;
+    }
+
+    if (scanner->cursor == start)
+    {
+        return scanner_fail(scanner, "expected a keyword");
+    }
+    *word = start;
+    *length = (size_t)(scanner->cursor - start);
+    return 0;
+}
+
+// Function to scan a free-form field up to the next comma or the end of the line
+/**
+ * Surrounding blanks are not part of the field.
+ * @param scanner Pointer to the scanner
+ * @param field Pointer to the start of the field (a view into the file)
+ * @param length Pointer to the length of the field
+ * @return 0 on success, -1 if the field is empty
+ */
+int scanner_field(Scanner *scanner, const char **field, size_t *length)
+{
+    skip_blanks(scanner);
+    const char *start = scanner->cursor;
+    while (!at_line_end(scanner) && *scanner->cursor != ',')
+    {
+        scanner->cursor++;
+    }
+
+    const char *stop = scanner->cursor;
+    while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t'))
+    {
+        stop--;
+    }
+
+    if (stop == start)
+    {
+        scanner->cursor = start;
+        return scanner_fail(scanner, "expected a name");
+    }
+    *field = start;
+    *length = (size_t)(stop - start);
+    return 0;
+}
+
+// Function to scan a separator that has to be there
+/**
+ * @param scanner Pointer to the scanner
+ * @param c Expected character
+ * @return 0 on success, -1 if the next character is something else
+ */
+int scanner_expect(Scanner *scanner, char c)
+{
+    if (!scanner_accept(scanner, c))
+    {
+        return scanner_fail(scanner, "expected '%c'", c);
+    }
+    return 0;
+}
+
+// Function to scan an optional separator
+/**
+ * @param scanner Pointer to the scanner
+ * @param c Character to accept
+ * @return true if the character was there (and consumed)
+ */
+bool scanner_accept(Scanner *scanner, char c)
+{
+    skip_blanks(scanner);
+    if (scanner->cursor < scanner->end && *scanner->cursor == c)
+    {
+        scanner->cursor++;
+        return true;
+    }
+    return false;
+}
+
+// Function to scan an unsigned decimal number
+/**
+ * @param scanner Pointer to the scanner
+ * @param max Largest value accepted
+ * @param value Pointer to the number
+ * @return 0 on success, -1 if there is no number or it is larger than max
+ */
+int scanner_uint(Scanner *scanner, uint32_t max, uint32_t *value)
+{
+    skip_blanks(scanner);
+    const char *start = scanner->cursor;
+    uint64_t number = 0;
+    while (scanner->cursor < scanner->end && *scanner->cursor >= '0' && *scanner->cursor <= '9')
+    {
+        number = number * 10 + (uint64_t)(*scanner->cursor - '0');
+        if (number > max)
+        {
+            scanner->cursor = start;
+            return scanner_fail(scanner, "number out of range (at most %u)", max);
+        }
+        scanner->cursor++;
+    }
+
+    if (scanner->cursor == start)
+    {
+        return scanner_fail(scanner, "expected a number");
+    }
+    *value = (uint32_t)number;
+    return 0;
+}
+
+// Function to scan a hexadecimal number, with or without a 0x prefix
+/**
+ * @param scanner Pointer to the scanner
+ * @param value Pointer to the number
+ * @return 0 on success, -1 if there is no number or it does not fit 32 bits
+ */
+int scanner_hex(Scanner *scanner, uint32_t *value)
+{
+    skip_blanks(scanner);
+    const char *start = scanner->cursor;
+    if (scanner->end - scanner->cursor > 2 && scanner->cursor[0] == '0' && (scanner->cursor[1] == 'x' || scanner->cursor[1] == 'X'))
+    {
+        scanner->cursor += 2;
+    }
+
+    const char *digits = scanner->cursor;
+    uint64_t number = 0;
+    while (scanner->cursor < scanner->end)
+    {
+        char c = *scanner->cursor;
+        int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (digit < 0)
+        {
+            break;
+        }
+
+        number = number * 16 + (uint64_t)digit;
+        if (number > UINT32_MAX)
+        {
+            scanner->cursor = start;
+            return scanner_fail(scanner, "hexadecimal number out of range");
+        }
+        scanner->cursor++;
+    }
+
+    if (scanner->cursor == digits)
+    {
+        scanner->cursor = start;
+        return scanner_fail(scanner, "expected a hexadecimal number");
+    }
+    *value = (uint32_t)number;
+    return 0;
+}
+
+// Function to record an error at the current position
+/**
+ * Only the first error is kept, the message reads "file:line:column: message".
+ * @param scanner Pointer to the scanner
+ * @param format printf-style format of the message
+ * @return -1, so parsers can return scanner_fail(...)
+ */
+int scanner_fail(Scanner *scanner, const char *format, ...)
+{
+    if (scanner->error[0] != '\0')
+    {
+        return -1;
+    }
+
+    int length = snprintf(scanner->error, sizeof(scanner->error), "%s:%u:%zu: ", scanner->path, scanner->line, (size_t)(scanner->cursor - scanner->line_start) + 1);
+    if (length > 0 && (size_t)length < sizeof(scanner->error))
+    {
+        va_list args;
+        va_start(args, format);
+        vsnprintf(scanner->error + length, sizeof(scanner->error) - (size_t)length, format, args);
+        va_end(args);
+    }
+    return -1;
+}
@@ -0,0 +1,55 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+// configurations
+#define LOADER_MAX_ERROR 512 // longest "file:line:column: message" error
+#define LOADER_MAX_NAME 255  // longest program name in a trace or the external files
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <stdbool.h>
+
+// structs
+
+typedef struct
+{
+    const char *data; // file contents (mapped read-only, or read into memory for pipes)
+    size_t length;    // size of the contents
+    bool mapped;      // true if data is an mmap'd view, false if it was read into the heap
+} MappedFile;
+
+// single pass tokenizer over a mapped file, every token is a view into the file
+typedef struct Scanner
+{
+    const char *path;        // file name used in error messages
+    const char *cursor;      // next character to scan
+    const char *end;         // one past the last character of the file
+    const char *line_start;  // first character of the current line (for the column)
+    uint32_t line;           // current line number, from 1
+    char error[LOADER_MAX_ERROR]; // first error met, "file:line:column: message"
+} Scanner;
+
+// -----------------------------------------------------------
+
+int mapped_file_open(MappedFile *file, const char *path);
+size_t mapped_file_lines(const MappedFile *file);
+void mapped_file_close(MappedFile *file);
+
+// -----------------------------------------------------------
+
+void scanner_init(Scanner *scanner, const MappedFile *file, const char *path);
+void scanner_feed(Scanner *scanner, const char *data, size_t length);
+bool scanner_next_line(Scanner *scanner);
+int scanner_end_line(Scanner *scanner);
+int scanner_word(Scanner *scanner, const char **word, size_t *length);
+int scanner_field(Scanner *scanner, const char **field, size_t *length);
+int scanner_expect(Scanner *scanner, char c);
+bool scanner_accept(Scanner *scanner, char c);
+int scanner_uint(Scanner *scanner, uint32_t max, uint32_t *value);
+int scanner_hex(Scanner *scanner, uint32_t *value);
+int scanner_fail(Scanner *scanner, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// -----------------------------------------------------------
+
+#endif // LOADER_H
@@ -0,0 +1,567 @@
+#include "log-emitter.h"
+#include "sim-alloc.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <stdbool.h>
+#include <time.h>
+
+// -----------------------------------------------------------
+// Rendering
+// -----------------------------------------------------------
+
+// fixed text of every code, the arguments are spliced in by log_format_text
+static const char *const log_texts[LOG_CODE_COUNT] = {
+    [LOG_CPU_EXECUTION] = "CPU execution",
+    [LOG_CPU_IDLE] = "CPU idle",
+    [LOG_CONTEXT_SWITCH] = "context switch to PID ",
+    [LOG_SWITCH_KERNEL] = "switch to kernel mode",
+    [LOG_CONTEXT_SAVED] = "context saved",
+    [LOG_FIND_VECTOR] = "find vector ",
+    [LOG_LOAD_ADDRESS] = "load address 0X",
+    [LOG_SYSCALL_ISR] = "SYSCALL: run the ISR",
+    [LOG_TRANSFER_DATA] = "transfer data",
+    [LOG_TRANSFER_DISPLAY] = "transfer data to display",
+    [LOG_CHECK_ERRORS] = "check for errors",
+    [LOG_IRET] = "IRET",
+    [LOG_CHECK_PRIORITY] = "check priority of interrupt",
+    [LOG_CHECK_MASKED] = "check if masked",
+    [LOG_END_IO] = "END_IO",
+    [LOG_FORK_COPY] = "FORK: copy parent PCB to child PCB",
+    [LOG_SCHEDULER_CALLED] = "scheduler called",
+    [LOG_EXEC_LOAD] = "EXEC: load ",
+    [LOG_FOUND_PARTITION] = "found partition ",
+    [LOG_PARTITION_OCCUPIED] = "partition ",
+    [LOG_UPDATE_PCB] = "updating PCB with new information",
+    [LOG_PAGE_TABLE] = "page table of ",
+    [LOG_TLB_LOOKUP] = "TLB: ",
+    [LOG_PAGE_EVICT] = "page ",
+    [LOG_PAGE_FAULT] = "page fault on page ",
+};
+
+// Function to append a string
+/**
+ * @param out Pointer to the output position
+ * @param text String to append
+ * @return Position after the string
+ */
+static char *put_text(char *out, const char *text)
+{
+    size_t length = strlen(text);
+    memcpy(out, text, length);
+    return out + length;
+}
+
+// Function to append an unsigned decimal number
+/**
+ * @param out Pointer to the output position
+ * @param value Number to append
+ * @return Position after the number
+ */
+static char *put_uint(char *out, uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (count > 0)
+    {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+// Function to append an upper case hexadecimal number, zero padded to 4 digits (like %04X)
+/**
+ * @param out Pointer to the output position
+ * @param value Number to append
+ * @return Position after the number
+ */
+static char *put_hex4(char *out, uint32_t value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char digits[8];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = hex[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+    while (count < 4)
+    {
+        digits[count++] = '0';
+    }
+
+    while (count > 0)
+    {
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+// Function to render a record as a line of the execution log
+/**
+ * @param record Pointer to the record (a code below LOG_CODE_COUNT)
+ * @param name Program name of a LOG_EXEC_LOAD record (ignored otherwise)
+ * @param out Buffer of at least LOG_EMITTER_MAX_RECORD bytes
+ * @return Length of the line (not NUL terminated)
+ */
+size_t log_format_text(const LogRecord *record, const char *name, char *out)
+{
+    char *end = out;
+
+    // "<time>, <duration>, " prefix shared by every line
+    end = put_uint(end, record->time);
+    *end++ = ',';
+    *end++ = ' ';
+    end = put_uint(end, record->duration);
+    *end++ = ',';
+    *end++ = ' ';
+    if (record->core != 0)
+    {
+        // multi-core runs say which core each step ran on
+        end = put_text(end, "core ");
+        end = put_uint(end, record->core);
+        end = put_text(end, ": ");
+    }
+    end = put_text(end, log_texts[record->code]);
+
+    switch (record->code)
+    {
+    case LOG_CONTEXT_SWITCH:
+        end = put_uint(end, record->arg);
+        break;
+    case LOG_FIND_VECTOR:
+        end = put_uint(end, record->vector);
+        end = put_text(end, " in memory position 0x");
+        end = put_hex4(end, (uint32_t)record->vector * 2);
+        break;
+    case LOG_LOAD_ADDRESS:
+        end = put_hex4(end, record->arg);
+        end = put_text(end, " into the PC");
+        break;
+    case LOG_EXEC_LOAD:
+    {
+        size_t length = strlen(name);
+        if (length > LOG_EMITTER_MAX_NAME)
+        {
+            length = LOG_EMITTER_MAX_NAME;
+        }
+        memcpy(end, name, length);
+        end += length;
+        end = put_text(end, " of size ");
+        end = put_uint(end, record->arg);
+        end = put_text(end, "Mb");
+        break;
+    }
+    case LOG_FOUND_PARTITION:
+        end = put_uint(end, record->partition);
+        end = put_text(end, " with ");
+        end = put_uint(end, record->arg);
+        end = put_text(end, "Mb of space");
+        break;
+    case LOG_PARTITION_OCCUPIED:
+        end = put_uint(end, record->partition);
+        end = put_text(end, " marked as occupied");
+        break;
+    case LOG_PAGE_TABLE:
+        end = put_uint(end, record->arg);
+        end = put_text(end, " pages created");
+        break;
+    case LOG_TLB_LOOKUP:
+        end = put_uint(end, record->arg);
+        end = put_text(end, " references, ");
+        end = put_uint(end, record->partition);
+        end = put_text(end, " misses");
+        break;
+    case LOG_PAGE_EVICT:
+        end = put_uint(end, record->arg);
+        end = put_text(end, " of PID ");
+        end = put_uint(end, record->partition);
+        end = put_text(end, " evicted");
+        break;
+    case LOG_PAGE_FAULT:
+        end = put_uint(end, record->arg);
+        end = put_text(end, ", loaded into frame ");
+        end = put_uint(end, record->partition);
+        break;
+    default:
+        break;
+    }
+
+    *end++ = '\n';
+    return (size_t)(end - out);
+}
+
+// -----------------------------------------------------------
+// Binary format
+// -----------------------------------------------------------
+
+// Function to store a little endian integer
+/**
+ * @param out Pointer to the output bytes
+ * @param value Value to store
+ * @param bytes Width of the value in bytes
+ */
+static void put_le(uint8_t *out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+// Function to load a little endian integer
+/**
+ * @param in Pointer to the input bytes
+ * @param bytes Width of the value in bytes
+ * @return Value loaded
+ */
+static uint64_t get_le(const uint8_t *in, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// Function to write the header of a binary file
+/**
+ * @param kind What the file holds (execution log or system status)
+ * @param out Buffer of at least LOG_BINARY_HEADER_SIZE bytes
+ * @return Size of the header
+ */
+size_t log_encode_header(LogKind kind, uint8_t *out)
+{
+    memcpy(out, LOG_BINARY_MAGIC, 8);
+    put_le(out + 8, (uint64_t)kind, 4);
+    put_le(out + 12, LOG_BINARY_RECORD_SIZE, 4);
+    return LOG_BINARY_HEADER_SIZE;
+}
+
+// Function to check the header of a binary file
+/**
+ * @param in Pointer to the start of the file
+ * @param length Size of the file
+ * @param kind Pointer to what the file holds
+ * @return 0 on success, -1 if this is not a binary file this version can read
+ */
+int log_decode_header(const uint8_t *in, size_t length, LogKind *kind)
+{
+    if (length < LOG_BINARY_HEADER_SIZE || memcmp(in, LOG_BINARY_MAGIC, 8) != 0 || get_le(in + 12, 4) != LOG_BINARY_RECORD_SIZE)
+    {
+        return -1;
+    }
+
+    uint64_t value = get_le(in + 8, 4);
+    if (value != LOG_KIND_EXECUTION && value != LOG_KIND_STATUS)
+    {
+        return -1;
+    }
+    *kind = (LogKind)value;
+    return 0;
+}
+
+// Function to pack a record into its binary form
+/**
+ * @param record Pointer to the record
+ * @param out Buffer of at least LOG_BINARY_MAX_RECORD bytes
+ * @return Number of bytes written (one record, or two when the step has arguments)
+ */
+size_t log_encode_record(const LogRecord *record, uint8_t *out)
+{
+    // binary-only records always carry their arguments, log steps only when they have some
+    bool arguments = record->code >= LOG_CODE_COUNT || (record->arg | record->name | record->partition | record->core) != 0;
+
+    put_le(out, record->time, 8);
+    put_le(out + 8, record->duration, 4);
+    put_le(out + 12, record->pid, 2);
+    out[14] = (uint8_t)(record->code | (arguments ? LOG_BINARY_ARGUMENTS : 0));
+    out[15] = (uint8_t)record->vector;
+    if (!arguments)
+    {
+        return LOG_BINARY_RECORD_SIZE;
+    }
+
+    put_le(out + 16, record->arg, 4);
+    put_le(out + 20, record->name, 4);
+    put_le(out + 24, record->partition, 4);
+    put_le(out + 28, record->core, 4);
+    return 2 * LOG_BINARY_RECORD_SIZE;
+}
+
+// Function to unpack a binary record
+/**
+ * @param in Pointer to the record
+ * @param length Bytes left in the file from the record on
+ * @param record Pointer to the unpacked record
+ * @return Number of bytes read, 0 if the record is truncated
+ */
+size_t log_decode_record(const uint8_t *in, size_t length, LogRecord *record)
+{
+    if (length < LOG_BINARY_RECORD_SIZE)
+    {
+        return 0;
+    }
+
+    memset(record, 0, sizeof(*record));
+    record->time = get_le(in, 8);
+    record->duration = (uint32_t)get_le(in + 8, 4);
+    record->pid = (uint32_t)get_le(in + 12, 2);
+    record->code = in[14] & ~LOG_BINARY_ARGUMENTS;
+    record->vector = in[15];
+    if (!(in[14] & LOG_BINARY_ARGUMENTS))
+    {
+        return LOG_BINARY_RECORD_SIZE;
+    }
+
+    if (length < 2 * LOG_BINARY_RECORD_SIZE)
+    {
+        return 0;
+    }
+    record->arg = (uint32_t)get_le(in + 16, 4);
+    record->name = (uint32_t)get_le(in + 20, 4);
+    record->partition = (uint32_t)get_le(in + 24, 4);
+    record->core = (uint8_t)get_le(in + 28, 4);
+    return 2 * LOG_BINARY_RECORD_SIZE;
+}
+
+// Function to write a string table entry: a LOG_DEFINE_NAME record followed by the name padded to whole records
+/**
+ * @param id Id the name is referred to by
+ * @param name Name (truncated to LOG_EMITTER_MAX_NAME bytes)
+ * @param out Buffer of at least LOG_BINARY_MAX_NAME_RECORD bytes
+ * @return Number of bytes written
+ */
+size_t log_encode_name(uint32_t id, const char *name, uint8_t *out)
+{
+    size_t length = strlen(name);
+    if (length > LOG_EMITTER_MAX_NAME)
+    {
+        length = LOG_EMITTER_MAX_NAME;
+    }
+
+    LogRecord record = {.code = LOG_DEFINE_NAME, .arg = id, .duration = (uint32_t)length};
+    size_t size = log_encode_record(&record, out);
+
+    size_t padded = (length + LOG_BINARY_RECORD_SIZE - 1) / LOG_BINARY_RECORD_SIZE * LOG_BINARY_RECORD_SIZE;
+    memset(out + size, 0, padded);
+    memcpy(out + size, name, length);
+    return size + padded;
+}
+
+// -----------------------------------------------------------
+// Emitter
+// -----------------------------------------------------------
+
+// Function to copy bytes into the ring buffer, flushing first if they do not fit
+/**
+ * @param emitter Pointer to the emitter
+ * @param data Pointer to the bytes
+ * @param length Number of bytes (never more than the ring)
+ */
+static void ring_append(LogEmitter *emitter, const void *data, size_t length)
+{
+    if (emitter->capacity - emitter->length < length)
+    {
+        log_emitter_flush(emitter);
+    }
+
+    // the bytes may wrap around the end of the ring
+    size_t tail = (emitter->head + emitter->length) % emitter->capacity;
+    size_t first = emitter->capacity - tail;
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(emitter->ring + tail, data, first);
+    memcpy(emitter->ring, (const char *)data + first, length - first);
+
+    emitter->length += length;
+}
+
+// Function to open the execution log, called once at startup
+/**
+ * @param emitter Pointer to the emitter to initialize
+ * @param path Path of the execution log (truncated on open)
+ * @param names Pointer to the name table program names are looked up in
+ * @param format Text lines or binary records
+ * @return 0 on success, -1 on failure
+ */
+int log_emitter_open(LogEmitter *emitter, const char *path, const NameTable *names, LogFormat format)
+{
+    memset(emitter, 0, sizeof(*emitter));
+    emitter->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (emitter->fd < 0)
+    {
+        return -1;
+    }
+
+    emitter->ring = (char *)sim_malloc(LOG_EMITTER_BUFFER_SIZE);
+    if (emitter->ring == NULL)
+    {
+        close(emitter->fd);
+        emitter->fd = -1;
+        return -1;
+    }
+
+    emitter->capacity = LOG_EMITTER_BUFFER_SIZE;
+    emitter->names = names;
+    emitter->format = format;
+
+    if (format == LOG_FORMAT_BINARY)
+    {
+        uint8_t header[LOG_BINARY_HEADER_SIZE];
+        ring_append(emitter, header, log_encode_header(LOG_KIND_EXECUTION, header));
+    }
+    return 0;
+}
+
+// Function to add a binary record, preceded by the string table entry of a name seen for the first time
+/**
+ * A name the defined table cannot grow to hold is written again before every use (readers take the last definition).
+ * @param emitter Pointer to the emitter
+ * @param record Pointer to the record
+ */
+static void emit_binary(LogEmitter *emitter, const LogRecord *record)
+{
+    if (record->code == LOG_EXEC_LOAD)
+    {
+        if (record->name >= emitter->defined_count)
+        {
+            uint32_t count = (emitter->defined_count == 0) ? 64 : emitter->defined_count;
+            while (count <= record->name)
+            {
+                count *= 2;
+            }
+            uint8_t *defined = (uint8_t *)sim_realloc(emitter->defined, count);
+            if (defined != NULL)
+            {
+                memset(defined + emitter->defined_count, 0, count - emitter->defined_count);
+                emitter->defined = defined;
+                emitter->defined_count = count;
+            }
+        }
+
+        bool tracked = record->name < emitter->defined_count;
+        if (!tracked || !emitter->defined[record->name])
+        {
+            uint8_t entry[LOG_BINARY_MAX_NAME_RECORD];
+            ring_append(emitter, entry, log_encode_name(record->name, name_table_get(emitter->names, record->name), entry));
+            if (tracked)
+            {
+                emitter->defined[record->name] = 1;
+            }
+        }
+    }
+
+    uint8_t bytes[LOG_BINARY_MAX_RECORD];
+    ring_append(emitter, bytes, log_encode_record(record, bytes));
+}
+
+// Function to add a record to the ring buffer
+/**
+ * @param emitter Pointer to the emitter
+ * @param record Pointer to the record
+ */
+void log_emitter_emit(LogEmitter *emitter, const LogRecord *record)
+{
+    emitter->records++;
+
+    if (emitter->format == LOG_FORMAT_BINARY)
+    {
+        emit_binary(emitter, record);
+        return;
+    }
+
+    char line[LOG_EMITTER_MAX_RECORD];
+    const char *name = (record->code == LOG_EXEC_LOAD) ? name_table_get(emitter->names, record->name) : NULL;
+    ring_append(emitter, line, log_format_text(record, name, line));
+}
+
+// Function to write the ring buffer out with one writev per wrap
+/**
+ * @param emitter Pointer to the emitter
+ */
+void log_emitter_flush(LogEmitter *emitter)
+{
+    // the clock is read only for --timing, so a normal run makes no clock calls here
+    struct timespec start, end;
+    if (emitter->timing)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    PROFILE_START(write);
+
+    while (emitter->length > 0)
+    {
+        // the unwritten bytes are at most two pieces: head to the end of the ring, then the start of the ring
+        struct iovec pieces[2];
+        int count = 1;
+        size_t first = emitter->capacity - emitter->head;
+        if (first >= emitter->length)
+        {
+            first = emitter->length;
+        }
+        else
+        {
+            pieces[1].iov_base = emitter->ring;
+            pieces[1].iov_len = emitter->length - first;
+            count = 2;
+        }
+        pieces[0].iov_base = emitter->ring + emitter->head;
+        pieces[0].iov_len = first;
+
+        ssize_t written = writev(emitter->fd, pieces, count);
+        emitter->writes++;
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            emitter->length = 0; // nothing sensible left to do (disk full, closed pipe, ...)
+            break;
+        }
+        emitter->head = (emitter->head + (size_t)written) % emitter->capacity;
+        emitter->length -= (size_t)written;
+        PROFILE_COUNT(PROFILE_LOG_BYTES, written);
+    }
+    PROFILE_STOP(write, PROFILE_LOG_WRITE);
+
+    if (emitter->timing)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        emitter->write_ns += (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+    }
+}
+
+// Function to write out the remaining records and close the execution log
+/**
+ * @param emitter Pointer to the emitter
+ */
+void log_emitter_close(LogEmitter *emitter)
+{
+    if (emitter->fd < 0)
+    {
+        return;
+    }
+
+    log_emitter_flush(emitter);
+    close(emitter->fd);
+    sim_free(emitter->ring);
+    sim_free(emitter->defined);
+    emitter->fd = -1;
+    emitter->ring = NULL;
+    emitter->defined = NULL;
+}
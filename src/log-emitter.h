@@ -0,0 +1,123 @@
+#ifndef LOG_EMITTER_H
+#define LOG_EMITTER_H
+
+// configurations
+#define LOG_EMITTER_BUFFER_SIZE (1 << 20) // 1 MiB ring buffer
+#define LOG_EMITTER_MAX_NAME 255          // longest program name rendered in a record
+#define LOG_EMITTER_MAX_RECORD 384        // longest single rendered record
+#define LOG_BINARY_MAGIC "SIMBIN01"       // first 8 bytes of a binary output file
+#define LOG_BINARY_HEADER_SIZE 16         // magic, u32 kind, u32 record size
+#define LOG_BINARY_RECORD_SIZE 16         // binary records and their argument records, little endian
+#define LOG_BINARY_ARGUMENTS 0x80         // code bit: an argument record follows
+#define LOG_BINARY_MAX_RECORD (2 * LOG_BINARY_RECORD_SIZE)                      // record and its argument record
+#define LOG_BINARY_MAX_NAME_RECORD (LOG_BINARY_MAX_RECORD + LOG_EMITTER_MAX_NAME + 1) // name definition and the padded name
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <stdbool.h> // for bool
+#include "name-table.h"
+
+// structs
+
+// one code per kind of line in the execution log
+typedef enum
+{
+    LOG_CPU_EXECUTION,      // "CPU execution"
+    LOG_CPU_IDLE,           // "CPU idle"
+    LOG_CONTEXT_SWITCH,     // "context switch to PID <arg>"
+    LOG_SWITCH_KERNEL,      // "switch to kernel mode"
+    LOG_CONTEXT_SAVED,      // "context saved"
+    LOG_FIND_VECTOR,        // "find vector <vector> in memory position <vector * 2>"
+    LOG_LOAD_ADDRESS,       // "load address <arg> into the PC"
+    LOG_SYSCALL_ISR,        // "SYSCALL: run the ISR"
+    LOG_TRANSFER_DATA,      // "transfer data"
+    LOG_TRANSFER_DISPLAY,   // "transfer data to display"
+    LOG_CHECK_ERRORS,       // "check for errors"
+    LOG_IRET,               // "IRET"
+    LOG_CHECK_PRIORITY,     // "check priority of interrupt"
+    LOG_CHECK_MASKED,       // "check if masked"
+    LOG_END_IO,             // "END_IO"
+    LOG_FORK_COPY,          // "FORK: copy parent PCB to child PCB"
+    LOG_SCHEDULER_CALLED,   // "scheduler called"
+    LOG_EXEC_LOAD,          // "EXEC: load <name> of size <arg>Mb"
+    LOG_FOUND_PARTITION,    // "found partition <partition> with <arg>Mb of space"
+    LOG_PARTITION_OCCUPIED, // "partition <partition> marked as occupied"
+    LOG_UPDATE_PCB,         // "updating PCB with new information"
+    LOG_PAGE_TABLE,         // "page table of <arg> pages created"
+    LOG_TLB_LOOKUP,         // "TLB: <arg> references, <partition> misses"
+    LOG_PAGE_EVICT,         // "page <arg> of PID <partition> evicted"
+    LOG_PAGE_FAULT,         // "page fault on page <arg>, loaded into frame <partition>"
+    LOG_CODE_COUNT,         // codes below are only found in binary files
+
+    LOG_DEFINE_NAME = 0x70, // string table entry: name <arg> is the <duration> bytes that follow, padded to a record
+    LOG_STATUS_SNAPSHOT,    // system status snapshot at <time> with <arg> rows
+    LOG_STATUS_ROW,         // system status row: <pid>, <name>, <partition>, size <arg> (in a delta: created or changed)
+    LOG_STATUS_DELTA,       // delta snapshot at <time> with <arg> exit and row records
+    LOG_STATUS_EXIT,        // delta snapshot: <pid> is gone
+    LOG_STATUS_PAGING       // paging counters: <arg> page faults, <name> TLB hits, <duration> TLB misses, <partition> frames used
+} LogCode;
+
+typedef enum
+{
+    LOG_FORMAT_TEXT,
+    LOG_FORMAT_BINARY
+} LogFormat;
+
+typedef enum
+{
+    LOG_KIND_EXECUTION, // binary execution log
+    LOG_KIND_STATUS     // binary system status
+} LogKind;
+
+typedef struct
+{
+    uint64_t time;      // simulated time the step starts at
+    uint32_t duration;  // duration of the step
+    uint32_t pid;       // process on the CPU (0 when idle)
+    uint32_t arg;       // pid, address or size, depending on the code
+    uint32_t name;      // interned program name (LOG_EXEC_LOAD)
+    uint32_t partition; // partition number (LOG_FOUND_PARTITION, LOG_PARTITION_OCCUPIED), or the second count of a paging step
+    uint16_t vector;    // vector number (LOG_FIND_VECTOR)
+    uint8_t code;       // LogCode
+    uint8_t core;       // core the step ran on, from 1 (0 in a single-core run)
+} LogRecord;
+// binary record: u64 time, u32 duration, u16 pid, u8 code (| LOG_BINARY_ARGUMENTS), u8 vector
+// argument record (binary-only codes, or when arg, name, partition or core is set): u32 arg, u32 name, u32 partition, u32 core
+
+typedef struct
+{
+    int fd;                 // output file descriptor
+    LogFormat format;       // text lines or binary records
+    const NameTable *names; // program names for LOG_EXEC_LOAD
+    uint8_t *defined;       // binary format: names already written to the string table (by program id)
+    uint32_t defined_count; // allocated slots in defined
+    char *ring;             // ring buffer of rendered records
+    size_t capacity;        // size of the ring
+    size_t head;            // offset of the oldest unwritten byte
+    size_t length;          // unwritten bytes in the ring
+    uint64_t records;       // records emitted
+    uint64_t writes;        // write/writev calls made
+    bool timing;            // time the writes (--timing)
+    uint64_t write_ns;      // time spent writing the log out (ns), 0 unless timing
+} LogEmitter;
+
+// -----------------------------------------------------------
+
+size_t log_format_text(const LogRecord *record, const char *name, char *out);
+size_t log_encode_header(LogKind kind, uint8_t *out);
+int log_decode_header(const uint8_t *in, size_t length, LogKind *kind);
+size_t log_encode_record(const LogRecord *record, uint8_t *out);
+size_t log_decode_record(const uint8_t *in, size_t length, LogRecord *record);
+size_t log_encode_name(uint32_t id, const char *name, uint8_t *out);
+
+// -----------------------------------------------------------
+
+int log_emitter_open(LogEmitter *emitter, const char *path, const NameTable *names, LogFormat format);
+void log_emitter_emit(LogEmitter *emitter, const LogRecord *record);
+void log_emitter_flush(LogEmitter *emitter);
+void log_emitter_close(LogEmitter *emitter);
+
+// -----------------------------------------------------------
+
+#endif // LOG_EMITTER_H
@@ -0,0 +1,554 @@
+#include "process-simulator.h"
+#include "sim-context.h"
+#include "batch.h"
+#include "thread-pool.h"
+#include "random.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Function to read the wall clock
+/**
+ * @return Seconds since an arbitrary start
+ */
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+// Function to print the profile summary and write its JSON dump, once every simulation is done
+/**
+ * @param json_path JSON file (NULL for none)
+ * @return 0 on success, -1 if the JSON file cannot be written (the error is printed)
+ */
+static int finish_profile(const char *json_path)
+{
+    if (PROFILE_ENABLED)
+    {
+        profile_report(stdout);
+    }
+    return (json_path != NULL) ? profile_write_json(json_path) : 0;
+}
+
+// Function to print the command-line usage
+/**
+ * @param program Name of the executable
+ */
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [options] <trace_file> <external_files> <vector_table_file> <output_file>\n", program);
+    printf("       %s [options] --restore <checkpoint> <external_files> <vector_table_file> <output_file>\n", program);
+    printf("       %s [options] --batch <manifest>\n", program);
+    printf("Options:\n");
+    printf("  --status <file>        system status output (default %s)\n", STATUS_SINK_DEFAULT_PATH);
+    printf("  --status-flush <n>     flush the system status every n snapshots (default 0 = at exit or when the buffer is full)\n");
+    printf("  --status-delta <n>     write only what changed between system status snapshots, with a full snapshot every n (see sim-status)\n");
+    printf("  --scheduler <policy>   inline, fcfs, rr, priority or sjf (default inline)\n");
+    printf("  --quantum <ms>         round-robin time slice (default %d)\n", SCHEDULER_DEFAULT_QUANTUM);
+    printf("  --cores <n>            simulated CPU cores with their own run queues, up to %d (default 1, more need a scheduler other than inline)\n", SCHEDULER_MAX_CORES);
+    printf("  --devices <file>       simulate the devices behind the vectors, one \"<vector>, <priority>[, <handler ms>]\" per line (see README)\n");
+    printf("  --partitions <file>    memory partition layout, one \"<number>, <size>\" per line (default the six fixed partitions)\n");
+    printf("  --fit <policy>         best, first, worst or next (default best)\n");
+    printf("  --variable             split partitions to size on EXEC and coalesce them on exit\n");
+    printf("  --paging <policy>      load programs into %dMb pages on demand instead of partitions, replacing pages with fifo, lru, clock or opt\n", VIRTUAL_MEMORY_PAGE_SIZE);
+    printf("  --frames <n>           physical frames of a paged run (default as many as the memory partitions hold)\n");
+    printf("  --tlb <n>              TLB entries of a paged run, up to %d (default %d)\n", VIRTUAL_MEMORY_MAX_TLB, VIRTUAL_MEMORY_DEFAULT_TLB);
+    printf("  --format <format>      text or binary execution log and system status (default text, see sim-convert)\n");
+    printf("  --stream               read the trace in the background through a bounded window instead of loading it up front\n");
+    printf("  --seed <n>             seed of the random duration splits (default: picked from the clock and printed)\n");
+    printf("  --batch <manifest>     run every \"<trace>, <external_files>, <vector_table>, <output>[, <status>]\" line of the manifest in one process\n");
+    printf("  --threads <n>          threads used by --batch (default one per online CPU)\n");
+    printf("  --programs <dir>       directory of the programs named in an EXEC (default %s)\n", PROGRAMS_DEFAULT_DIR);
+    printf("  --timing               parse every trace up front and print the load, simulate and flush times, events/s and peak RSS\n");
+    printf("  --profile <file>       write the profiling counters as JSON at exit (\"-\" for stdout, needs make PROFILE=1)\n");
+    printf("  --checkpoint <file>    save the whole simulator state once --checkpoint-at or --checkpoint-events is reached, then carry on\n");
+    printf("  --checkpoint-at <ms>   checkpoint at the first event boundary at or after this simulated time\n");
+    printf("  --checkpoint-events <n> checkpoint once n trace events have run\n");
+    printf("  --restore <file>       carry on from a checkpoint instead of booting a trace (scheduler, quantum, fit and partitions come from it,\n");
+    printf("                         the random stream too unless --seed is given)\n");
+}
+
+// Main function to handle command-line arguments and call the appropriate functions
+int main(int argc, char *argv[])
+{
+    const char *status_path = STATUS_SINK_DEFAULT_PATH;
+    bool status_given = false;
+    uint32_t status_flush = 0;
+    unsigned long status_keyframes = 0;
+    SchedulerPolicy policy = SCHEDULER_INLINE;
+    unsigned long quantum = SCHEDULER_DEFAULT_QUANTUM;
+    unsigned long cores = 1;
+    const char *partitions_path = NULL;
+    const char *devices_path = NULL;
+    FitPolicy fit = FIT_BEST;
+    bool variable = false;
+    bool paging = false;
+    ReplacementPolicy replacement = REPLACE_LRU;
+    unsigned long frames = 0;
+    unsigned long tlb_size = 0;
+    LogFormat output_format = LOG_FORMAT_TEXT;
+    bool streaming = false;
+    bool seeded = false;
+    uint64_t seed = 0;
+    const char *batch_path = NULL;
+    const char *programs_dir = PROGRAMS_DEFAULT_DIR;
+    bool timing = false;
+    const char *profile_path = NULL;
+    const char *checkpoint_path = NULL;
+    uint64_t checkpoint_time = UINT64_MAX;
+    uint64_t checkpoint_events = UINT64_MAX;
+    const char *restore_path = NULL;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long thread_count = (online > 0) ? (unsigned long)online : 1;
+
+    static const struct option long_options[] = {
+        {"status", required_argument, NULL, 's'},
+        {"status-flush", required_argument, NULL, 'f'},
+        {"status-delta", required_argument, NULL, 'k'},
+        {"scheduler", required_argument, NULL, 'p'},
+        {"quantum", required_argument, NULL, 'q'},
+        {"cores", required_argument, NULL, 'c'},
+        {"partitions", required_argument, NULL, 'm'},
+        {"devices", required_argument, NULL, 'D'},
+        {"fit", required_argument, NULL, 'b'},
+        {"variable", no_argument, NULL, 'v'},
+        {"paging", required_argument, NULL, 'g'},
+        {"frames", required_argument, NULL, 'F'},
+        {"tlb", required_argument, NULL, 'L'},
+        {"format", required_argument, NULL, 'o'},
+        {"stream", no_argument, NULL, 't'},
+        {"seed", required_argument, NULL, 'r'},
+        {"batch", required_argument, NULL, 'B'},
+        {"threads", required_argument, NULL, 'j'},
+        {"programs", required_argument, NULL, 'd'},
+        {"timing", no_argument, NULL, 'T'},
+        {"profile", required_argument, NULL, 'P'},
+        {"checkpoint", required_argument, NULL, 'C'},
+        {"checkpoint-at", required_argument, NULL, 'A'},
+        {"checkpoint-events", required_argument, NULL, 'E'},
+        {"restore", required_argument, NULL, 'R'},
+        {NULL, 0, NULL, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        char *end = NULL;
+        switch (option)
+        {
+        case 's':
+            status_path = optarg;
+            status_given = true;
+            break;
+        case 'f':
+            status_flush = (uint32_t)strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0')
+            {
+                printf("Error: Invalid --status-flush value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'k':
+            status_keyframes = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || status_keyframes == 0 || status_keyframes > UINT32_MAX)
+            {
+                printf("Error: Invalid --status-delta value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (scheduler_parse_policy(optarg, &policy) != 0)
+            {
+                printf("Error: Unknown scheduler %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'q':
+            quantum = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || quantum == 0 || quantum > UINT32_MAX)
+            {
+                printf("Error: Invalid --quantum value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'c':
+            cores = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || cores == 0 || cores > SCHEDULER_MAX_CORES)
+            {
+                printf("Error: Invalid --cores value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            partitions_path = optarg;
+            break;
+        case 'D':
+            devices_path = optarg;
+            break;
+        case 'b':
+            if (memory_parse_fit(optarg, &fit) != 0)
+            {
+                printf("Error: Unknown fit policy %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'v':
+            variable = true;
+            break;
+        case 'g':
+            if (virtual_memory_parse_policy(optarg, &replacement) != 0)
+            {
+                printf("Error: Unknown replacement policy %s\n", optarg);
+                return 1;
+            }
+            paging = true;
+            break;
+        case 'F':
+            frames = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || frames == 0 || frames > UINT32_MAX)
+            {
+                printf("Error: Invalid --frames value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'L':
+            tlb_size = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || tlb_size == 0 || tlb_size > VIRTUAL_MEMORY_MAX_TLB)
+            {
+                printf("Error: Invalid --tlb value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'o':
+            if (strcmp(optarg, "text") == 0)
+            {
+                output_format = LOG_FORMAT_TEXT;
+            }
+            else if (strcmp(optarg, "binary") == 0)
+            {
+                output_format = LOG_FORMAT_BINARY;
+            }
+            else
+            {
+                printf("Error: Unknown output format %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 't':
+            streaming = true;
+            break;
+        case 'r':
+            errno = 0;
+            seed = strtoull(optarg, &end, 0);
+            if (*optarg == '\0' || *optarg == '-' || *end != '\0' || errno != 0)
+            {
+                printf("Error: Invalid --seed value %s\n", optarg);
+                return 1;
+            }
+            seeded = true;
+            break;
+        case 'B':
+            batch_path = optarg;
+            break;
+        case 'd':
+            programs_dir = optarg;
+            break;
+        case 'T':
+            timing = true;
+            break;
+        case 'P':
+            if (!PROFILE_ENABLED)
+            {
+                printf("Error: --profile needs a build with SIM_PROFILE (make clean && make PROFILE=1)\n");
+                return 1;
+            }
+            profile_path = optarg;
+            break;
+        case 'C':
+            checkpoint_path = optarg;
+            break;
+        case 'A':
+        case 'E':
+            errno = 0;
+            uint64_t value = strtoull(optarg, &end, 10);
+            if (*optarg == '\0' || *optarg == '-' || *end != '\0' || errno != 0)
+            {
+                printf("Error: Invalid --%s value %s\n", (option == 'A') ? "checkpoint-at" : "checkpoint-events", optarg);
+                return 1;
+            }
+            *((option == 'A') ? &checkpoint_time : &checkpoint_events) = value;
+            break;
+        case 'R':
+            restore_path = optarg;
+            break;
+        case 'j':
+            thread_count = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || thread_count == 0 || thread_count > THREAD_POOL_MAX_THREADS)
+            {
+                printf("Error: Invalid --threads value %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    SimulationOptions options;
+    simulation_options_init(&options);
+    options.policy = policy;
+    options.quantum = (uint32_t)quantum;
+    options.cores = (uint32_t)cores;
+    options.partitions_path = partitions_path;
+    options.devices_path = devices_path;
+    options.programs_dir = programs_dir;
+    options.fit = fit;
+    options.variable = variable;
+    options.paging = paging;
+    options.replacement = replacement;
+    options.frames = (uint32_t)frames;
+    options.tlb_size = (tlb_size != 0) ? (uint32_t)tlb_size : VIRTUAL_MEMORY_DEFAULT_TLB;
+    options.format = output_format;
+    options.status_flush = status_flush;
+    options.status_keyframes = (uint32_t)status_keyframes;
+    options.streaming = streaming;
+    options.timing = timing;
+
+    bool checkpointing = checkpoint_time != UINT64_MAX || checkpoint_events != UINT64_MAX;
+    if ((checkpoint_path != NULL) != checkpointing)
+    {
+        printf("Error: --checkpoint needs --checkpoint-at or --checkpoint-events, and they need --checkpoint\n");
+        return 1;
+    }
+    if ((checkpoint_path != NULL || restore_path != NULL) && (streaming || batch_path != NULL || cores > 1 || devices_path != NULL || paging))
+    {
+        // a streamed trace is read once and dropped behind the run, a batch job has no single state to save
+        printf("Error: --checkpoint and --restore cannot be used with --stream, --batch, --cores, --devices or --paging\n");
+        return 1;
+    }
+    if (cores > 1 && policy == SCHEDULER_INLINE)
+    {
+        printf("Error: --cores needs a --scheduler other than inline (a forked child runs before its parent)\n");
+        return 1;
+    }
+    if (devices_path != NULL && (cores > 1 || policy == SCHEDULER_INLINE))
+    {
+        printf("Error: --devices needs a single core and a --scheduler other than inline (a process waits off the CPU for its request)\n");
+        return 1;
+    }
+    if (!paging && (frames != 0 || tlb_size != 0))
+    {
+        printf("Error: --frames and --tlb need --paging\n");
+        return 1;
+    }
+    if (paging && (cores > 1 || (streaming && replacement == REPLACE_OPT)))
+    {
+        printf("Error: --paging needs a single core (the TLB belongs to one CPU), and opt cannot look ahead in a --stream trace\n");
+        return 1;
+    }
+
+    if (batch_path != NULL)
+    {
+        if (argc != optind || streaming || status_given)
+        {
+            // every job names its own files, and a streamed trace cannot be shared between threads
+            printf("Error: --batch takes no positional arguments, --stream or --status (the manifest names every file)\n");
+            return 1;
+        }
+    }
+    else if (argc - optind != ((restore_path != NULL) ? 3 : 4))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Seed: every random duration split comes from the engine's own stream, a seed repeats a run exactly
+    // (a restored run carries on with the checkpointed stream, a seed forks a new one off the same state)
+    if (!seeded && restore_path == NULL)
+    {
+        seed = rng_default_seed();
+    }
+    if (seeded || restore_path == NULL)
+    {
+        printf("Seed: %llu\n", (unsigned long long)seed);
+    }
+
+    if (batch_path != NULL)
+    {
+        BatchManifest manifest;
+        if (batch_load_manifest(batch_path, &manifest) != 0)
+        {
+            batch_free_manifest(&manifest);
+            return 1;
+        }
+        int result = batch_run(&manifest, &options, (unsigned)thread_count, seed);
+        batch_free_manifest(&manifest);
+        if (finish_profile(profile_path) != 0)
+        {
+            result = -1;
+        }
+        return (result == 0) ? 0 : 1;
+    }
+
+    // positional arguments: trace_file, external_files, vector_table_file, output_file
+    char **args = argv + optind;
+    char *restored_args[4];
+    if (restore_path != NULL)
+    {
+        // no trace_file: the processes and their trace positions come from the checkpoint, which takes its place
+        restored_args[0] = (char *)restore_path;
+        memcpy(&restored_args[1], args, 3 * sizeof(char *));
+        args = restored_args;
+    }
+
+    // -----------------------------------------------------------
+    // Loading
+    // -----------------------------------------------------------
+
+    // The context holds the whole simulator instance: inputs, clock, PCBs, memory and outputs
+    options.install_signals = true;
+    SimContext context;
+    sim_context_init(&context, &options, NULL, stdout);
+    double load_start = now_seconds();
+
+    // Load external files (program names share the interning of the program cache) and the vector table
+    if (sim_context_load(&context, args[1], args[2]) != 0)
+    {
+        sim_context_destroy(&context);
+        return 1;
+    }
+
+    // --timing parses every trace now, so the simulate phase only measures the engine (a streamed trace is parsed as it runs)
+    if (timing && !streaming && restore_path == NULL && sim_context_preload(&context, args[0]) != 0)
+    {
+        sim_context_destroy(&context);
+        return 1;
+    }
+
+    // -----------------------------------------------------------
+    // Simulation
+    // -----------------------------------------------------------
+
+    double simulate_start = now_seconds();
+    if (restore_path != NULL)
+    {
+        // Carry on from the checkpointed state instead of booting the trace
+        if (sim_context_restore(&context, restore_path, args[3], status_path) != 0)
+        {
+            sim_context_destroy(&context);
+            return 1;
+        }
+        if (seeded)
+        {
+            rng_seed(&context.engine.rng, seed);
+        }
+        printf("Restored %s at %llu ms, %llu events\n", restore_path, (unsigned long long)sim_context_time(&context), (unsigned long long)context.engine.events);
+    }
+    // Fork the init process and exec the trace in it
+    else if (sim_context_start(&context, args[0], args[3], status_path, seed) != 0)
+    {
+        sim_context_destroy(&context);
+        return 1;
+    }
+
+    int exit_code = 0;
+    if (checkpoint_path != NULL)
+    {
+        // run up to the checkpoint, save the state at that event boundary and carry on
+        bool running = true;
+        while (running && sim_context_time(&context) < checkpoint_time && context.engine.events < checkpoint_events)
+        {
+            running = sim_context_step(&context);
+        }
+        if (!running)
+        {
+            printf("Error: The run ended at %llu ms after %llu events, before the checkpoint\n", (unsigned long long)sim_context_time(&context), (unsigned long long)context.engine.events);
+            exit_code = 1;
+        }
+        else if (sim_context_checkpoint(&context, checkpoint_path) != 0)
+        {
+            exit_code = 1;
+        }
+        else
+        {
+            printf("Checkpoint %s at %llu ms, %llu events\n", checkpoint_path, (unsigned long long)sim_context_time(&context), (unsigned long long)context.engine.events);
+        }
+    }
+    // run the simulation
+    if (sim_context_run(&context) != 0)
+    {
+        exit_code = 1;
+    }
+    double simulate_end = now_seconds();
+
+    // -----------------------------------------------------------
+    // Cleanup
+    // -----------------------------------------------------------
+
+    sim_context_report(&context);
+    uint64_t events = context.engine.events;
+    double log_writes = (double)context.log.write_ns / 1e9;
+    double flush_start = now_seconds();
+    sim_context_destroy(&context); // flush the outputs and free the simulator
+    double flush_end = now_seconds();
+
+    if (timing)
+    {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double simulate = simulate_end - simulate_start;
+        printf("Timing: load %.3f s, simulate %.3f s (log writes %.3f s), flush %.3f s, %llu events, %.0f events/s, peak RSS %ld KB\n",
+               simulate_start - load_start, simulate, log_writes, flush_end - flush_start, (unsigned long long)events,
+               (simulate > 0) ? (double)events / simulate : 0.0, usage.ru_maxrss);
+    }
+
+    if (finish_profile(profile_path) != 0)
+    {
+        exit_code = 1;
+    }
+
+    // -----------------------------------------------------------
+    // Debugging Section
+    // -----------------------------------------------------------
+
+    if (DEBUG_MODE)
+    {
+        // Print the output trace
+        char choice;
+        printf("Execution trace saved to %s\n", args[2]);
+        printf("Would you like to print the execution trace? (y/n): ");
+        scanf("%c", &choice);
+
+        if ((choice == 'y') || (choice == 'Y'))
+        {
+            FILE *file = fopen(args[2], "r"); // Open file for reading
+            if (!file)
+            {
+                printf("Error: Cannot open file %s\n", args[2]); // Print error if file can't be opened
+            }
+
+            int i = 0;
+            char line[256];
+            // Read each line from the file and print it
+            while (fgets(line, sizeof(line), file))
+            {
+                printf("Execution Trace Line %d: ", i);
+                printf("%s", line);
+                i++;
+            }
+        }
+
+        printf("\n\tGoodbye %s!\n\n", args[0]);
+    }
+    return exit_code;
+}
@@ -0,0 +1,516 @@
+#include "memory-manager.h"
+#include "sim-alloc.h"
+#include "loader.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static const char *fit_names[] = {"best", "first", "worst", "next"};
+
+// -----------------------------------------------------------
+// Free index
+// -----------------------------------------------------------
+
+// Function to find where a free partition belongs in the size index
+/**
+ * @param memory Pointer to the memory manager
+ * @param size Size of the partition
+ * @param start Address of the partition (tie breaker, lower addresses first)
+ * @return Index of the first free partition not ordered before (size, start)
+ */
+static size_t lower_bound(const MemoryManager *memory, uint32_t size, uint64_t start)
+{
+    size_t low = 0;
+    size_t high = memory->free_count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        const MemoryPartition *partition = memory->by_size[mid];
+        if (partition->size < size || (partition->size == size && partition->start < start))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// Function to make room in the size index for a number of partitions
+/**
+ * The index always has a slot for every partition, so freeing one never allocates.
+ * @param memory Pointer to the memory manager
+ * @param count Number of partitions
+ * @return 0 on success, -1 if the index cannot be grown (it is left as it was)
+ */
+static int index_reserve(MemoryManager *memory, size_t count)
+{
+    if (count <= memory->free_capacity)
+    {
+        return 0;
+    }
+
+    size_t capacity = (memory->free_capacity == 0) ? 16 : memory->free_capacity * 2;
+    MemoryPartition **by_size = (MemoryPartition **)sim_realloc(memory->by_size, capacity * sizeof(MemoryPartition *));
+    if (by_size == NULL)
+    {
+        return -1;
+    }
+    memory->by_size = by_size;
+    memory->free_capacity = capacity;
+    return 0;
+}
+
+// Function to add a free partition to the size index
+/**
+ * @param memory Pointer to the memory manager
+ * @param partition Pointer to the partition
+ */
+static void index_insert(MemoryManager *memory, MemoryPartition *partition)
+{
+    assert(memory->free_count < memory->free_capacity); // reserved when the partition was created
+
+    size_t i = lower_bound(memory, partition->size, partition->start);
+    memmove(&memory->by_size[i + 1], &memory->by_size[i], (memory->free_count - i) * sizeof(MemoryPartition *));
+    memory->by_size[i] = partition;
+    memory->free_count++;
+}
+
+// Function to remove a free partition from the size index
+/**
+ * @param memory Pointer to the memory manager
+ * @param partition Pointer to the partition
+ */
+static void index_remove(MemoryManager *memory, MemoryPartition *partition)
+{
+    size_t i = lower_bound(memory, partition->size, partition->start);
+    assert(i < memory->free_count && memory->by_size[i] == partition);
+    memmove(&memory->by_size[i], &memory->by_size[i + 1], (memory->free_count - i - 1) * sizeof(MemoryPartition *));
+    memory->free_count--;
+}
+
+// -----------------------------------------------------------
+// Fit policies
+// -----------------------------------------------------------
+
+// Function to parse a fit policy name from the command line
+/**
+ * @param name Name of the policy (best, first, worst, next)
+ * @param fit Pointer to the parsed policy
+ * @return 0 on success, -1 if the name is unknown
+ */
+int memory_parse_fit(const char *name, FitPolicy *fit)
+{
+    for (size_t i = 0; i < sizeof(fit_names) / sizeof(fit_names[0]); i++)
+    {
+        if (strcmp(name, fit_names[i]) == 0)
+        {
+            *fit = (FitPolicy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Function to get the name of a fit policy
+/**
+ * @param fit Fit policy
+ * @return Name of the policy
+ */
+const char *memory_fit_name(FitPolicy fit)
+{
+    return fit_names[fit];
+}
+
+// Function to find the first free partition big enough, walking in address order
+/**
+ * @param from Partition to start from
+ * @param until Partition to stop at (NULL to walk to the end)
+ * @param size Size needed
+ * @return Pointer to the partition, or NULL if none fits
+ */
+static MemoryPartition *walk_fit(MemoryPartition *from, const MemoryPartition *until, uint32_t size)
+{
+    for (MemoryPartition *partition = from; partition != until; partition = partition->next)
+    {
+        PROFILE_COUNT(PROFILE_PARTITION_STEPS, 1);
+        if (partition->free && partition->size >= size)
+        {
+            return partition;
+        }
+    }
+    return NULL;
+}
+
+// Function to pick the free partition a program goes into
+/**
+ * @param memory Pointer to the memory manager
+ * @param size Size needed
+ * @return Pointer to the partition, or NULL if none fits
+ */
+static MemoryPartition *find_fit(const MemoryManager *memory, uint32_t size)
+{
+    switch (memory->fit)
+    {
+    case FIT_BEST:
+    {
+        // smallest free partition that fits, lowest address on ties
+        PROFILE_COUNT(PROFILE_PARTITION_STEPS, 1);
+        size_t i = lower_bound(memory, size, 0);
+        return (i < memory->free_count) ? memory->by_size[i] : NULL;
+    }
+    case FIT_WORST:
+    {
+        PROFILE_COUNT(PROFILE_PARTITION_STEPS, 1);
+        MemoryPartition *largest = (memory->free_count > 0) ? memory->by_size[memory->free_count - 1] : NULL;
+        return (largest != NULL && largest->size >= size) ? largest : NULL;
+    }
+    case FIT_FIRST:
+        return walk_fit(memory->head, NULL, size);
+    case FIT_NEXT:
+    {
+        // resume after the last allocation and wrap around once
+        MemoryPartition *cursor = (memory->cursor != NULL) ? memory->cursor : memory->head;
+        MemoryPartition *partition = walk_fit(cursor, NULL, size);
+        return (partition != NULL) ? partition : walk_fit(memory->head, cursor, size);
+    }
+    }
+    return NULL;
+}
+
+// -----------------------------------------------------------
+// Partitions
+// -----------------------------------------------------------
+
+// Function to initialize an empty memory
+/**
+ * @param memory Pointer to the memory manager
+ * @param fit Fit policy
+ * @param variable true to split and coalesce partitions, false for fixed partitions
+ */
+void memory_init(MemoryManager *memory, FitPolicy fit, bool variable)
+{
+    memset(memory, 0, sizeof(*memory));
+    memory->fit = fit;
+    memory->variable = variable;
+    memory->next_number = 1;
+    pool_init(&memory->pool, sizeof(MemoryPartition), MEMORY_BLOCK_SLAB_SIZE);
+}
+
+// Function to create a free partition after the last one
+/**
+ * @param memory Pointer to the memory manager
+ * @param partition_number Number of the partition
+ * @param size Size of the partition (Mb)
+ * @return 0 on success, -1 if the partition cannot be allocated
+ */
+int memory_add_partition(MemoryManager *memory, uint32_t partition_number, uint32_t size)
+{
+    MemoryPartition *partition = (index_reserve(memory, memory->partition_count + 1) == 0) ? (MemoryPartition *)pool_alloc(&memory->pool) : NULL;
+    if (partition == NULL)
+    {
+        return -1;
+    }
+    memset(partition, 0, sizeof(*partition));
+    partition->partition_number = partition_number;
+    partition->size = size;
+    snprintf(partition->code, sizeof(partition->code), "%s", "free");
+    partition->start = memory->total;
+    partition->region = partition_number;
+    partition->free = true;
+
+    // append in address order
+    partition->prev = memory->tail;
+    if (memory->tail != NULL)
+    {
+        memory->tail->next = partition;
+    }
+    else
+    {
+        memory->head = partition;
+    }
+    memory->tail = partition;
+
+    memory->partition_count++;
+    memory->total += size;
+    memory->free_total += size;
+    if (partition_number >= memory->next_number)
+    {
+        memory->next_number = partition_number + 1;
+    }
+    index_insert(memory, partition);
+    return 0;
+}
+
+// Function to put a checkpointed partition back after the last one
+/**
+ * Partitions are restored in address order, the split counter and the cursor are set by the caller (see checkpoint.h).
+ * @param memory Pointer to the memory manager
+ * @param saved Pointer to the partition fields (the links are ignored)
+ * @return Pointer to the restored partition, NULL if it cannot be allocated
+ */
+MemoryPartition *memory_restore_partition(MemoryManager *memory, const MemoryPartition *saved)
+{
+    MemoryPartition *partition = (index_reserve(memory, memory->partition_count + 1) == 0) ? (MemoryPartition *)pool_alloc(&memory->pool) : NULL;
+    if (partition == NULL)
+    {
+        return NULL;
+    }
+    *partition = *saved;
+
+    partition->next = NULL;
+    partition->prev = memory->tail;
+    if (memory->tail != NULL)
+    {
+        memory->tail->next = partition;
+    }
+    else
+    {
+        memory->head = partition;
+    }
+    memory->tail = partition;
+
+    memory->partition_count++;
+    memory->total += partition->size;
+    if (partition->free)
+    {
+        memory->free_total += partition->size;
+        index_insert(memory, partition);
+    }
+    return partition;
+}
+
+// Function to load the partition layout from a file
+/**
+ * One partition per line, in address order: "<partition number>, <size in Mb>". Lines starting with # are comments.
+ * @param memory Pointer to the memory manager
+ * @param filename Name of the file to load
+ * @return 0 on success, -1 if the file cannot be read or a line is malformed (the error is printed)
+ */
+int memory_load_partitions(MemoryManager *memory, const char *filename)
+{
+    MappedFile file;
+    if (mapped_file_open(&file, filename) != 0)
+    {
+        printf("Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+
+    Scanner scanner;
+    scanner_init(&scanner, &file, filename);
+    int result = 0;
+    while (result == 0 && scanner_next_line(&scanner))
+    {
+        uint32_t partition_number;
+        uint32_t size;
+        result = scanner_uint(&scanner, UINT32_MAX, &partition_number);
+        result = (result == 0) ? scanner_expect(&scanner, ',') : result;
+        result = (result == 0) ? scanner_uint(&scanner, UINT32_MAX, &size) : result;
+        if (result == 0 && size == 0)
+        {
+            result = scanner_fail(&scanner, "partition size must be at least 1");
+        }
+        result = (result == 0) ? scanner_end_line(&scanner) : result;
+
+        if (result == 0 && memory_add_partition(memory, partition_number, size) != 0)
+        {
+            result = scanner_fail(&scanner, "cannot allocate partition %u", partition_number);
+        }
+    }
+
+    if (result != 0)
+    {
+        printf("Error: %s\n", scanner.error);
+    }
+    mapped_file_close(&file);
+    return result;
+}
+
+// Function to load the default layout (the six fixed partitions of the assignment)
+/**
+ * @param memory Pointer to the memory manager
+ * @return 0 on success, -1 if a partition cannot be allocated
+ */
+int memory_load_defaults(MemoryManager *memory)
+{
+    static const uint32_t sizes[] = MEMORY_DEFAULT_PARTITIONS;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        if (memory_add_partition(memory, (uint32_t)(i + 1), sizes[i]) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to load a program into a free partition
+/**
+ * @param memory Pointer to the memory manager
+ * @param size Size of the program (Mb)
+ * @param owner Pid of the process the program is loaded for
+ * @param code Name written into the partition
+ * @return Pointer to the occupied partition, or NULL if no free partition fits
+ */
+MemoryPartition *memory_allocate(MemoryManager *memory, uint32_t size, uint16_t owner, const char *code)
+{
+    PROFILE_START(search);
+    MemoryPartition *partition = find_fit(memory, size);
+    PROFILE_STOP(search, PROFILE_PARTITION_SEARCH);
+    PROFILE_COUNT(PROFILE_PARTITION_SEARCHES, 1);
+    if (partition != NULL)
+    {
+        index_remove(memory, partition);
+
+        // variable partitions are cut to size, the rest stays free as a new partition
+        // (if the new partition cannot be allocated, the program gets the whole partition)
+        MemoryPartition *rest = NULL;
+        if (memory->variable && partition->size > size && index_reserve(memory, memory->partition_count + 1) == 0)
+        {
+            rest = (MemoryPartition *)pool_alloc(&memory->pool);
+        }
+        if (rest != NULL)
+        {
+            memset(rest, 0, sizeof(*rest));
+            rest->partition_number = memory->next_number++;
+            if (memory->next_number == 0)
+            {
+                memory->next_number = 1; // numbers are only labels, they wrap in very long runs
+            }
+            rest->size = partition->size - size;
+            snprintf(rest->code, sizeof(rest->code), "%s", "free");
+            rest->start = partition->start + size;
+            rest->region = partition->region;
+            rest->free = true;
+            rest->prev = partition;
+            rest->next = partition->next;
+            if (partition->next != NULL)
+            {
+                partition->next->prev = rest;
+            }
+            else
+            {
+                memory->tail = rest;
+            }
+            partition->next = rest;
+            partition->size = size;
+            memory->partition_count++;
+            index_insert(memory, rest);
+        }
+
+        partition->free = false;
+        partition->owner = owner;
+        partition->used = size;
+        snprintf(partition->code, sizeof(partition->code), "%s", code);
+        memory->free_total -= partition->size;
+        memory->cursor = (partition->next != NULL) ? partition->next : memory->head;
+        memory->allocations++;
+    }
+    else
+    {
+        memory->failures++;
+    }
+    return partition;
+}
+
+// Function to merge a free partition into the free partition before it
+/**
+ * @param memory Pointer to the memory manager
+ * @param low Pointer to the lower partition (kept)
+ * @param high Pointer to the higher partition (recycled)
+ */
+static void coalesce(MemoryManager *memory, MemoryPartition *low, MemoryPartition *high)
+{
+    low->size += high->size;
+    low->next = high->next;
+    if (high->next != NULL)
+    {
+        high->next->prev = low;
+    }
+    else
+    {
+        memory->tail = low;
+    }
+    if (memory->cursor == high)
+    {
+        memory->cursor = low;
+    }
+    memory->partition_count--;
+    pool_release(&memory->pool, high);
+}
+
+// Function to give a partition back once its program is gone
+/**
+ * @param memory Pointer to the memory manager
+ * @param partition Pointer to the partition
+ */
+void memory_release(MemoryManager *memory, MemoryPartition *partition)
+{
+    partition->free = true;
+    partition->owner = 0;
+    partition->used = 0;
+    snprintf(partition->code, sizeof(partition->code), "%s", "free");
+    memory->free_total += partition->size;
+    memory->releases++;
+
+    // variable partitions merge with free neighbours cut from the same region
+    if (memory->variable)
+    {
+        MemoryPartition *next = partition->next;
+        if (next != NULL && next->free && next->region == partition->region)
+        {
+            index_remove(memory, next);
+            coalesce(memory, partition, next);
+        }
+        MemoryPartition *prev = partition->prev;
+        if (prev != NULL && prev->free && prev->region == partition->region)
+        {
+            index_remove(memory, prev);
+            coalesce(memory, prev, partition);
+            partition = prev;
+        }
+    }
+
+    index_insert(memory, partition);
+}
+
+// Function to print the memory statistics at the end of the run
+/**
+ * @param memory Pointer to the memory manager
+ * @param out Stream to print to
+ */
+void memory_report(const MemoryManager *memory, FILE *out)
+{
+    uint32_t largest = (memory->free_count > 0) ? memory->by_size[memory->free_count - 1]->size : 0;
+    uint64_t internal = 0;
+    for (const MemoryPartition *partition = memory->head; partition != NULL; partition = partition->next)
+    {
+        if (!partition->free)
+        {
+            internal += partition->size - partition->used;
+        }
+    }
+
+    // external fragmentation: share of the free memory a single program cannot use
+    double external = (memory->free_total > 0) ? 100.0 * (1.0 - (double)largest / memory->free_total) : 0.0;
+    fprintf(out, "Memory: %s fit, %s partitions, %zu partitions, %llu of %llu Mb free, largest free %u Mb, external fragmentation %.1f%%, internal fragmentation %llu Mb\n",
+            memory_fit_name(memory->fit), memory->variable ? "variable" : "fixed", memory->partition_count,
+            (unsigned long long)memory->free_total, (unsigned long long)memory->total, largest, external, (unsigned long long)internal);
+
+    fprintf(out, "Allocations: %llu, %llu failed, %llu released\n",
+            (unsigned long long)memory->allocations, (unsigned long long)memory->failures, (unsigned long long)memory->releases);
+}
+
+// Function to free the partitions and the free index
+/**
+ * @param memory Pointer to the memory manager
+ */
+void memory_free(MemoryManager *memory)
+{
+    pool_free(&memory->pool);
+    sim_free(memory->by_size);
+    memset(memory, 0, sizeof(*memory));
+}
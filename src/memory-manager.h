@@ -0,0 +1,81 @@
+#ifndef MEMORY_MANAGER_H
+#define MEMORY_MANAGER_H
+
+// configurations
+#define MEMORY_DEFAULT_PARTITIONS {40, 25, 15, 10, 8, 2} // partition sizes (Mb) when no --partitions file is given
+#define MEMORY_BLOCK_SLAB_SIZE 256                      // partitions carved out of one pool slab
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "pool.h"
+
+// structs
+
+typedef enum
+{
+    FIT_BEST,
+    FIT_FIRST,
+    FIT_WORST,
+    FIT_NEXT
+} FitPolicy;
+
+typedef struct MemoryPartition
+{
+    uint32_t partition_number;
+    uint32_t size;   // Mb
+    char code[20];   // "free", "init", or program name
+    uint16_t owner;  // pid of the process the program was loaded for, 0 when free
+    uint32_t used;   // Mb the program asked for (the rest is internal fragmentation)
+    uint64_t start;  // address of the partition (Mb)
+    uint32_t region; // configured partition this one was split from (variable partitions never coalesce across regions)
+    bool free;
+    struct MemoryPartition *prev; // neighbours in address order
+    struct MemoryPartition *next;
+} MemoryPartition;
+
+typedef struct
+{
+    FitPolicy fit;
+    bool variable;             // split partitions to size on allocation and coalesce them on release
+
+    Pool pool;                 // partition storage (variable partitions come and go)
+    MemoryPartition *head;     // lowest address partition
+    MemoryPartition *tail;     // highest address partition (configured partitions are appended)
+    MemoryPartition *cursor;   // where the next fit search resumes
+    MemoryPartition **by_size; // free partitions ordered by (size, start)
+    size_t free_count;         // number of free partitions
+    size_t free_capacity;      // allocated slots in by_size
+    size_t partition_count;    // number of partitions
+    uint32_t next_number;      // partition number handed to the next split
+    uint64_t total;            // Mb of memory
+    uint64_t free_total;       // Mb in free partitions
+
+    // statistics
+    uint64_t allocations;
+    uint64_t failures;
+    uint64_t releases;
+} MemoryManager;
+
+// -----------------------------------------------------------
+
+int memory_parse_fit(const char *name, FitPolicy *fit);
+const char *memory_fit_name(FitPolicy fit);
+
+// -----------------------------------------------------------
+
+void memory_init(MemoryManager *memory, FitPolicy fit, bool variable);
+int memory_add_partition(MemoryManager *memory, uint32_t partition_number, uint32_t size);
+MemoryPartition *memory_restore_partition(MemoryManager *memory, const MemoryPartition *saved);
+int memory_load_partitions(MemoryManager *memory, const char *filename);
+int memory_load_defaults(MemoryManager *memory);
+MemoryPartition *memory_allocate(MemoryManager *memory, uint32_t size, uint16_t owner, const char *code);
+void memory_release(MemoryManager *memory, MemoryPartition *partition);
+void memory_report(const MemoryManager *memory, FILE *out);
+void memory_free(MemoryManager *memory);
+
+// -----------------------------------------------------------
+
+#endif // MEMORY_MANAGER_H
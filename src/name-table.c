@@ -0,0 +1,166 @@
+#include "name-table.h"
+#include "sim-alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Function to hash a name (FNV-1a)
+/**
+ * @param name Name to hash
+ * @return 64-bit hash of the name
+ */
+static uint64_t hash_name(const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)name; *c != '\0'; c++)
+    {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Function to find the bucket holding a name, or the empty bucket where it belongs
+/**
+ * @param table Pointer to the name table
+ * @param name Name to look for
+ * @return Index of the bucket
+ */
+static size_t find_bucket(const NameTable *table, const char *name)
+{
+    size_t mask = table->bucket_count - 1;
+    size_t bucket = (size_t)hash_name(name) & mask;
+
+    // linear probing, the table is never more than half full
+    while (table->buckets[bucket] != 0 && strcmp(table->names[table->buckets[bucket] - 1], name) != 0)
+    {
+        bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+}
+
+// Function to double the number of buckets and reinsert every name
+/**
+ * @param table Pointer to the name table
+ * @return 0 on success, -1 if the buckets cannot be allocated (the table is left as it was)
+ */
+static int grow_buckets(NameTable *table)
+{
+    uint32_t *buckets = (uint32_t *)sim_calloc(table->bucket_count * 2, sizeof(uint32_t));
+    if (buckets == NULL)
+    {
+        return -1;
+    }
+    sim_free(table->buckets);
+    table->bucket_count *= 2;
+    table->buckets = buckets;
+
+    for (uint32_t id = 0; id < table->count; id++)
+    {
+        table->buckets[find_bucket(table, table->names[id])] = id + 1;
+    }
+    return 0;
+}
+
+// Function to initialize an empty name table
+/**
+ * @param table Pointer to the name table
+ * @return 0 on success, -1 if the buckets cannot be allocated (the table is empty and can still be freed)
+ */
+int name_table_init(NameTable *table)
+{
+    table->names = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->bucket_count = NAME_TABLE_INITIAL_BUCKETS;
+    table->buckets = (uint32_t *)sim_calloc(table->bucket_count, sizeof(uint32_t));
+    return (table->buckets != NULL) ? 0 : -1;
+}
+
+// Function to intern a name
+/**
+ * @param table Pointer to the name table
+ * @param name Name to intern
+ * @return Id of the name, the same id is returned for every equal name (NAME_NOT_FOUND if a new name cannot be stored)
+ */
+uint32_t name_table_intern(NameTable *table, const char *name)
+{
+    size_t bucket = find_bucket(table, name);
+    if (table->buckets[bucket] != 0)
+    {
+        return table->buckets[bucket] - 1;
+    }
+
+    // the table stays at most half full, it grows before the new name goes in
+    if ((size_t)(table->count + 1) * 2 > table->bucket_count)
+    {
+        if (grow_buckets(table) != 0)
+        {
+            return NAME_NOT_FOUND;
+        }
+        bucket = find_bucket(table, name);
+    }
+    if (table->count == table->capacity)
+    {
+        uint32_t capacity = (table->capacity == 0) ? 16 : table->capacity * 2;
+        char **names = (char **)sim_realloc(table->names, capacity * sizeof(char *));
+        if (names == NULL)
+        {
+            return NAME_NOT_FOUND;
+        }
+        table->names = names;
+        table->capacity = capacity;
+    }
+
+    uint32_t id = table->count;
+    table->names[id] = sim_strdup(name);
+    if (table->names[id] == NULL)
+    {
+        return NAME_NOT_FOUND;
+    }
+    table->count++;
+    table->buckets[bucket] = id + 1;
+    return id;
+}
+
+// Function to look up a name without interning it
+/**
+ * @param table Pointer to the name table
+ * @param name Name to look for
+ * @return Id of the name, or NAME_NOT_FOUND
+ */
+uint32_t name_table_find(const NameTable *table, const char *name)
+{
+    size_t bucket = find_bucket(table, name);
+    return (table->buckets[bucket] != 0) ? table->buckets[bucket] - 1 : NAME_NOT_FOUND;
+}
+
+// Function to get the name behind an id
+/**
+ * @param table Pointer to the name table
+ * @param id Id returned by name_table_intern
+ * @return The interned name
+ */
+const char *name_table_get(const NameTable *table, uint32_t id)
+{
+    assert(id < table->count);
+    return table->names[id];
+}
+
+// Function to free every interned name
+/**
+ * @param table Pointer to the name table
+ */
+void name_table_free(NameTable *table)
+{
+    for (uint32_t id = 0; id < table->count; id++)
+    {
+        sim_free(table->names[id]);
+    }
+    sim_free(table->names);
+    sim_free(table->buckets);
+    table->names = NULL;
+    table->buckets = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
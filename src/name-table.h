@@ -0,0 +1,33 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+// configurations
+#define NAME_TABLE_INITIAL_BUCKETS 64 // power of two, doubled when half full
+#define NAME_NOT_FOUND UINT32_MAX
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+
+// structs
+
+typedef struct NameTable
+{
+    char **names;        // id -> interned name
+    uint32_t count;      // number of interned names (ids are 0 .. count - 1)
+    uint32_t capacity;   // allocated slots in names
+    uint32_t *buckets;   // open addressing table of ids + 1 (0 = empty)
+    size_t bucket_count; // number of buckets (power of two)
+} NameTable;
+
+// -----------------------------------------------------------
+
+int name_table_init(NameTable *table);
+uint32_t name_table_intern(NameTable *table, const char *name);
+uint32_t name_table_find(const NameTable *table, const char *name);
+const char *name_table_get(const NameTable *table, uint32_t id);
+void name_table_free(NameTable *table);
+
+// -----------------------------------------------------------
+
+#endif // NAME_TABLE_H
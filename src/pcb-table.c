@@ -0,0 +1,311 @@
+#include "pcb-table.h"
+#include "sim-alloc.h"
+#include "scheduler.h"
+#include <stdlib.h>
+#include <string.h>
+
+// -----------------------------------------------------------
+// Pid index
+// -----------------------------------------------------------
+
+// Function to find the home bucket of a pid
+/**
+ * @param table Pointer to the PCB table
+ * @param pid Process id
+ * @return Index of the home bucket
+ */
+static size_t home_bucket(const PcbTable *table, uint16_t pid)
+{
+    return (size_t)(pid * 2654435761u) & (table->index_size - 1);
+}
+
+// Function to find the bucket holding a pid, or the empty bucket where it belongs
+/**
+ * @param table Pointer to the PCB table
+ * @param pid Process id
+ * @return Index of the bucket
+ */
+static size_t find_bucket(const PcbTable *table, uint16_t pid)
+{
+    size_t mask = table->index_size - 1;
+    size_t bucket = home_bucket(table, pid);
+
+    // linear probing, the index is never more than half full
+    while (table->index[bucket] != NULL && table->index[bucket]->pid != pid)
+    {
+        bucket = (bucket + 1) & mask;
+    }
+    return bucket;
+}
+
+// Function to make room in the pid index for one more PCB
+/**
+ * @param table Pointer to the PCB table
+ * @return 0 on success, -1 if the index cannot be grown (it is left as it was)
+ */
+static int index_reserve(PcbTable *table)
+{
+    if ((table->live + 1) * 2 <= table->index_size)
+    {
+        return 0;
+    }
+
+    // double the buckets and reinsert every live PCB
+    PCB **index = (PCB **)sim_calloc(table->index_size * 2, sizeof(PCB *));
+    if (index == NULL)
+    {
+        return -1;
+    }
+    sim_free(table->index);
+    table->index = index;
+    table->index_size *= 2;
+    for (PCB *current = table->head; current != NULL; current = current->next)
+    {
+        table->index[find_bucket(table, current->pid)] = current;
+    }
+    return 0;
+}
+
+// Function to add a PCB to the pid index
+/**
+ * @param table Pointer to the PCB table (with room reserved for the PCB)
+ * @param pcb Pointer to the PCB
+ */
+static void index_insert(PcbTable *table, PCB *pcb)
+{
+    table->index[find_bucket(table, pcb->pid)] = pcb;
+}
+
+// Function to remove a PCB from the pid index
+/**
+ * Backward shift deletion: entries after the hole move up so lookups never need tombstones.
+ * @param table Pointer to the PCB table
+ * @param pid Process id
+ */
+static void index_remove(PcbTable *table, uint16_t pid)
+{
+    size_t mask = table->index_size - 1;
+    size_t hole = find_bucket(table, pid);
+    if (table->index[hole] == NULL)
+    {
+        return;
+    }
+
+    size_t next = hole;
+    for (;;)
+    {
+        next = (next + 1) & mask;
+        if (table->index[next] == NULL)
+        {
+            break;
+        }
+
+        // an entry can fill the hole if its home bucket is not between the hole and its slot
+        size_t home = home_bucket(table, table->index[next]->pid);
+        bool movable = (hole <= next) ? (home <= hole || home > next) : (home <= hole && home > next);
+        if (movable)
+        {
+            table->index[hole] = table->index[next];
+            hole = next;
+        }
+    }
+    table->index[hole] = NULL;
+}
+
+// -----------------------------------------------------------
+// Live list
+// -----------------------------------------------------------
+
+// Function to append a PCB to the live list and the pid index
+/**
+ * @param table Pointer to the PCB table (with room reserved in the index)
+ * @param pcb Pointer to the PCB
+ */
+static void append(PcbTable *table, PCB *pcb)
+{
+    index_insert(table, pcb);
+
+    pcb->next = NULL;
+    pcb->prev = table->tail;
+    if (table->tail != NULL)
+    {
+        table->tail->next = pcb;
+    }
+    else
+    {
+        table->head = pcb;
+    }
+    table->tail = pcb;
+    table->live++;
+}
+
+// Function to hand out the next unused pid
+/**
+ * The pids up to init's are never handed out, so a process is init only if it was forked from the template.
+ * @param table Pointer to the PCB table
+ * @param parent Pointer to the process calling fork
+ * @return A pid no live process uses, 0 if every pid above init's is taken (or init is forked twice)
+ */
+static uint16_t next_pid(PcbTable *table, const PCB *parent)
+{
+    if (parent == table->head)
+    {
+        return (pcb_table_find(table, PCB_TABLE_INIT_PID) == NULL) ? PCB_TABLE_INIT_PID : 0;
+    }
+
+    // the template holds no pid of the range, init may hold none of it (a free pid exists below this bound either way)
+    if (table->live - 1 >= (size_t)UINT16_MAX - PCB_TABLE_INIT_PID)
+    {
+        return 0;
+    }
+
+    // skip pids still in use once the counter wraps around (a free one exists, so this ends within one turn)
+    while (table->next_pid <= PCB_TABLE_INIT_PID || pcb_table_find(table, table->next_pid) != NULL)
+    {
+        table->next_pid++;
+    }
+    return table->next_pid++;
+}
+
+// -----------------------------------------------------------
+// Table
+// -----------------------------------------------------------
+
+// Function to initialize the PCB table with the init template
+/**
+ * @param table Pointer to the PCB table
+ * @return 0 on success, -1 if the table cannot be allocated (it can still be freed)
+ */
+int pcb_table_init(PcbTable *table)
+{
+    memset(table, 0, sizeof(*table));
+    pool_init(&table->pool, sizeof(PCB), PCB_TABLE_SLAB_SIZE);
+    table->index_size = PCB_TABLE_INITIAL_INDEX;
+    table->index = (PCB **)sim_calloc(table->index_size, sizeof(PCB *));
+    table->next_pid = PCB_TABLE_INIT_PID + 1;
+
+    PCB *pcb = (table->index != NULL) ? (PCB *)pool_alloc(&table->pool) : NULL;
+    if (pcb == NULL)
+    {
+        return -1;
+    }
+    memset(pcb, 0, sizeof(*pcb));
+    pcb->pid = PCB_TABLE_TEMPLATE_PID; // because we will fork and the init process will have a pid of 11, even tho i think init should start at 0...
+    pcb->partition_number = 6;
+    strcpy(pcb->program_name, "init");
+    pcb->program_size = 1;
+    pcb->state = PROCESS_READY;
+    append(table, pcb);
+    return 0;
+}
+
+// Function to fork a process
+/**
+ * @param table Pointer to the PCB table
+ * @param parent Pointer to the process calling fork
+ * @return Pointer to the child, a copy of the parent with a new pid, or NULL if every pid is in use or the PCB cannot be allocated
+ */
+PCB *pcb_table_fork(PcbTable *table, PCB *parent)
+{
+    uint16_t pid = next_pid(table, parent);
+    PCB *child = (pid != 0 && index_reserve(table) == 0) ? (PCB *)pool_alloc(&table->pool) : NULL;
+    if (child == NULL)
+    {
+        return NULL;
+    }
+    memcpy(child, parent, sizeof(PCB));
+
+    child->pid = pid;
+    child->ppid = parent->pid;
+    append(table, child);
+    return child;
+}
+
+// Function to put a checkpointed process back in the table under its own pid
+/**
+ * The fields are filled in by the caller, processes are restored in table order (see checkpoint.h).
+ * @param table Pointer to the PCB table
+ * @param pid Process id of the checkpointed process
+ * @return Pointer to a zeroed PCB holding the pid, or NULL if the pid is in use or reserved (or the PCB cannot be allocated)
+ */
+PCB *pcb_table_restore(PcbTable *table, uint16_t pid)
+{
+    if (pid <= PCB_TABLE_TEMPLATE_PID || pcb_table_find(table, pid) != NULL)
+    {
+        return NULL;
+    }
+
+    PCB *pcb = (index_reserve(table) == 0) ? (PCB *)pool_alloc(&table->pool) : NULL;
+    if (pcb == NULL)
+    {
+        return NULL;
+    }
+    memset(pcb, 0, sizeof(*pcb));
+    pcb->pid = pid;
+    append(table, pcb);
+    return pcb;
+}
+
+// Function to find a live process by pid
+/**
+ * @param table Pointer to the PCB table
+ * @param pid Process id
+ * @return Pointer to the process, or NULL if no live process has that pid
+ */
+PCB *pcb_table_find(const PcbTable *table, uint16_t pid)
+{
+    return table->index[find_bucket(table, pid)];
+}
+
+// Function to remove an exited process from the table and recycle its PCB
+/**
+ * @param table Pointer to the PCB table
+ * @param pcb Pointer to the PCB
+ */
+void pcb_table_release(PcbTable *table, PCB *pcb)
+{
+    index_remove(table, pcb->pid);
+
+    if (pcb->prev != NULL)
+    {
+        pcb->prev->next = pcb->next;
+    }
+    else
+    {
+        table->head = pcb->next;
+    }
+    if (pcb->next != NULL)
+    {
+        pcb->next->prev = pcb->prev;
+    }
+    else
+    {
+        table->tail = pcb->prev;
+    }
+    table->live--;
+    table->reaped++;
+
+    pool_release(&table->pool, pcb);
+}
+
+// Function to print the PCB table statistics at the end of the run
+/**
+ * @param table Pointer to the PCB table
+ * @param out Stream to print to
+ */
+void pcb_table_report(const PcbTable *table, FILE *out)
+{
+    fprintf(out, "PCB table: %zu live, %llu reaped, peak %zu PCBs in %zu bytes\n",
+            table->live - 1, (unsigned long long)table->reaped, table->pool.peak - 1, pool_footprint(&table->pool));
+}
+
+// Function to free the PCB storage and the pid index
+/**
+ * @param table Pointer to the PCB table
+ */
+void pcb_table_free(PcbTable *table)
+{
+    pool_free(&table->pool);
+    sim_free(table->index);
+    memset(table, 0, sizeof(*table));
+}
@@ -0,0 +1,45 @@
+#ifndef PCB_TABLE_H
+#define PCB_TABLE_H
+
+// configurations
+#define PCB_TABLE_SLAB_SIZE 256      // PCBs carved out of one pool slab
+#define PCB_TABLE_INITIAL_INDEX 64   // pid index buckets (power of two), doubled when half full
+#define PCB_TABLE_TEMPLATE_PID 10    // init template, init itself is forked from it as pid 11
+#define PCB_TABLE_INIT_PID 11        // init, forked from the template once: the pid is never handed out again
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <stdio.h>  // for FILE
+#include "pool.h"
+#include "process-simulator.h"
+
+// structs
+
+typedef struct PcbTable
+{
+    Pool pool;            // PCB storage, exited processes are recycled instead of freed
+    uint64_t reaped;      // processes released so far
+
+    PCB *head;            // first PCB of the live list (the init template)
+    PCB *tail;            // last PCB of the live list, appends are O(1)
+    size_t live;          // number of PCBs in the live list
+
+    PCB **index;          // open addressing pid -> PCB table (NULL = empty)
+    size_t index_size;    // number of buckets (power of two)
+    uint16_t next_pid;    // next pid handed out by pcb_table_fork
+} PcbTable;
+
+// -----------------------------------------------------------
+
+int pcb_table_init(PcbTable *table);
+PCB *pcb_table_fork(PcbTable *table, PCB *parent);
+PCB *pcb_table_restore(PcbTable *table, uint16_t pid);
+PCB *pcb_table_find(const PcbTable *table, uint16_t pid);
+void pcb_table_release(PcbTable *table, PCB *pcb);
+void pcb_table_report(const PcbTable *table, FILE *out);
+void pcb_table_free(PcbTable *table);
+
+// -----------------------------------------------------------
+
+#endif // PCB_TABLE_H
@@ -0,0 +1,104 @@
+#include "pool.h"
+#include "sim-alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Function to initialize an empty pool of fixed-size objects
+/**
+ * @param pool Pointer to the pool
+ * @param object_size Size of one object in bytes
+ * @param objects_per_slab Number of objects allocated at once when the pool runs dry
+ */
+void pool_init(Pool *pool, size_t object_size, size_t objects_per_slab)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    // round up so every object is aligned like a pointer and can hold the free list link
+    size_t align = sizeof(void *);
+    pool->object_size = (object_size < align) ? align : (object_size + align - 1) / align * align;
+    pool->objects_per_slab = (objects_per_slab == 0) ? 1 : objects_per_slab;
+}
+
+// Function to hand out an object, reusing a released one when possible
+/**
+ * @param pool Pointer to the pool
+ * @return Pointer to an uninitialized object, NULL if a new slab cannot be allocated
+ */
+void *pool_alloc(Pool *pool)
+{
+    void *object;
+
+    if (pool->free_list != NULL)
+    {
+        object = pool->free_list;
+        memcpy(&pool->free_list, object, sizeof(void *));
+    }
+    else
+    {
+        if (pool->slab_count == 0 || pool->slab_used == pool->objects_per_slab)
+        {
+            if (pool->slab_count == pool->slab_capacity)
+            {
+                size_t capacity = (pool->slab_capacity == 0) ? 8 : pool->slab_capacity * 2;
+                char **slabs = (char **)sim_realloc(pool->slabs, capacity * sizeof(char *));
+                if (slabs == NULL)
+                {
+                    return NULL;
+                }
+                pool->slabs = slabs;
+                pool->slab_capacity = capacity;
+            }
+            pool->slabs[pool->slab_count] = (char *)sim_malloc(pool->objects_per_slab * pool->object_size);
+            if (pool->slabs[pool->slab_count] == NULL)
+            {
+                return NULL;
+            }
+            pool->slab_count++;
+            pool->slab_used = 0;
+        }
+        object = pool->slabs[pool->slab_count - 1] + pool->slab_used++ * pool->object_size;
+    }
+
+    pool->live++;
+    if (pool->live > pool->peak)
+    {
+        pool->peak = pool->live;
+    }
+    return object;
+}
+
+// Function to give an object back to the pool
+/**
+ * @param pool Pointer to the pool
+ * @param object Pointer to an object handed out by pool_alloc
+ */
+void pool_release(Pool *pool, void *object)
+{
+    memcpy(object, &pool->free_list, sizeof(void *));
+    pool->free_list = object;
+    pool->live--;
+}
+
+// Function to get the memory held by the pool
+/**
+ * @param pool Pointer to the pool
+ * @return Bytes allocated for objects (the footprint only grows with the peak number of live objects)
+ */
+size_t pool_footprint(const Pool *pool)
+{
+    return pool->slab_count * pool->objects_per_slab * pool->object_size;
+}
+
+// Function to free every slab of the pool
+/**
+ * @param pool Pointer to the pool
+ */
+void pool_free(Pool *pool)
+{
+    for (size_t i = 0; i < pool->slab_count; i++)
+    {
+        sim_free(pool->slabs[i]);
+    }
+    sim_free(pool->slabs);
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,32 @@
+#ifndef POOL_H
+#define POOL_H
+
+// includes
+#include <stddef.h> // for size_t
+
+// structs
+
+typedef struct
+{
+    size_t object_size;      // bytes per object (at least a pointer, the free list is threaded through released objects)
+    size_t objects_per_slab; // objects carved out of one slab allocation
+    char **slabs;            // slab allocations, objects never move once handed out
+    size_t slab_count;       // number of slabs
+    size_t slab_capacity;    // allocated slots in slabs
+    size_t slab_used;        // objects handed out of the last slab
+    void *free_list;         // released objects ready for reuse
+    size_t live;             // objects currently handed out
+    size_t peak;             // most objects handed out at once
+} Pool;
+
+// -----------------------------------------------------------
+
+void pool_init(Pool *pool, size_t object_size, size_t objects_per_slab);
+void *pool_alloc(Pool *pool);
+void pool_release(Pool *pool, void *object);
+size_t pool_footprint(const Pool *pool);
+void pool_free(Pool *pool);
+
+// -----------------------------------------------------------
+
+#endif // POOL_H
@@ -1,643 +1,405 @@
 #include "process-simulator.h"
+#include "sim-alloc.h"
+#include "program-cache.h"
+#include "pcb-table.h"
+#include "memory-manager.h"
+#include "external-catalog.h"
+#include "log-emitter.h"
+#include "loader.h"
+#include "profile.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <stdbool.h>
-#include <assert.h>
 #include <stdint.h>
 
-// function to handle the fork event
+// Function to write the delta of a snapshot: the rows created or changed since the previous one and the pids gone from it
 /**
- * @param current_process Pointer to the current process
+ * @param status Pointer to the system status sink
+ * @param current_time Current time
+ * @param first Pointer to the first row of the table
  */
-void run_fork(PCB **current_process)
+static void save_status_delta(StatusSink *status, uint64_t current_time, const PCB *first)
 {
-    PCB *new_process = (PCB *)malloc(sizeof(PCB));
-    assert(new_process != NULL);
-
-    memcpy(new_process, *current_process, sizeof(PCB));
-
-    new_process->pid = (*current_process)->pid + 1;
-
-    new_process->parent = *current_process;
-    new_process->next = NULL;
-
-    PCB *last_process = *current_process;
-    while (last_process->next != NULL)
+    for (const PCB *current = first; current != NULL; current = current->next)
     {
-        last_process = last_process->next;
+        status_sink_track(status, current->pid, current->program_name, current->partition_number, current->program_size);
     }
+    status_sink_end(status);
 
-    last_process->next = new_process;
-
-    *current_process = new_process;
-}
-
-// function to handle the exec event
-/**
- * @param program_name Name of the program to execute
- * @param vector_table Pointer to the vector table
- * @param file Pointer to the output file
- * @param external_files Pointer to the external files array
- * @param external_file_count Number of external files
- * @param memory_partitions Pointer to the memory partitions array
- * @param current_process Pointer to pointer of the current process
- * @param current_time Pointer to the current time
- * @param duration Duration of the event
- */
-void run_exec(const char *program_name, const int *vector_table, FILE *file, ExternalFile *external_files, int external_file_count, MemoryPartition *memory_partitions, PCB **current_process, uint16_t *current_time, uint16_t duration)
-{
-    // Check if the current process is not the FIRST call to exec() (init process)
-    bool is_init = (*current_process)->pid == 11;
-    int program_size = -1;
+    // nothing changed: the previous snapshot still holds
+    if (status->changed_count + status->exited_count == 0)
+    {
+        return;
+    }
 
-    if (!(is_init))
+    if (status->format == LOG_FORMAT_BINARY)
     {
-        // 1. Find the size of the program from the external files
-        for (int i = 0; i < external_file_count; i++)
+        LogRecord delta = {.code = LOG_STATUS_DELTA, .time = current_time, .arg = (uint32_t)(status->changed_count + status->exited_count)};
+        status_sink_record(status, &delta);
+        for (size_t i = 0; i < status->exited_count; i++)
         {
-            if (strcmp(external_files[i].program_name, program_name) == 0)
-            {
-                program_size = external_files[i].size;
-                break;
-            }
+            LogRecord gone = {.code = LOG_STATUS_EXIT, .time = current_time, .pid = status->exited[i]};
+            status_sink_record(status, &gone);
         }
-
-        if (program_size == -1)
+        for (size_t i = 0; i < status->changed_count; i++)
         {
-            printf("Error: Program %s not found in external files\n", program_name);
-            return;
+            const StatusRow *row = &status->rows[status->changed[i]];
+            LogRecord changed = {.code = LOG_STATUS_ROW, .time = current_time, .pid = status->changed[i], .arg = row->size, .name = row->name, .partition = row->partition};
+            status_sink_record(status, &changed);
         }
     }
     else
     {
-        program_size = 1; // init process size is 1
-    }
-
-    // 2. Find the best fit memory partition for the program
-    // best fit algorithm searches the entire memory partitions array for the best fit.
-    MemoryPartition *candidate_partition = NULL;
-    for (int i = 0; i < MAX_PARTITIONS; i++)
-    {
-        if (strcmp(memory_partitions[i].code, "free") == 0 && memory_partitions[i].size >= program_size)
+        status_sink_printf(status, STATUS_DELTA_HEADER, (unsigned long long)current_time);
+        for (size_t i = 0; i < status->exited_count; i++)
         {
-            if (candidate_partition == NULL || memory_partitions[i].size < candidate_partition->size)
-            {
-                candidate_partition = &memory_partitions[i];
-            }
+            status_sink_printf(status, STATUS_DELTA_EXIT, status->exited[i]);
+        }
+        for (size_t i = 0; i < status->changed_count; i++)
+        {
+            const StatusRow *row = &status->rows[status->changed[i]];
+            status_sink_printf(status, STATUS_DELTA_ROW, status->changed[i], name_table_get(&status->names, row->name), row->partition, row->size);
         }
     }
-    // Check if a suitable partition was found
-    if (candidate_partition == NULL)
-    {
-        printf("Error: No suitable partition found for program %s\n", program_name);
-        return;
-    }
-
-    // Check if the current process is not the FIRST call to exec() (init process)
-    // now that we have all the information we can start the fprintf process
-    if ((!is_init))
-    {
-
-        // Random values for EXEC events THAT match the duration of the event.
-        uint16_t a = rand() % (duration + 1);         // load program into memory
-        uint16_t b = rand() % (duration - a + 1);     // find partition
-        uint16_t c = rand() % (duration - a - b + 1); // mark partition as occupied
-        uint16_t d = duration - a - b - c;            // update PCB with new information
-
-        fprintf(file, "%hu, %d, EXEC: load %s of size %dMb\n", *current_time, a, program_name, program_size);
-        *current_time += a;
-        fprintf(file, "%hu, %d, found partition %hu with %huMb of space\n", *current_time, b, candidate_partition->partition_number, program_size);
-        *current_time += b;
-        fprintf(file, "%hu, %d, partition %hu marked as occupied\n", *current_time, c, candidate_partition->partition_number);
-        *current_time += c;
-        fprintf(file, "%hu, %d, updating PCB with new information\n", *current_time, d);
-        *current_time += d;
-        fprintf(file, "%hu, 1, scheduler called\n", *current_time);
-        *current_time += 1;
-        fprintf(file, "%hu, 1, IRET\n", *current_time);
-    }
-
-    // 3. Mark the partition as occupied with the program name
-    strcpy(candidate_partition->code, program_name);
-
-    // 4. Update the PCB with the new information
-    (*current_process)->partition_number = candidate_partition->partition_number;
-    strcpy((*current_process)->program_name, (is_init) ? "init" : program_name);
-    (*current_process)->program_size = program_size;
-
-    // find the head of the pcb table
-    PCB *pcb_table = *current_process;
-    while (pcb_table->parent != NULL)
-    {
-        pcb_table = pcb_table->parent;
-    }
-
-    if (!is_init)
-    {
-        save_system_status(*current_time, pcb_table);
-        *current_time += 1;
-    }
-    // 5. Load the trace file for the program
-    TraceEvent trace_events[MAX_EVENTS];
-    int event_count = 0;
-
-    load_trace(program_name, trace_events, &event_count);
-
-    // 6. Call process_trace to run the process
-    process_trace(trace_events, event_count, vector_table, file, external_files, external_file_count, memory_partitions, *current_process, current_time);
-
-    // once execution is done, return execution to parent
-    *current_process = (*current_process)->parent;
+    status_sink_commit(status);
 }
 
 // Function to handle the system status
 /**
+ * @param status Pointer to the system status sink
  * @param current_time Current time
- * @param pcb_table Pointer to the PCB table
+ * @param pcbs Pointer to the PCB table
  */
-void save_system_status(uint16_t current_time, PCB *pcb_table)
+void save_system_status(StatusSink *status, uint64_t current_time, const PcbTable *pcbs)
 {
-    // this was a problem with the file needing to be opened multiple times and not to be cleared but rather to be cleared on the first run (once per simulation)
-
-    static int first_run = 1;
-    FILE *status_file;
+    PROFILE_START(snapshot);
+    // skip the init template at the head of the table
+    const PCB *first = pcbs->head->next;
 
-    if (first_run)
-    {
-        status_file = fopen("logs/system_status.txt", "w");
-        first_run = 0;
-    }
-    else
+    // with delta snapshots only the keyframes list the whole table
+    if (!status_sink_begin(status))
     {
-        status_file = fopen("logs/system_status.txt", "a");
+        save_status_delta(status, current_time, first);
+        PROFILE_STOP(snapshot, PROFILE_STATUS_SNAPSHOT);
+        return;
     }
 
-    if (!status_file)
+    if (status->format == LOG_FORMAT_BINARY)
     {
-        printf("Error: Cannot open system_status.txt for writing\n");
+        // one record for the snapshot, one per row, program names go to the string table
+        LogRecord snapshot = {.code = LOG_STATUS_SNAPSHOT, .time = current_time, .arg = (uint32_t)(pcbs->live - 1)};
+        status_sink_record(status, &snapshot);
+        for (const PCB *current = first; current != NULL; current = current->next)
+        {
+            LogRecord row = {.code = LOG_STATUS_ROW, .time = current_time, .pid = current->pid, .arg = current->program_size, .partition = current->partition_number};
+            row.name = status_sink_track(status, current->pid, current->program_name, current->partition_number, current->program_size);
+            status_sink_record(status, &row);
+        }
+        status_sink_end(status);
+        status_sink_commit(status);
+        PROFILE_STOP(snapshot, PROFILE_STATUS_SNAPSHOT);
         return;
     }
 
-    fprintf(status_file, "!----------------------------------------------------------!\n");
-    fprintf(status_file, "Save Time: %hu ms\n", current_time);
-    fprintf(status_file, "+-----------------------------------------------+\n");
-    fprintf(status_file, "| PID  | Program Name | Partition Number | Size |\n");
-    fprintf(status_file, "+-----------------------------------------------+\n");
+    // the sink is opened (and truncated) once in main, every snapshot is appended to its buffer
+    status_sink_printf(status, STATUS_SNAPSHOT_HEADER, (unsigned long long)current_time);
 
-    PCB *current = pcb_table;
-    current = current->next;
+    const PCB *current = first;
     while (current != NULL)
     {
-        fprintf(status_file, "| %-4hu | %-12s | %-16hu | %-4hu |\n", current->pid, current->program_name, current->partition_number, current->program_size);
+        status_sink_printf(status, STATUS_SNAPSHOT_ROW, current->pid, current->program_name, current->partition_number, current->program_size);
+        if (status->keyframe_every != 0)
+        {
+            status_sink_track(status, current->pid, current->program_name, current->partition_number, current->program_size); // what the next deltas compare with
+        }
         current = current->next;
     }
+    status_sink_end(status);
 
-    fprintf(status_file, "+-----------------------------------------------+\n");
-    fprintf(status_file, "!----------------------------------------------------------!\n");
+    status_sink_printf(status, STATUS_SNAPSHOT_FOOTER);
 
-    fclose(status_file);
+    // snapshot is complete, let the sink decide whether to flush
+    status_sink_commit(status);
+    PROFILE_STOP(snapshot, PROFILE_STATUS_SNAPSHOT);
 }
 
 // Declaration of the load_external_files function
 /**
+ * One program per line: "<program name>, <size>[, <priority>]".
  * @param filename Name of the file to load
- * @param external_files Pointer to the external files array
- * @param external_file_count Pointer to the external file count
+ * @param catalog Pointer to the catalog the external files are added to
+ * @return 0 on success, -1 if the file cannot be read or a line is malformed (the error is printed)
  */
-void load_external_files(const char *filename, ExternalFile *external_files, int *external_file_count)
+int load_external_files(const char *filename, ExternalCatalog *catalog)
 {
-    FILE *file = fopen(filename, "r"); // Open file for reading
-    if (!file)
+    MappedFile file;
+    if (mapped_file_open(&file, filename) != 0)
     {
         printf("Error: Cannot open file %s\n", filename);
-        exit(1);
+        return -1;
     }
 
-    // buffer to store each line
-    char line[256];
+    Scanner scanner;
+    scanner_init(&scanner, &file, filename);
+    int result = 0;
 
-    // read each line, parse it, store in the external_files array
-    while (fgets(line, sizeof(line), file))
+    // parse each line and add it to the catalog (no limit on the number of programs)
+    while (result == 0 && scanner_next_line(&scanner))
     {
-        ExternalFile current_file;
+        const char *name;
+        size_t length;
+        uint32_t size;
+        uint32_t priority = 0; // the priority column is optional
 
-        // Parse
-        if (sscanf(line, "%[^,], %hu", current_file.program_name, &current_file.size) == 2)
+        result = scanner_field(&scanner, &name, &length);
+        if (result == 0 && length > LOADER_MAX_NAME)
         {
-            // Store the parsed external file in the external_files array
-            external_files[*external_file_count] = current_file;
-            (*external_file_count)++;
+            result = scanner_fail(&scanner, "program name longer than %d characters", LOADER_MAX_NAME);
         }
-        else
+        result = (result == 0) ? scanner_expect(&scanner, ',') : result;
+        result = (result == 0) ? scanner_uint(&scanner, UINT32_MAX, &size) : result;
+        if (result == 0 && scanner_accept(&scanner, ','))
         {
-            printf("Error: Line format not recognized: %s", line);
+            result = scanner_uint(&scanner, UINT8_MAX, &priority);
+        }
+        result = (result == 0) ? scanner_end_line(&scanner) : result;
+
+        if (result == 0)
+        {
+            // Store the parsed external file in the catalog, indexed by the interned program name
+            char program_name[LOADER_MAX_NAME + 1];
+            memcpy(program_name, name, length);
+            program_name[length] = '\0';
+            if (external_catalog_add(catalog, program_name, size, (uint8_t)priority) < 0)
+            {
+                result = scanner_fail(&scanner, "out of memory adding program %s", program_name);
+            }
         }
     }
 
-    fclose(file);
+    if (result != 0)
+    {
+        printf("Error: %s\n", scanner.error);
+    }
+    mapped_file_close(&file);
+    return result;
 }
 
-// Function to load trace events from a file
+// Function to parse one trace event
 /**
- * @param filename Name of the file to load
- * @param trace Pointer to the trace array
- * @param event_count Pointer to the event count
+ * Lines are "CPU, <duration>", "SYSCALL <vector>, <duration>", "END_IO <vector>, <duration>",
+ * "FORK, <duration>" or "EXEC <program name>, <duration>".
+ * @param scanner Pointer to the scanner, at the start of the line
+ * @param names Pointer to the name table EXEC program names are interned in
+ * @param vector_count Vectors in the vector table, a SYSCALL or END_IO naming a vector past them is rejected
+ * @param event Pointer to the parsed event
+ * @return 0 on success, -1 if the line is malformed
  */
-void load_trace(const char *filename, TraceEvent *trace, int *event_count)
+int parse_trace_event(Scanner *scanner, NameTable *names, uint32_t vector_count, TraceEvent *event)
 {
-    // check if filename has a .txt extension (trap)
-    bool trap = (strstr(filename, ".txt") == (filename + strlen(filename) - 4));
-
-    // create a new filename with .txt extension
-    char new_filename[20];
-    strcpy(new_filename, filename);
-    strcat(new_filename, ".txt");
-
-    // open the file for reading
-    FILE *file = (trap) ? fopen(filename, "r") : fopen(new_filename, "r");
-
-    // -----------------------------------------------------------
-    // Open the trace file
-    // -----------------------------------------------------------
-    if (strncmp(filename, "program", 7) == 0)
-    {
-        // Construct the new filename with the additional path
-        char new_filename[256];
-        snprintf(new_filename, sizeof(new_filename), "additionalFiles/%s.txt", filename);
-        file = fopen(new_filename, "r");
-    }
-    else
+    const char *word;
+    size_t length;
+    if (scanner_word(scanner, &word, &length) != 0)
     {
-        file = fopen(filename, "r");
+        return -1;
     }
 
-    // Check if the file was successfully opened
-    if (!file)
+    uint32_t vector = 0;
+    uint32_t duration;
+    if (length == 3 && memcmp(word, "CPU", 3) == 0)
     {
-        printf("Error: Cannot open file %s\n", (trap) ? filename : new_filename);
-        exit(1);
+        event->type = EVENT_CPU;
     }
-
-    // buffer to store each line
-    char line[256];
-
-    // read each line, parse it, store in the trace array
-    while (fgets(line, sizeof(line), file))
+    else if ((length == 6 && memcmp(word, "END_IO", 6) == 0) || (length == 7 && memcmp(word, "SYSCALL", 7) == 0))
     {
-        TraceEvent current_event;
-        current_event.vector = -1; // Default vector to -1
-
-        // Check if the line contains "CPU" OR "END_IO" OR "SYSCALL" OR "FORK" OR "EXEC"
-        if (sscanf(line, "CPU, %hu", &current_event.duration) == 1)
-        {
-            strcpy(current_event.type, "CPU");
-        }
-        else if (sscanf(line, "END_IO %hd, %hu", &current_event.vector, &current_event.duration) == 2)
+        // the vector is stored in a single byte, it has to index the vector table
+        event->type = (length == 6) ? EVENT_END_IO : EVENT_SYSCALL;
+        if (scanner_uint(scanner, VECTOR_TABLE_SIZE - 1, &vector) != 0)
         {
-            strcpy(current_event.type, "END_IO");
+            return -1;
         }
-        else if (sscanf(line, "SYSCALL %hd, %hu", &current_event.vector, &current_event.duration) == 2)
+        if (vector >= vector_count)
         {
-            strcpy(current_event.type, "SYSCALL");
+            return scanner_fail(scanner, "vector %u is not in the vector table (%u vectors)", vector, vector_count);
         }
-        else if (sscanf(line, "FORK, %hu", &current_event.duration) == 1)
+    }
+    else if (length == 4 && memcmp(word, "FORK", 4) == 0)
+    {
+        event->type = EVENT_FORK;
+        vector = 2; // default vector is 2
+    }
+    else if (length == 4 && memcmp(word, "EXEC", 4) == 0)
+    {
+        const char *name;
+        if (scanner_field(scanner, &name, &length) != 0)
         {
-            strcpy(current_event.type, "FORK");
-            current_event.vector = 2; // default vector is 2
+            return -1;
         }
-        else if (sscanf(line, "EXEC %[^,], %hu", current_event.program_name, &current_event.duration) == 2)
+        if (length > LOADER_MAX_NAME)
         {
-            strcpy(current_event.type, "EXEC");
-            current_event.vector = 3; // default vector is 3
+            return scanner_fail(scanner, "program name longer than %d characters", LOADER_MAX_NAME);
         }
-        else
+
+        char program_name[LOADER_MAX_NAME + 1];
+        memcpy(program_name, name, length);
+        program_name[length] = '\0';
+        event->type = EVENT_EXEC;
+        event->program_id = name_table_intern(names, program_name);
+        if (event->program_id == NAME_NOT_FOUND)
         {
-            printf("Error: Line format not recognized: %s", line);
-            continue; // Skip to the end of the loop
+            return scanner_fail(scanner, "out of memory interning program name %s", program_name);
         }
-
-        // Store the parsed event in the trace array
-        trace[*event_count] = current_event;
-        (*event_count)++;
+        vector = 3; // default vector is 3
+    }
+    else
+    {
+        scanner->cursor = word;
+        return scanner_fail(scanner, "unknown event '%.*s'", (int)length, word);
     }
 
-    fclose(file);
+    // durations are 32 bits, the 64-bit clock cannot wrap adding them
+    if (scanner_expect(scanner, ',') != 0 || scanner_uint(scanner, UINT32_MAX, &duration) != 0)
+    {
+        return -1;
+    }
+    event->vector = (uint8_t)vector;
+    event->duration = duration;
+    return scanner_end_line(scanner);
 }
 
-// Function to load the vector table from a file
+// Function to find the file holding a trace
 /**
- * @param filename Name of the file to load
- * @param vector_table Pointer to the vector table array
+ * @param programs_dir Directory of the programs named in an EXEC
+ * @param filename Program name from an EXEC, or path of a trace file
+ * @param path Buffer receiving the path of the file
+ * @param size Size of the buffer
  */
-void load_vector_table(const char *filename, int *vector_table)
+void trace_file_path(const char *programs_dir, const char *filename, char *path, size_t size)
 {
-    FILE *file = fopen(filename, "r");
-    if (!file)
+    // programs named in an EXEC live in the programs directory, anything else is a path
+    if (strncmp(filename, "program", 7) == 0)
     {
-        printf("Error: Cannot open file %s\n", filename);
-        exit(1);
+        snprintf(path, size, "%s/%s.txt", programs_dir, filename);
     }
-
-    char line[256];
-    int index = 0;
-
-    // Read each line from the file and parse it into vector table array
-    while (fgets(line, sizeof(line), file))
+    else
     {
-        int is_success = (sscanf(line, "%X", &vector_table[index]) == 1);
-        index += (is_success) ? 1 : 0;
-
-        if (!is_success)
-        {
-            printf("Error: Line format not recognized: %s", line); // Debug print for unrecognized format
-        }
+        snprintf(path, size, "%s", filename);
     }
-    fclose(file);
 }
 
-// Function to process the trace and log the events
+// Function to load trace events from a file
 /**
- * @param trace Pointer to the trace array
- * @param event_count Number of events in the trace
- * @param vector_table Pointer to the vector table array
- * @param file Pointer to the output file
- * @param external_files Pointer to the external files array
- * @param external_file_count Number of external files
- * @param partitions Pointer to the memory partitions array
- * @param current_process Pointer to the current process
- * @param current_time Pointer to the current time
+ * @param programs_dir Directory of the programs named in an EXEC
+ * @param filename Name of the file to load
+ * @param names Pointer to the name table EXEC program names are interned in
+ * @param vector_count Vectors in the vector table
+ * @param trace Pointer to the trace array (caller frees, NULL on failure)
+ * @param event_count Pointer to the event count
+ * @return 0 on success, -1 if the file cannot be read or a line is malformed (the error is printed)
  */
-void process_trace(TraceEvent *trace, int event_count, const int *vector_table, FILE *file, ExternalFile *external_files, int external_file_count, MemoryPartition *partitions, PCB *current_process, uint16_t *current_time)
+int load_trace(const char *programs_dir, const char *filename, NameTable *names, uint32_t vector_count, TraceEvent **trace, size_t *event_count)
 {
-    // check if the file is NULL
-    if (!file)
+    // -----------------------------------------------------------
+    // Map the trace file
+    // -----------------------------------------------------------
+
+    PROFILE_START(load);
+    char path[4096];
+    trace_file_path(programs_dir, filename, path, sizeof(path));
+
+    MappedFile file;
+    if (mapped_file_open(&file, path) != 0)
     {
-        printf("Error: Cannot open output file\n");
-        exit(1);
+        printf("Error: Cannot open file %s\n", path);
+        // failed loads are still time spent loading
+        PROFILE_STOP(load, PROFILE_LOAD_TRACE);
+        return -1;
     }
 
-    // Used to alternate between the two SYSCALL events (display and transfer data)
-    bool which_syscall = false;
-    // check if were in init (used for ASSUMPTION METHOD 2, can be ignored.)
-    bool is_init = (current_process->pid == (11 - 1));
-    // iterate through the current process's parent to get the pcb table
-    PCB *pcb_table = current_process;
-    while (pcb_table->parent != NULL)
+    // one event per line at most, so the array is sized once (traces have no length limit)
+    size_t capacity = mapped_file_lines(&file);
+    *trace = (TraceEvent *)sim_malloc((capacity > 0 ? capacity : 1) * sizeof(TraceEvent));
+    *event_count = 0;
+    if (*trace == NULL)
     {
-        pcb_table = pcb_table->parent;
+        printf("Error: Out of memory loading %s (%zu events)\n", path, capacity);
+        mapped_file_close(&file);
+        PROFILE_STOP(load, PROFILE_LOAD_TRACE);
+        return -1;
     }
 
-    // Loop through each event in the trace
-    for (int i = 0; i < event_count; i++)
-        if (strcmp(trace[i].type, "CPU") == 0) // Check if the event is a CPU event
-        {
-            fprintf(file, "%d, %d, CPU execution\n", *current_time, trace[i].duration);
-            *current_time += trace[i].duration;
-        }
-        else if (strcmp(trace[i].type, "SYSCALL") == 0) // Check if the event is a SYSCALL event
-        {
-            // Random values for the SYSCALL events THAT match the duration of the event.
-            int duration = trace[i].duration;
-            int a = rand() % (duration + 1);     // for run the ISR
-            int b = rand() % (duration - a + 1); // for transfer data
-            int c = duration - a - b;            // check for errors
-
-            fprintf(file, "%d, 1, switch to kernel mode\n", *current_time);
-            *current_time += 1;
-            int context_time = (rand() % 3) + 1; // random context switch time (1-3)
-            fprintf(file, "%d, %d, context saved\n", *current_time, context_time);
-            *current_time += context_time;
-            fprintf(file, "%d, 1, find vector %d in memory position 0x%04X\n", *current_time, trace[i].vector, trace[i].vector * 2);
-            *current_time += 1;
-            fprintf(file, "%d, 1, load address 0X%04X into the PC\n", *current_time, vector_table[trace[i].vector]);
-            *current_time += 1;
-            fprintf(file, "%d, %d, SYSCALL: run the ISR\n", *current_time, a);
-            *current_time += a;
-            if (which_syscall)
-            {
-                fprintf(file, "%d, %d, transfer data to display\n", *current_time, b);
-            }
-            else
-            {
-                fprintf(file, "%d, %d, transfer data\n", *current_time, b);
-            }
-            which_syscall = !which_syscall;
-
-            *current_time += b;
-            fprintf(file, "%d, %d, check for errors\n", *current_time, c);
-            *current_time += c;
-            fprintf(file, "%d, 1, IRET\n", *current_time);
-            save_system_status(*current_time, pcb_table);
-            *current_time += 1;
-        }
-        else if (strcmp(trace[i].type, "END_IO") == 0) // Check if the event is an END_IO event
-        {
-            fprintf(file, "%d, 1, check priority of interrupt\n", *current_time);
-            *current_time += 1;
-            fprintf(file, "%d, 1, check if masked\n", *current_time);
-            *current_time += 1;
-            fprintf(file, "%d, 1, switch to kernel mode\n", *current_time);
-            *current_time += 1;
-            fprintf(file, "%d, 3, context saved\n", *current_time);
-            *current_time += 3;
-            fprintf(file, "%d, 1, find vector %d in memory position 0x%04X\n", *current_time, trace[i].vector, trace[i].vector * 2);
-            *current_time += 1;
-            fprintf(file, "%d, 1, load address 0X%04X into the PC\n", *current_time, vector_table[trace[i].vector]);
-            *current_time += 1;
-            fprintf(file, "%d, %d, END_IO\n", *current_time, trace[i].duration);
-            *current_time += trace[i].duration;
-            fprintf(file, "%d, 1, IRET\n", *current_time);
-            save_system_status(*current_time, pcb_table);
-            *current_time += 1;
-        }
-        else if (strcmp(trace[i].type, "FORK") == 0) // Check if the event is a FORK event
-        {
-            if (!(is_init))
-            {
-                // "Random" values for FORK events THAT match the duration of the event.
-                int duration = trace[i].duration;
-                int a = rand() % (duration + 1); // for copy parent PCB to child PCB
-                int b = duration - a;            // for scheduler called
-
-                fprintf(file, "%d, 1, switch to kernel mode\n", *current_time);
-                *current_time += 1;
-                fprintf(file, "%d, 3, context saved\n", *current_time);
-                *current_time += 3;
-                fprintf(file, "%d, 1, find vector %d in memory position 0x%04X\n", *current_time, trace[i].vector, trace[i].vector * 2);
-                *current_time += 1;
-                fprintf(file, "%d, 1, load address 0X%04X into the PC\n", *current_time, vector_table[trace[i].vector]);
-                *current_time += 1;
-                fprintf(file, "%d, %d, FORK: copy parent PCB to child PCB\n", *current_time, a);
-                *current_time += a;
-                fprintf(file, "%d, %d, scheduler called\n", *current_time, b);
-                *current_time += b;
-                fprintf(file, "%d, 1, IRET\n", *current_time);
-            }
-            run_fork(&current_process);
-            save_system_status(*current_time, pcb_table);
-            *current_time += 1; // insure we take a snapshot of PCB table before we increment time
-        }
-        else if (strcmp(trace[i].type, "EXEC") == 0) // Check if the event is an EXEC event
+    // parse each line in a single pass, store in the trace array
+    Scanner scanner;
+    scanner_init(&scanner, &file, path);
+    int result = 0;
+    while (result == 0 && scanner_next_line(&scanner))
+    {
+        TraceEvent current_event = {0};
+        result = parse_trace_event(&scanner, names, vector_count, &current_event);
+        if (result == 0)
         {
-            if (!(is_init))
-            {
-                fprintf(file, "%hu, 1, switch to kernel mode\n", *current_time);
-                *current_time += 1;
-                uint8_t context_time = (rand() % 3) + 1; // random context switch time (1-3)
-                fprintf(file, "%hu, %u, context saved\n", *current_time, context_time);
-                *current_time += context_time;
-                fprintf(file, "%hu, 1, find vector %d in memory position 0x%04X\n", *current_time, trace[i].vector, trace[i].vector * 2);
-                *current_time += 1;
-                fprintf(file, "%hu, 1, load address 0X%04X into the PC\n", *current_time, vector_table[trace[i].vector]);
-                *current_time += 1;
-            }
-            run_exec(trace[i].program_name, vector_table, file, external_files, external_file_count, partitions, &current_process, current_time, trace[i].duration);
+            (*trace)[*event_count] = current_event;
+            (*event_count)++;
         }
-}
-
-// Function to initialize a PCB
-/**
- * @param pcb Pointer to the PCB to initialize
- * @return Pointer to the initialized PCB
- */
-PCB *init_pcb(PCB *pcb)
-{
-    pcb->pid = 10; // because we will fork and the init process will have a pid of 11, even tho i think init should start at 0...
-    pcb->cpu_time = 0;
-    pcb->io_time = 0;
-    pcb->remaining_cpu_time = 0;
-    pcb->partition_number = 6;
-    strcpy(pcb->program_name, "init");
-    pcb->program_size = 1;
-    pcb->parent = NULL;
-    pcb->next = NULL;
-    return pcb;
-}
+    }
 
-// Function to free the PCB linked list
-/**
- * @param pcb_table Pointer to the PCB linked list
- */
-void free_pcb_list(PCB *pcb_table)
-{
-    PCB *temp;
-    PCB *current = pcb_table;
-    while (current != NULL)
+    if (result != 0)
     {
-        temp = current;
-        current = current->next;
-        free(temp);
+        printf("Error: %s\n", scanner.error);
+        // the caller only owns a trace that loaded
+        sim_free(*trace);
+        *trace = NULL;
+        *event_count = 0;
     }
+    mapped_file_close(&file);
+    PROFILE_STOP(load, PROFILE_LOAD_TRACE);
+    return result;
 }
 
-// Main function to handle command-line arguments and call the appropriate functions
-int main(int argc, char *argv[])
+// Function to load the vector table from a file
+/**
+ * One hexadecimal ISR address per line, vector 0 first.
+ * @param filename Name of the file to load
+ * @param vector_table Pointer to the vector table array
+ * @param vector_count Pointer to the number of vectors loaded
+ * @return 0 on success, -1 if the file cannot be read or a line is malformed (the error is printed)
+ */
+int load_vector_table(const char *filename, int *vector_table, uint32_t *vector_count)
 {
-    if (argc != 5)
+    MappedFile file;
+    if (mapped_file_open(&file, filename) != 0)
     {
-        printf("Usage: %s <trace_file> <external_files> <vector_table_file> <output_file>\n", argv[0]);
-        return 1;
-    }
-
-    // Seed
-    srand(time(NULL));
-
-    // -----------------------------------------------------------
-    // Loading
-    // -----------------------------------------------------------
-
-    // Load trace events, ASSUMPION: init is initialized by a trace file
-    // TraceEvent trace_events[MAX_EVENTS];
-    // int event_count = 0;
-    // load_trace(argv[1], trace_events, &event_count);
-
-    // Load external files
-    ExternalFile external_files[MAX_EXTERNAL_FILES];
-    int external_file_count = 0;
-    load_external_files(argv[2], external_files, &external_file_count);
-
-    // Load vector table
-    int vector_table[VECTOR_TABLE_SIZE];
-    load_vector_table(argv[3], vector_table);
-
-    // -----------------------------------------------------------
-    // Initialization
-    // -----------------------------------------------------------
-
-    // Initialize memory partitions
-    MemoryPartition partitions[MAX_PARTITIONS] = {{1, 40, "free"}, {2, 25, "free"}, {3, 15, "free"}, {4, 10, "free"}, {5, 8, "free"}, {6, 2, "free"}};
-
-    // Open the output file to stream the output
-    FILE *file = fopen(argv[4], "w");
-    if (!file)
-    {
-        printf("Error: Cannot open output file %s\n", argv[4]);
-        return 1;
+        printf("Error: Cannot open file %s\n", filename);
+        return -1;
     }
 
-    // Initialize PCB (linked list) with the init template
-    PCB pcb_head;
-    PCB *current_process = init_pcb(&pcb_head);
-
-    // Initialize the current time
-    uint16_t current_time = 0;
-
-    // -----------------------------------------------------------
-    // Simulation
-    // -----------------------------------------------------------
-
-    // ASSUMPION: init is initialized by a trace file
-    // process_trace(trace_events, event_count, vector_table, file, external_files, external_file_count, partitions, current_process, &current_time);
-
-    // Fork the init process
-    run_fork(&current_process);
-    // snapshot the pcb table
-    save_system_status(current_time, &pcb_head);
-    // run the simulation
-    run_exec(argv[1], vector_table, file, external_files, external_file_count, partitions, &current_process, &current_time, 0);
-
-    // -----------------------------------------------------------
-    // Cleanup
-    // -----------------------------------------------------------
-
-    printf("Simulation complete\n");
-    fclose(file);                 // Close the output file
-    free_pcb_list(pcb_head.next); // free the PCB linked list
-
-    // -----------------------------------------------------------
-    // Debugging Section
-    // -----------------------------------------------------------
+    Scanner scanner;
+    scanner_init(&scanner, &file, filename);
+    int result = 0;
+    int index = 0;
 
-    if (DEBUG_MODE)
+    // parse each line into the vector table array
+    while (result == 0 && scanner_next_line(&scanner))
     {
-        // Print the output trace
-        char choice;
-        printf("Execution trace saved to %s\n", argv[3]);
-        printf("Would you like to print the execution trace? (y/n): ");
-        scanf("%c", &choice);
-
-        if ((choice == 'y') || (choice == 'Y'))
+        uint32_t address;
+        if (index == VECTOR_TABLE_SIZE)
         {
-            FILE *file = fopen(argv[3], "r"); // Open file for reading
-            if (!file)
-            {
-                printf("Error: Cannot open file %s\n", argv[3]); // Print error if file can't be opened
-            }
-
-            int i = 0;
-            char line[256];
-            // Read each line from the file and print it
-            while (fgets(line, sizeof(line), file))
-            {
-                printf("Execution Trace Line %d: ", i);
-                printf("%s", line);
-                i++;
-            }
+            result = scanner_fail(&scanner, "more than %d vectors", VECTOR_TABLE_SIZE);
+        }
+        result = (result == 0) ? scanner_hex(&scanner, &address) : result;
+        result = (result == 0) ? scanner_end_line(&scanner) : result;
+        if (result == 0)
+        {
+            vector_table[index++] = (int)address;
         }
+    }
 
-        printf("\n\tGoodbye %s!\n\n", argv[1]);
+    if (result != 0)
+    {
+        printf("Error: %s\n", scanner.error);
     }
-    return 0;
+    *vector_count = (uint32_t)index;
+    mapped_file_close(&file);
+    return result;
 }
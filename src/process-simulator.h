@@ -2,69 +2,89 @@
 #define PROCESS_SIMULATOR_H
 
 // configurations
-#define MAX_EVENTS 300
-#define MAX_PARTITIONS 6
-#define MAX_EXTERNAL_FILES 100
 #define VECTOR_TABLE_SIZE 256
+#define PROGRAMS_DEFAULT_DIR "additionalFiles" // where the programs named in an EXEC are found
 #define DEBUG_MODE 0 // used for debugging at the end of main.c
 
 // includes
 #include <stdio.h>  // for FILE
 #include <stdint.h> // for int types
+#include <stddef.h> // for size_t
+#include <stdbool.h>
+#include "status-sink.h"
 
 // structs
 
-typedef struct
+typedef enum
 {
-    char type[10];         // CPU or SYSCALL or END_IO, FORK, EXEC
-    uint16_t duration;     // Duration of the event
-    char program_name[20]; // Optional, ProgramName for EXEC
-    int16_t vector;        // Optional, Vector number for SYSCALL, END_IO
-} TraceEvent;
+    EVENT_CPU,
+    EVENT_SYSCALL,
+    EVENT_END_IO,
+    EVENT_FORK,
+    EVENT_EXEC
+} EventType;
 
 typedef struct
 {
-    uint16_t partition_number;
-    uint16_t size;
-    char code[20]; // "free", "init", or program name
-} MemoryPartition;
+    uint8_t type;        // EventType
+    uint8_t vector;      // Vector number for SYSCALL, END_IO (2 for FORK, 3 for EXEC)
+    uint32_t duration;   // Duration of the event (ms)
+    uint32_t program_id; // Optional, interned ProgramName for EXEC (see program-cache.h)
+} TraceEvent;
+
+typedef struct MemoryPartition MemoryPartition; // see memory-manager.h
+
+typedef struct Program Program; // parsed trace shared by every EXEC, see program-cache.h
 
 typedef struct PCB
 {
     uint16_t pid;
-    uint16_t cpu_time;
-    uint16_t io_time;
-    uint16_t remaining_cpu_time;
-    uint16_t partition_number;
+    uint64_t cpu_time;
+    uint64_t io_time;
+    uint32_t remaining_cpu_time;
+    uint32_t partition_number;
+    MemoryPartition *partition; // partition the program was loaded into, NULL until the process execs
+    uint32_t *page_table;     // frame of each page of the image (--paging), NULL until the process execs
+    uint32_t page_count;      // pages in the image
     char program_name[20];
-    uint16_t program_size;
-    struct PCB *parent;
-    struct PCB *next;
+    uint32_t program_size;
+    uint16_t ppid;            // pid of the process that forked this one (looked up in the PCB table, never dereferenced after exit)
+    struct PCB *next;         // next PCB in the table (or in the free list once released)
+    struct PCB *prev;         // previous PCB in the table, unlinking is O(1)
+    const Program *program;   // trace being executed (owned by the program cache)
+    size_t pc;                // index of the next event to execute in program
+    bool which_syscall;       // alternates between the two SYSCALL data transfer messages
+    bool shares_parent_trace; // forked and not exec'd yet: the parent resumes where this process leaves the trace
+    uint8_t state;            // ProcessState, see scheduler.h
+    uint8_t priority;         // lower runs first under the priority scheduler
+    uint8_t core;             // core whose run queue the process joins when it is ready (the one it last ran on)
+    uint64_t arrival_time;    // time the process was created
+    uint64_t ready_since;     // time the process last entered the ready queue
+    uint64_t wake_time;       // time a blocked process' I/O completes
+    uint64_t wait_time;       // total time spent in the ready queue
+    uint64_t ready_key;       // ready queue ordering, depends on the policy
+    uint64_t ready_seq;       // ready queue tie breaker (insertion order)
 } PCB;
 
-typedef struct
-{
-    char program_name[20];
-    uint16_t size;
-} ExternalFile;
+typedef struct ProgramCache ProgramCache;       // parsed traces shared by every EXEC, see program-cache.h
+typedef struct NameTable NameTable;             // interned program names, see name-table.h
+typedef struct ExternalCatalog ExternalCatalog; // program sizes and priorities by program id, see external-catalog.h
 
-// -----------------------------------------------------------
-
-void run_fork(PCB **current_process);
-void run_exec(const char *program_name, const int *vector_table, FILE *file, ExternalFile *external_files, int external_file_count, MemoryPartition *memory_partitions, PCB **current_process, uint16_t *current_time, uint16_t duration);
+typedef struct PcbTable PcbTable;               // slab allocated PCBs indexed by pid, see pcb-table.h
 
 // -----------------------------------------------------------
 
-PCB *init_pcb(PCB *pcb);
-void free_pcb_list(PCB *pcb_table);
-void save_system_status(uint16_t current_time, PCB *pcb_table);
-void load_external_files(const char *filename, ExternalFile *external_files, int *external_file_count);
+void save_system_status(StatusSink *status, uint64_t current_time, const PcbTable *pcbs);
+int load_external_files(const char *filename, ExternalCatalog *catalog);
 
 // -----------------------------------------------------------
 
-void load_trace(const char *filename, TraceEvent *trace, int *event_count);
-void load_vector_table(const char *filename, int *vector_table);
-void process_trace(TraceEvent *trace, int event_count, const int *vector_table, FILE *file, ExternalFile *external_files, int external_file_count, MemoryPartition *partitions, PCB *current_process, uint16_t *current_time);
+typedef struct Scanner Scanner; // tokenizer over a mapped file, see loader.h
+
+void trace_file_path(const char *programs_dir, const char *filename, char *path, size_t size);
+int parse_trace_event(Scanner *scanner, NameTable *names, uint32_t vector_count, TraceEvent *event);
+int load_trace(const char *programs_dir, const char *filename, NameTable *names, uint32_t vector_count, TraceEvent **trace, size_t *event_count);
+int load_vector_table(const char *filename, int *vector_table, uint32_t *vector_count);
 
 // -----------------------------------------------------------
 
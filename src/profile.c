@@ -0,0 +1,222 @@
+#include "profile.h"
+#include <stdlib.h>
+#include <time.h>
+
+// Function to read the monotonic clock
+/**
+ * @return Monotonic time (ns)
+ */
+uint64_t profile_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+#ifdef SIM_PROFILE
+
+#include <pthread.h>
+
+static const char *phase_names[PROFILE_PHASE_COUNT] = {
+    "load_trace", "schedule", "event_cpu", "event_syscall", "event_end_io", "event_fork", "event_exec",
+    "partition_search", "status_snapshot", "status_write", "log_write"};
+
+static const char *counter_names[PROFILE_COUNTER_COUNT] = {
+    "events", "log_bytes", "status_bytes", "allocations", "allocated_bytes",
+    "cache_hits", "cache_misses", "partition_searches", "partition_steps"};
+
+// timers and counters of one thread, summed when they are reported
+typedef struct ProfileBlock
+{
+    uint64_t calls[PROFILE_PHASE_COUNT];
+    uint64_t total_ns[PROFILE_PHASE_COUNT];
+    uint64_t max_ns[PROFILE_PHASE_COUNT];
+    uint64_t counters[PROFILE_COUNTER_COUNT];
+    struct ProfileBlock *next;
+} ProfileBlock;
+
+// every thread records into its own block (no locks or shared cache lines on the hot path),
+// blocks outlive their threads so the batch workers and stream readers are still counted at exit
+static _Thread_local ProfileBlock *own_block = NULL;
+static ProfileBlock *blocks = NULL;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Function to get the block of the calling thread, created on its first record
+/**
+ * Blocks come from the C library, not the simulation's allocator: they are never freed and are not part of any run.
+ * @return Pointer to the block, NULL if it cannot be allocated (the record is dropped)
+ */
+static ProfileBlock *thread_block(void)
+{
+    if (own_block == NULL)
+    {
+        own_block = (ProfileBlock *)calloc(1, sizeof(ProfileBlock));
+        if (own_block != NULL)
+        {
+            pthread_mutex_lock(&blocks_lock);
+            own_block->next = blocks;
+            blocks = own_block;
+            pthread_mutex_unlock(&blocks_lock);
+        }
+    }
+    return own_block;
+}
+
+// Function to record one timed run of a phase
+/**
+ * @param phase Phase that ran
+ * @param elapsed_ns Time it took (ns)
+ */
+void profile_phase(ProfilePhase phase, uint64_t elapsed_ns)
+{
+    ProfileBlock *block = thread_block();
+    if (block == NULL)
+    {
+        return;
+    }
+    block->calls[phase]++;
+    block->total_ns[phase] += elapsed_ns;
+    if (elapsed_ns > block->max_ns[phase])
+    {
+        block->max_ns[phase] = elapsed_ns;
+    }
+}
+
+// Function to add to a counter
+/**
+ * @param counter Counter to add to
+ * @param amount Amount to add
+ */
+void profile_count(ProfileCounter counter, uint64_t amount)
+{
+    ProfileBlock *block = thread_block();
+    if (block != NULL)
+    {
+        block->counters[counter] += amount;
+    }
+}
+
+// Function to sum the blocks of every thread that recorded something
+/**
+ * Called at exit, once the threads that record are done.
+ * @param sum Pointer to the block receiving the totals
+ */
+static void sum_blocks(ProfileBlock *sum)
+{
+    *sum = (ProfileBlock){0};
+    pthread_mutex_lock(&blocks_lock);
+    for (const ProfileBlock *block = blocks; block != NULL; block = block->next)
+    {
+        for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+        {
+            sum->calls[i] += block->calls[i];
+            sum->total_ns[i] += block->total_ns[i];
+            if (block->max_ns[i] > sum->max_ns[i])
+            {
+                sum->max_ns[i] = block->max_ns[i];
+            }
+        }
+        for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+        {
+            sum->counters[i] += block->counters[i];
+        }
+    }
+    pthread_mutex_unlock(&blocks_lock);
+}
+
+// Function to print the profile summary
+/**
+ * @param out Stream to print to
+ */
+void profile_report(FILE *out)
+{
+    ProfileBlock sum;
+    sum_blocks(&sum);
+
+    fprintf(out, "Profile:\n");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+    {
+        if (sum.calls[i] == 0)
+        {
+            continue;
+        }
+        fprintf(out, "  %-17s %12llu calls %10.3f ms total %10.1f ns mean %10llu ns max\n", phase_names[i], (unsigned long long)sum.calls[i],
+                (double)sum.total_ns[i] / 1e6, (double)sum.total_ns[i] / (double)sum.calls[i], (unsigned long long)sum.max_ns[i]);
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+    {
+        fprintf(out, "  %-17s %12llu\n", counter_names[i], (unsigned long long)sum.counters[i]);
+    }
+
+    uint64_t searches = sum.counters[PROFILE_PARTITION_SEARCHES];
+    if (searches > 0)
+    {
+        fprintf(out, "  average partition search length %.2f\n", (double)sum.counters[PROFILE_PARTITION_STEPS] / (double)searches);
+    }
+}
+
+// Function to write the profile as JSON
+/**
+ * @param path File to write ("-" for stdout)
+ * @return 0 on success, -1 if the file cannot be opened (the error is printed)
+ */
+int profile_write_json(const char *path)
+{
+    FILE *out = (path[0] == '-' && path[1] == '\0') ? stdout : fopen(path, "w");
+    if (out == NULL)
+    {
+        printf("Error: Cannot open profile file %s\n", path);
+        return -1;
+    }
+
+    ProfileBlock sum;
+    sum_blocks(&sum);
+
+    fprintf(out, "{\n  \"phases\": {\n");
+    for (int i = 0; i < PROFILE_PHASE_COUNT; i++)
+    {
+        fprintf(out, "    \"%s\": {\"calls\": %llu, \"total_ns\": %llu, \"max_ns\": %llu}%s\n", phase_names[i], (unsigned long long)sum.calls[i],
+                (unsigned long long)sum.total_ns[i], (unsigned long long)sum.max_ns[i], (i + 1 < PROFILE_PHASE_COUNT) ? "," : "");
+    }
+    fprintf(out, "  },\n  \"counters\": {\n");
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++)
+    {
+        fprintf(out, "    \"%s\": %llu%s\n", counter_names[i], (unsigned long long)sum.counters[i], (i + 1 < PROFILE_COUNTER_COUNT) ? "," : "");
+    }
+    fprintf(out, "  }\n}\n");
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
+
+#else
+
+// without SIM_PROFILE nothing is recorded: the macros are empty and these only keep callers linking
+
+void profile_phase(ProfilePhase phase, uint64_t elapsed_ns)
+{
+    (void)phase;
+    (void)elapsed_ns;
+}
+
+void profile_count(ProfileCounter counter, uint64_t amount)
+{
+    (void)counter;
+    (void)amount;
+}
+
+void profile_report(FILE *out)
+{
+    (void)out;
+}
+
+int profile_write_json(const char *path)
+{
+    printf("Error: Cannot write profile %s, the simulator was built without SIM_PROFILE (make PROFILE=1)\n", path);
+    return -1;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// configurations
+// the instrumentation is compiled in with -DSIM_PROFILE (make PROFILE=1), the macros below are empty otherwise
+#ifdef SIM_PROFILE
+#define PROFILE_ENABLED 1
+#else
+#define PROFILE_ENABLED 0
+#endif
+
+// includes
+#include <stdio.h>  // for FILE
+#include <stdint.h> // for int types
+
+// structs
+
+// timed phases of a run
+typedef enum
+{
+    PROFILE_LOAD_TRACE,       // parsing a trace file (load_trace)
+    PROFILE_SCHEDULE,         // picking the next process (engine dispatch)
+    PROFILE_EVENT_CPU,        // executing a CPU event (run_event), one phase per event type in EventType order
+    PROFILE_EVENT_SYSCALL,    // executing a SYSCALL event
+    PROFILE_EVENT_END_IO,     // executing an END_IO event
+    PROFILE_EVENT_FORK,       // executing a FORK event
+    PROFILE_EVENT_EXEC,       // executing an EXEC event, the partition search and trace loading included
+    PROFILE_PARTITION_SEARCH, // finding a partition for an EXEC (memory_allocate)
+    PROFILE_STATUS_SNAPSHOT,  // rendering a system status snapshot (save_system_status)
+    PROFILE_STATUS_WRITE,     // writing the system status buffer to its file
+    PROFILE_LOG_WRITE,        // writing the execution log ring to its file
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+// counted quantities of a run
+typedef enum
+{
+    PROFILE_EVENTS,              // trace events executed
+    PROFILE_LOG_BYTES,           // bytes written to execution logs
+    PROFILE_STATUS_BYTES,        // bytes written to system status files
+    PROFILE_ALLOCATIONS,         // sim_malloc / sim_calloc / sim_realloc / sim_strdup calls
+    PROFILE_ALLOCATED_BYTES,     // bytes asked for by those calls
+    PROFILE_CACHE_HITS,          // program cache lookups of a parsed trace
+    PROFILE_CACHE_MISSES,        // program cache lookups that parsed a trace
+    PROFILE_PARTITION_SEARCHES,  // partition searches
+    PROFILE_PARTITION_STEPS,     // partitions (or size index entries) examined by those searches
+    PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+// -----------------------------------------------------------
+
+uint64_t profile_now(void);
+void profile_phase(ProfilePhase phase, uint64_t elapsed_ns);
+void profile_count(ProfileCounter counter, uint64_t amount);
+void profile_report(FILE *out);
+int profile_write_json(const char *path);
+
+// -----------------------------------------------------------
+
+// a timer is a local holding its start time: PROFILE_START(timer); ... PROFILE_STOP(timer, PROFILE_LOAD_TRACE);
+#ifdef SIM_PROFILE
+#define PROFILE_START(timer) uint64_t profile_##timer = profile_now()
+#define PROFILE_STOP(timer, phase) profile_phase((phase), profile_now() - profile_##timer)
+#define PROFILE_COUNT(counter, amount) profile_count((counter), (uint64_t)(amount))
+#else
+#define PROFILE_START(timer)
+#define PROFILE_STOP(timer, phase)
+#define PROFILE_COUNT(counter, amount)
+#endif
+
+#endif // PROFILE_H
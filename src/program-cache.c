@@ -0,0 +1,339 @@
+#include "program-cache.h"
+#include "sim-alloc.h"
+#include "trace-stream.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// Function to keep the program array as large as the name table
+/**
+ * @param cache Pointer to the program cache
+ * @return 0 on success, -1 if the array cannot be grown (it is left as it was)
+ */
+static int reserve_programs(ProgramCache *cache)
+{
+    if (cache->names.count <= cache->capacity)
+    {
+        return 0;
+    }
+
+    uint32_t capacity = (cache->capacity == 0) ? 16 : cache->capacity;
+    while (capacity < cache->names.count)
+    {
+        capacity *= 2;
+    }
+    Program **programs = (Program **)sim_realloc(cache->programs, capacity * sizeof(Program *));
+    if (programs == NULL)
+    {
+        return -1;
+    }
+    cache->programs = programs;
+    memset(&cache->programs[cache->capacity], 0, (capacity - cache->capacity) * sizeof(Program *));
+    cache->capacity = capacity;
+    return 0;
+}
+
+// Function to initialize an empty program cache
+/**
+ * @param cache Pointer to the program cache
+ * @return 0 on success, -1 if the name table cannot be allocated (the cache can still be freed)
+ */
+int program_cache_init(ProgramCache *cache)
+{
+    int result = name_table_init(&cache->names);
+    cache->programs = NULL;
+    cache->capacity = 0;
+    cache->loaded = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->frozen = false;
+    cache->programs_dir = PROGRAMS_DEFAULT_DIR;
+    cache->vector_count = VECTOR_TABLE_SIZE;
+    return result;
+}
+
+// Function to intern a program name
+/**
+ * @param cache Pointer to the program cache
+ * @param name Name of the program (or path of the trace file)
+ * @return Program id used by EXEC events and program_cache_get (NAME_NOT_FOUND if the name cannot be stored)
+ */
+uint32_t program_cache_intern(ProgramCache *cache, const char *name)
+{
+    if (cache->frozen)
+    {
+        // a frozen cache knows every name already, looking it up does not write to the table
+        uint32_t id = name_table_find(&cache->names, name);
+        assert(id != NAME_NOT_FOUND);
+        return id;
+    }
+    return name_table_intern(&cache->names, name);
+}
+
+// Function to get the name of a program
+/**
+ * @param cache Pointer to the program cache
+ * @param program_id Id returned by program_cache_intern
+ * @return The program name
+ */
+const char *program_cache_name(const ProgramCache *cache, uint32_t program_id)
+{
+    return name_table_get(&cache->names, program_id);
+}
+
+// Function to load the parsed trace of a program if it is not cached yet
+/**
+ * @param cache Pointer to the program cache
+ * @param program_id Id returned by program_cache_intern
+ * @return Pointer to the cached program, or NULL if the trace cannot be loaded (the error is printed)
+ */
+const Program *program_cache_load(ProgramCache *cache, uint32_t program_id)
+{
+    if (program_id < cache->capacity && cache->programs[program_id] != NULL)
+    {
+        return cache->programs[program_id];
+    }
+    assert(!cache->frozen);
+
+    cache->misses++;
+
+    // parse the trace once into a growable array
+    TraceEvent *trace_events = NULL;
+    size_t event_count = 0;
+    if (load_trace(cache->programs_dir, name_table_get(&cache->names, program_id), &cache->names, cache->vector_count, &trace_events, &event_count) != 0)
+    {
+        return NULL;
+    }
+
+    // loading may have interned new names, programs are indexed by id
+    // (programs are allocated one by one so the returned pointer stays valid for the whole run)
+    Program *program = (reserve_programs(cache) == 0) ? (Program *)sim_malloc(sizeof(Program)) : NULL;
+    if (program == NULL)
+    {
+        printf("Error: Out of memory caching %s\n", name_table_get(&cache->names, program_id));
+        sim_free(trace_events);
+        return NULL;
+    }
+    program->id = program_id;
+    program->name = name_table_get(&cache->names, program_id);
+    program->event_count = event_count;
+    program->events = trace_events;
+    program->stream = NULL;
+
+    // the cache owns the trace from now on, give back the unused growth
+    if (event_count > 0)
+    {
+        TraceEvent *shrunk = (TraceEvent *)sim_realloc(trace_events, event_count * sizeof(TraceEvent));
+        program->events = (shrunk != NULL) ? shrunk : trace_events;
+    }
+
+    cache->programs[program_id] = program;
+    cache->loaded++;
+
+    return program;
+}
+
+// Function to get the parsed trace of a program, loading it on first use
+/**
+ * A frozen cache is only read: the program has to be loaded already, and the hit is counted atomically
+ * (the threads of a batch share it, an EXEC is rare enough for the add not to contend).
+ * @param cache Pointer to the program cache
+ * @param program_id Id returned by program_cache_intern
+ * @return Pointer to the cached program, shared by every caller, or NULL if the trace cannot be loaded (the error is printed)
+ */
+const Program *program_cache_get(ProgramCache *cache, uint32_t program_id)
+{
+    if (cache->frozen)
+    {
+        assert(program_id < cache->capacity && cache->programs[program_id] != NULL);
+        __atomic_fetch_add(&cache->hits, 1, __ATOMIC_RELAXED);
+        PROFILE_COUNT(PROFILE_CACHE_HITS, 1);
+        return cache->programs[program_id];
+    }
+
+    if (program_id < cache->capacity && cache->programs[program_id] != NULL)
+    {
+        cache->hits++;
+        PROFILE_COUNT(PROFILE_CACHE_HITS, 1);
+        return cache->programs[program_id];
+    }
+
+    PROFILE_COUNT(PROFILE_CACHE_MISSES, 1);
+    return program_cache_load(cache, program_id);
+}
+
+// Function to load every program a trace can EXEC, directly or through the programs it runs
+/**
+ * @param cache Pointer to the program cache
+ * @param program_id Id of the trace to start from
+ * @return 0 on success, -1 if one of the traces cannot be loaded (the error is printed)
+ */
+int program_cache_load_all(ProgramCache *cache, uint32_t program_id)
+{
+    if (program_id < cache->capacity && cache->programs[program_id] != NULL)
+    {
+        return 0; // loaded earlier, so were the programs it runs
+    }
+
+    // programs to load, each one is pushed when its first EXEC is found
+    uint32_t *pending = (uint32_t *)sim_malloc(16 * sizeof(uint32_t));
+    if (pending == NULL)
+    {
+        printf("Error: Out of memory loading the programs of %s\n", name_table_get(&cache->names, program_id));
+        return -1;
+    }
+    size_t pending_count = 0;
+    size_t pending_capacity = 16;
+    pending[pending_count++] = program_id;
+
+    int result = 0;
+    while (pending_count > 0 && result == 0)
+    {
+        const Program *program = program_cache_load(cache, pending[--pending_count]);
+        if (program == NULL)
+        {
+            result = -1;
+            break;
+        }
+
+        for (size_t i = 0; i < program->event_count; i++)
+        {
+            uint32_t target = program->events[i].program_id;
+            if (program->events[i].type != EVENT_EXEC || (target < cache->capacity && cache->programs[target] != NULL))
+            {
+                continue;
+            }
+
+            if (pending_count == pending_capacity)
+            {
+                uint32_t *grown = (uint32_t *)sim_realloc(pending, pending_capacity * 2 * sizeof(uint32_t));
+                if (grown == NULL)
+                {
+                    printf("Error: Out of memory loading the programs of %s\n", name_table_get(&cache->names, program_id));
+                    result = -1;
+                    break;
+                }
+                pending = grown;
+                pending_capacity *= 2;
+            }
+            pending[pending_count++] = target;
+        }
+    }
+
+    sim_free(pending);
+    return result;
+}
+
+// Function to stop the cache from changing, so simulations on several threads can share it
+/**
+ * Every program the simulations EXEC has to be loaded first (program_cache_load_all).
+ * @param cache Pointer to the program cache
+ */
+void program_cache_freeze(ProgramCache *cache)
+{
+    cache->frozen = true;
+}
+
+// Function to register a streamed trace, so EXEC and the engine read it from its window
+/**
+ * @param cache Pointer to the program cache
+ * @param program_id Id returned by program_cache_intern
+ * @param stream Pointer to the open stream (owned by the caller, it has to outlive the cache's use of it)
+ * @return Pointer to the program, NULL if it cannot be allocated
+ */
+const Program *program_cache_stream(ProgramCache *cache, uint32_t program_id, TraceStream *stream)
+{
+    Program *program = (reserve_programs(cache) == 0) ? (Program *)sim_malloc(sizeof(Program)) : NULL;
+    if (program == NULL)
+    {
+        return NULL;
+    }
+    assert(program_id < cache->capacity && cache->programs[program_id] == NULL);
+    program->id = program_id;
+    program->name = name_table_get(&cache->names, program_id);
+    program->events = NULL;
+    program->event_count = 0;
+    program->stream = stream;
+
+    cache->programs[program_id] = program;
+    cache->loaded++;
+    return program;
+}
+
+// Function to check if a program is the streamed trace
+/**
+ * @param cache Pointer to the program cache
+ * @param program_id Id returned by program_cache_intern
+ * @return true if the program was registered with program_cache_stream
+ */
+bool program_cache_is_streamed(const ProgramCache *cache, uint32_t program_id)
+{
+    return program_id < cache->capacity && cache->programs[program_id] != NULL && cache->programs[program_id]->stream != NULL;
+}
+
+// Function to get an event of a program
+/**
+ * @param program Pointer to the program
+ * @param index Index of the event
+ * @param event Pointer to a copy of the event
+ * @return false past the end of the trace
+ */
+bool program_event(const Program *program, size_t index, TraceEvent *event)
+{
+    if (program->stream != NULL)
+    {
+        return trace_stream_get(program->stream, index, event);
+    }
+    if (index >= program->event_count)
+    {
+        return false;
+    }
+    *event = program->events[index];
+    return true;
+}
+
+// Function to mark the events before an index as executed (a streamed trace drops them)
+/**
+ * @param program Pointer to the program
+ * @param index Index of the event being executed
+ */
+void program_release(const Program *program, size_t index)
+{
+    if (program->stream != NULL)
+    {
+        trace_stream_release(program->stream, index);
+    }
+}
+
+// Function to print the cache counters at the end of the run
+/**
+ * @param cache Pointer to the program cache
+ * @param out Stream to print to
+ */
+void program_cache_report(const ProgramCache *cache, FILE *out)
+{
+    fprintf(out, "Program cache: %u programs, %llu hits, %llu misses\n", cache->loaded, (unsigned long long)cache->hits, (unsigned long long)cache->misses);
+}
+
+// Function to free every cached program
+/**
+ * @param cache Pointer to the program cache
+ */
+void program_cache_free(ProgramCache *cache)
+{
+    for (uint32_t i = 0; i < cache->capacity; i++)
+    {
+        if (cache->programs[i] != NULL)
+        {
+            sim_free(cache->programs[i]->events);
+            sim_free(cache->programs[i]);
+        }
+    }
+    sim_free(cache->programs);
+    name_table_free(&cache->names);
+    cache->programs = NULL;
+    cache->capacity = 0;
+    cache->loaded = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+// includes
+#include <stdio.h>  // for FILE
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <stdbool.h>
+#include "process-simulator.h"
+#include "name-table.h"
+
+// structs
+
+typedef struct TraceStream TraceStream; // trace read in the background, see trace-stream.h
+
+typedef struct Program
+{
+    uint32_t id;         // interned program id
+    const char *name;    // interned program name (owned by the name table)
+    TraceEvent *events;  // parsed trace, heap array owned by the cache, immutable once loaded
+    size_t event_count;  // number of events in the trace
+    TraceStream *stream; // streamed trace (--stream): events come from its window instead, NULL otherwise
+} Program;
+
+typedef struct ProgramCache
+{
+    NameTable names;    // program names, the program id is the interned id
+    Program **programs; // programs indexed by program id (NULL until the first EXEC)
+    uint32_t capacity;  // allocated slots in programs
+    uint32_t loaded;    // number of loaded programs
+    uint64_t hits;      // lookups served from the cache
+    uint64_t misses;    // lookups that had to parse the trace file
+    bool frozen;        // read-only from now on (shared between threads), every program is loaded
+    const char *programs_dir; // directory of the programs named in an EXEC (not owned)
+    uint32_t vector_count;    // vectors in the vector table, traces naming a vector past them are rejected
+} ProgramCache;
+
+// -----------------------------------------------------------
+
+int program_cache_init(ProgramCache *cache);
+uint32_t program_cache_intern(ProgramCache *cache, const char *name);
+const char *program_cache_name(const ProgramCache *cache, uint32_t program_id);
+const Program *program_cache_load(ProgramCache *cache, uint32_t program_id);
+const Program *program_cache_get(ProgramCache *cache, uint32_t program_id);
+int program_cache_load_all(ProgramCache *cache, uint32_t program_id);
+void program_cache_freeze(ProgramCache *cache);
+const Program *program_cache_stream(ProgramCache *cache, uint32_t program_id, TraceStream *stream);
+bool program_cache_is_streamed(const ProgramCache *cache, uint32_t program_id);
+bool program_event(const Program *program, size_t index, TraceEvent *event);
+void program_release(const Program *program, size_t index);
+void program_cache_report(const ProgramCache *cache, FILE *out);
+void program_cache_free(ProgramCache *cache);
+
+// -----------------------------------------------------------
+
+#endif // PROGRAM_CACHE_H
@@ -0,0 +1,109 @@
+#include "random.h"
+#include <time.h>
+#include <unistd.h>
+
+// Function to advance a splitmix64 state (expands a seed into generator state)
+/**
+ * @param x Pointer to the splitmix64 state
+ * @return Next output
+ */
+static uint64_t splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Function to rotate a 64-bit value left
+/**
+ * @param x Value to rotate
+ * @param k Number of bits
+ * @return Rotated value
+ */
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+// Function to seed a generator (equal seeds give equal streams)
+/**
+ * @param rng Pointer to the generator
+ * @param seed Seed
+ */
+void rng_seed(Rng *rng, uint64_t seed)
+{
+    uint64_t x = seed;
+    for (int i = 0; i < 4; i++)
+    {
+        rng->state[i] = splitmix64(&x);
+    }
+}
+
+// Function to draw the next 64 random bits
+/**
+ * @param rng Pointer to the generator
+ * @return Random value
+ */
+uint64_t rng_next(Rng *rng)
+{
+    uint64_t *s = rng->state;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+// Function to draw a uniform value in [0, bound) without modulo bias
+/**
+ * Lemire's multiply-and-reject method, a division only on the rare retry path.
+ * @param rng Pointer to the generator
+ * @param bound Number of possible values (at least 1)
+ * @return Random value below bound
+ */
+uint64_t rng_below(Rng *rng, uint64_t bound)
+{
+    unsigned __int128 product = (unsigned __int128)rng_next(rng) * bound;
+    uint64_t low = (uint64_t)product;
+    if (low < bound)
+    {
+        uint64_t threshold = -bound % bound;
+        while (low < threshold)
+        {
+            product = (unsigned __int128)rng_next(rng) * bound;
+            low = (uint64_t)product;
+        }
+    }
+    return (uint64_t)(product >> 64);
+}
+
+// Function to derive an independent stream from a generator
+/**
+ * The new stream is seeded from the parent's output, so a parent seeded the same way
+ * always hands out the same sequence of streams (one per run of a batch, for example).
+ * @param rng Pointer to the parent generator
+ * @param stream Pointer to the new generator
+ */
+void rng_split(Rng *rng, Rng *stream)
+{
+    rng_seed(stream, rng_next(rng));
+}
+
+// Function to pick a seed when none is given (printed so the run can be repeated)
+/**
+ * @return Seed mixed from the wall clock and the process id
+ */
+uint64_t rng_default_seed(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t x = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    x ^= (uint64_t)getpid() << 32;
+    return splitmix64(&x);
+}
@@ -0,0 +1,25 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+// includes
+#include <stdint.h> // for int types
+
+// structs
+
+// xoshiro256** generator: 32 bytes of state, one per simulation so runs never share a stream
+typedef struct
+{
+    uint64_t state[4];
+} Rng;
+
+// -----------------------------------------------------------
+
+void rng_seed(Rng *rng, uint64_t seed);
+uint64_t rng_next(Rng *rng);
+uint64_t rng_below(Rng *rng, uint64_t bound);
+void rng_split(Rng *rng, Rng *stream);
+uint64_t rng_default_seed(void);
+
+// -----------------------------------------------------------
+
+#endif // RANDOM_H
@@ -0,0 +1,490 @@
+#include "scheduler.h"
+#include "sim-alloc.h"
+#include "program-cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static const char *policy_names[] = {"inline", "fcfs", "rr", "priority", "sjf"};
+
+// -----------------------------------------------------------
+// Heaps
+// -----------------------------------------------------------
+
+typedef bool (*HeapLess)(const PCB *a, const PCB *b);
+
+// Function to order the ready heap
+/**
+ * @param a Pointer to the first process
+ * @param b Pointer to the second process
+ * @return true if a should be dispatched before b
+ */
+static bool ready_less(const PCB *a, const PCB *b)
+{
+    return (a->ready_key != b->ready_key) ? a->ready_key < b->ready_key : a->ready_seq < b->ready_seq;
+}
+
+// Function to order the blocked heap
+/**
+ * @param a Pointer to the first process
+ * @param b Pointer to the second process
+ * @return true if a wakes up before b
+ */
+static bool blocked_less(const PCB *a, const PCB *b)
+{
+    return (a->wake_time != b->wake_time) ? a->wake_time < b->wake_time : a->ready_seq < b->ready_seq;
+}
+
+// Function to make room in a heap for a number of processes
+/**
+ * @param heap Pointer to the heap array
+ * @param capacity Pointer to the allocated slots
+ * @param count Number of processes the heap has to hold
+ * @return 0 on success, -1 if the heap cannot be grown (it is left as it was)
+ */
+static int heap_reserve(PCB ***heap, size_t *capacity, size_t count)
+{
+    if (count <= *capacity)
+    {
+        return 0;
+    }
+
+    size_t grown = (*capacity == 0) ? SCHEDULER_INITIAL_CAPACITY : *capacity * 2;
+    while (grown < count)
+    {
+        grown *= 2;
+    }
+    PCB **resized = (PCB **)sim_realloc(*heap, grown * sizeof(PCB *));
+    if (resized == NULL)
+    {
+        return -1;
+    }
+    *heap = resized;
+    *capacity = grown;
+    return 0;
+}
+
+// Function to push a process onto a heap
+/**
+ * @param heap Pointer to the heap array
+ * @param count Pointer to the number of processes in the heap
+ * @param capacity Pointer to the allocated slots (reserved with scheduler_reserve)
+ * @param process Pointer to the process to push
+ * @param less Ordering of the heap
+ */
+static void heap_push(PCB ***heap, size_t *count, size_t *capacity, PCB *process, HeapLess less)
+{
+    assert(*count < *capacity);
+
+    size_t i = (*count)++;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!less(process, (*heap)[parent]))
+        {
+            break;
+        }
+        (*heap)[i] = (*heap)[parent];
+        i = parent;
+    }
+    (*heap)[i] = process;
+}
+
+// Function to pop the first process off a heap
+/**
+ * @param heap Heap array
+ * @param count Pointer to the number of processes in the heap
+ * @param less Ordering of the heap
+ * @return Pointer to the first process
+ */
+static PCB *heap_pop(PCB **heap, size_t *count, HeapLess less)
+{
+    PCB *first = heap[0];
+    PCB *last = heap[--(*count)];
+
+    size_t i = 0;
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= *count)
+        {
+            break;
+        }
+        if (child + 1 < *count && less(heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        if (!less(heap[child], last))
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (*count > 0)
+    {
+        heap[i] = last;
+    }
+    return first;
+}
+
+// -----------------------------------------------------------
+// Policies
+// -----------------------------------------------------------
+
+// Function to parse a policy name from the command line
+/**
+ * @param name Name of the policy (inline, fcfs, rr, priority, sjf)
+ * @param policy Pointer to the parsed policy
+ * @return 0 on success, -1 if the name is unknown
+ */
+int scheduler_parse_policy(const char *name, SchedulerPolicy *policy)
+{
+    for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++)
+    {
+        if (strcmp(name, policy_names[i]) == 0)
+        {
+            *policy = (SchedulerPolicy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Function to get the name of a policy
+/**
+ * @param policy Scheduling policy
+ * @return Name of the policy
+ */
+const char *scheduler_policy_name(SchedulerPolicy policy)
+{
+    return policy_names[policy];
+}
+
+// Function to find the length of the next CPU burst of a process (SJF key)
+/**
+ * @param process Pointer to the process
+ * @return Duration of the next CPU event (UINT32_MAX if none within the lookahead, so it runs after every known burst)
+ */
+static uint32_t next_cpu_burst(const PCB *process)
+{
+    if (process->remaining_cpu_time > 0)
+    {
+        return process->remaining_cpu_time;
+    }
+
+    const Program *program = process->program;
+    size_t end = process->pc + SCHEDULER_SJF_LOOKAHEAD;
+    TraceEvent event;
+    for (size_t i = process->pc; i < end && program_event(program, i, &event); i++)
+    {
+        if (event.type == EVENT_CPU)
+        {
+            return event.duration;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// -----------------------------------------------------------
+// Queues
+// -----------------------------------------------------------
+
+// Function to initialize an empty scheduler
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param policy Scheduling policy
+ * @param quantum Round-robin time slice
+ * @param core_count Number of simulated cores, each with its own run queue (1 to SCHEDULER_MAX_CORES)
+ * @return 0 on success, -1 if the run queues cannot be allocated (the scheduler can still be freed)
+ */
+int scheduler_init(Scheduler *scheduler, SchedulerPolicy policy, uint32_t quantum, uint32_t core_count)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->policy = policy;
+    scheduler->quantum = quantum;
+    scheduler->queues = (RunQueue *)sim_calloc(core_count, sizeof(RunQueue));
+    if (scheduler->queues == NULL)
+    {
+        return -1;
+    }
+    scheduler->core_count = core_count;
+    return 0;
+}
+
+// Function to make room in the queues for a number of processes
+/**
+ * The blocked queue and every run queue can hold every live process, so queueing a process never allocates.
+ * Called whenever a process is created.
+ * @param scheduler Pointer to the scheduler
+ * @param count Number of live processes
+ * @return 0 on success, -1 if a queue cannot be grown
+ */
+int scheduler_reserve(Scheduler *scheduler, size_t count)
+{
+    if (heap_reserve(&scheduler->blocked, &scheduler->blocked_capacity, count) != 0)
+    {
+        return -1;
+    }
+    for (uint32_t i = 0; i < scheduler->core_count; i++)
+    {
+        RunQueue *queue = &scheduler->queues[i];
+        if (heap_reserve(&queue->ready, &queue->ready_capacity, count) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Function to pick the run queue a process joins when it becomes ready
+/**
+ * Processes stay on the core they last ran on (a forked child starts on its parent's), unless that queue is
+ * SCHEDULER_BALANCE_SLACK longer than the shortest one: then the process moves to the shortest.
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process
+ * @return Pointer to the run queue
+ */
+static RunQueue *place(Scheduler *scheduler, PCB *process)
+{
+    RunQueue *home = &scheduler->queues[process->core];
+    if (scheduler->core_count == 1)
+    {
+        return home;
+    }
+
+    uint32_t shortest = process->core;
+    for (uint32_t i = 0; i < scheduler->core_count; i++)
+    {
+        if (scheduler->queues[i].ready_count < scheduler->queues[shortest].ready_count)
+        {
+            shortest = i;
+        }
+    }
+    if (home->ready_count < scheduler->queues[shortest].ready_count + SCHEDULER_BALANCE_SLACK)
+    {
+        return home;
+    }
+
+    process->core = (uint8_t)shortest;
+    scheduler->queues[shortest].migrations++;
+    return &scheduler->queues[shortest];
+}
+
+// Function to put a process in the ready queue
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process
+ * @param ready_time Time the process became ready
+ */
+void scheduler_ready(Scheduler *scheduler, PCB *process, uint64_t ready_time)
+{
+    process->state = PROCESS_READY;
+    process->ready_since = ready_time;
+    process->ready_seq = scheduler->sequence++;
+
+    switch (scheduler->policy)
+    {
+    case SCHEDULER_INLINE:
+        process->ready_key = UINT64_MAX - process->ready_seq; // last suspended resumes first
+        break;
+    case SCHEDULER_FCFS:
+    case SCHEDULER_RR:
+        process->ready_key = ready_time;
+        break;
+    case SCHEDULER_PRIORITY:
+        process->ready_key = process->priority;
+        break;
+    case SCHEDULER_SJF:
+        process->ready_key = next_cpu_burst(process);
+        break;
+    }
+
+    RunQueue *queue = place(scheduler, process);
+    heap_push(&queue->ready, &queue->ready_count, &queue->ready_capacity, process, ready_less);
+    scheduler->ready_count++;
+}
+
+// Function to take the next process to run off the ready queue of the running core
+/**
+ * A core whose queue is empty steals the first process of the longest queue.
+ * @param scheduler Pointer to the scheduler
+ * @param current_time Current time
+ * @return Pointer to the process, or NULL if nothing is ready
+ */
+PCB *scheduler_next(Scheduler *scheduler, uint64_t current_time)
+{
+    if (scheduler->ready_count == 0)
+    {
+        return NULL;
+    }
+
+    RunQueue *own = &scheduler->queues[scheduler->core];
+    RunQueue *queue = own;
+    for (uint32_t i = 0; own->ready_count == 0 && i < scheduler->core_count; i++)
+    {
+        if (queue == own || scheduler->queues[i].ready_count > queue->ready_count)
+        {
+            queue = &scheduler->queues[i];
+        }
+    }
+    if (queue != own)
+    {
+        own->steals++;
+    }
+
+    PCB *process = heap_pop(queue->ready, &queue->ready_count, ready_less);
+    scheduler->ready_count--;
+    scheduler_dispatch(scheduler, process, current_time);
+    return process;
+}
+
+// Function to give the running core to a process and count the dispatch
+/**
+ * A forked child is dispatched straight away, without going through a ready queue.
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process (its ready_since is the time it became ready)
+ * @param current_time Current time
+ */
+void scheduler_dispatch(Scheduler *scheduler, PCB *process, uint64_t current_time)
+{
+    process->state = PROCESS_RUNNING;
+    process->core = (uint8_t)scheduler->core;
+    process->wait_time += (current_time > process->ready_since) ? current_time - process->ready_since : 0; // a core behind the others starts it later
+    scheduler->dispatches++;
+    scheduler->queues[scheduler->core].dispatches++;
+}
+
+// Function to block a process until its I/O completes
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process
+ * @param wake_time Time the I/O completes
+ */
+void scheduler_block(Scheduler *scheduler, PCB *process, uint64_t wake_time)
+{
+    process->state = PROCESS_BLOCKED;
+    process->wake_time = wake_time;
+    process->ready_seq = scheduler->sequence++;
+    heap_push(&scheduler->blocked, &scheduler->blocked_count, &scheduler->blocked_capacity, process, blocked_less);
+}
+
+// Function to move one process whose I/O is done from the blocked queue to the ready queue
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param current_time Current time
+ * @return Pointer to the woken process, or NULL if no I/O is done yet
+ */
+PCB *scheduler_wake(Scheduler *scheduler, uint64_t current_time)
+{
+    if (scheduler->blocked_count == 0 || scheduler->blocked[0]->wake_time > current_time)
+    {
+        return NULL;
+    }
+
+    PCB *process = heap_pop(scheduler->blocked, &scheduler->blocked_count, blocked_less);
+    scheduler_ready(scheduler, process, process->wake_time);
+    return process;
+}
+
+// Function to put a checkpointed process back in one of the queues
+/**
+ * Its ordering key and sequence number are kept as they were saved, the queues come back in the same order.
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process
+ * @param blocked true for the blocked queue, false for the ready queue
+ */
+void scheduler_restore(Scheduler *scheduler, PCB *process, bool blocked)
+{
+    if (blocked)
+    {
+        heap_push(&scheduler->blocked, &scheduler->blocked_count, &scheduler->blocked_capacity, process, blocked_less);
+    }
+    else
+    {
+        RunQueue *queue = &scheduler->queues[process->core];
+        heap_push(&queue->ready, &queue->ready_count, &queue->ready_capacity, process, ready_less);
+        scheduler->ready_count++;
+    }
+}
+
+// Function to get the time the next blocked process wakes up
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param wake_time Pointer to the wake time
+ * @return false if no process is blocked
+ */
+bool scheduler_next_wake(const Scheduler *scheduler, uint64_t *wake_time)
+{
+    if (scheduler->blocked_count == 0)
+    {
+        return false;
+    }
+    *wake_time = scheduler->blocked[0]->wake_time;
+    return true;
+}
+
+// Function to record a process reaching the end of its trace
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param process Pointer to the process
+ * @param current_time Current time
+ */
+void scheduler_exit(Scheduler *scheduler, PCB *process, uint64_t current_time)
+{
+    process->state = PROCESS_TERMINATED;
+    scheduler->completed++;
+    scheduler->total_turnaround += current_time - process->arrival_time;
+    scheduler->total_waiting += process->wait_time;
+    scheduler->total_cpu += process->cpu_time;
+    scheduler->total_io += process->io_time;
+}
+
+// Function to print the scheduling statistics at the end of the run
+/**
+ * @param scheduler Pointer to the scheduler
+ * @param end_time Time the simulation ended
+ * @param out Stream to print to
+ */
+void scheduler_report(const Scheduler *scheduler, uint64_t end_time, FILE *out)
+{
+    fprintf(out, "Scheduler: %s", scheduler_policy_name(scheduler->policy));
+    if (scheduler->policy == SCHEDULER_RR)
+    {
+        fprintf(out, " (quantum %u ms)", scheduler->quantum);
+    }
+    if (scheduler->core_count > 1)
+    {
+        fprintf(out, " on %u cores", scheduler->core_count);
+    }
+    fprintf(out, ", %llu processes completed in %llu ms, %llu dispatches, %llu preemptions\n",
+            (unsigned long long)scheduler->completed, (unsigned long long)end_time, (unsigned long long)scheduler->dispatches, (unsigned long long)scheduler->preemptions);
+
+    if (scheduler->completed > 0 && end_time > 0)
+    {
+        double completed = (double)scheduler->completed;
+        fprintf(out, "Throughput: %.4f processes/ms, average turnaround %.1f ms, average waiting %.1f ms, CPU bursts %.1f%% of the run, I/O %llu ms\n",
+                completed / (double)end_time, scheduler->total_turnaround / completed, scheduler->total_waiting / completed,
+                100.0 * scheduler->total_cpu / ((double)end_time * scheduler->core_count), (unsigned long long)scheduler->total_io);
+    }
+}
+
+// Function to free the scheduler queues
+/**
+ * @param scheduler Pointer to the scheduler
+ */
+void scheduler_free(Scheduler *scheduler)
+{
+    for (uint32_t i = 0; i < scheduler->core_count; i++)
+    {
+        sim_free(scheduler->queues[i].ready);
+    }
+    sim_free(scheduler->queues);
+    sim_free(scheduler->blocked);
+    scheduler->queues = NULL;
+    scheduler->core_count = 0;
+    scheduler->blocked = NULL;
+    scheduler->ready_count = 0;
+    scheduler->blocked_count = 0;
+}
@@ -0,0 +1,99 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// configurations
+#define SCHEDULER_DEFAULT_QUANTUM 20 // round-robin time slice in ms
+#define SCHEDULER_SJF_LOOKAHEAD 64   // events scanned for the next CPU burst
+#define SCHEDULER_INITIAL_CAPACITY 16
+#define SCHEDULER_MAX_CORES 64       // simulated CPU cores (--cores)
+#define SCHEDULER_BALANCE_SLACK 2    // a process made ready moves to the shortest run queue when its own one is this much longer
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "process-simulator.h"
+
+// structs
+
+typedef enum
+{
+    SCHEDULER_INLINE,   // a forked child runs to completion before its parent resumes (original behaviour)
+    SCHEDULER_FCFS,     // first come, first served
+    SCHEDULER_RR,       // round robin with a fixed quantum
+    SCHEDULER_PRIORITY, // lowest priority value first (non-preemptive)
+    SCHEDULER_SJF       // shortest next CPU burst first (non-preemptive)
+} SchedulerPolicy;
+
+typedef enum
+{
+    PROCESS_READY,
+    PROCESS_RUNNING,
+    PROCESS_BLOCKED,    // waiting for an I/O request to complete
+    PROCESS_WAITING,    // forked a child that carries on with its trace
+    PROCESS_TERMINATED
+} ProcessState;
+
+// ready processes of one simulated core
+typedef struct
+{
+    PCB **ready;             // binary min-heap on (ready_key, ready_seq)
+    size_t ready_count;
+    size_t ready_capacity;
+
+    // statistics
+    uint64_t dispatches;     // processes the core took off a run queue
+    uint64_t steals;         // of those, taken off another core's queue while its own was empty
+    uint64_t migrations;     // processes made ready that were moved here from a longer queue
+} RunQueue;
+
+typedef struct
+{
+    SchedulerPolicy policy;
+    uint32_t quantum;        // round-robin time slice
+
+    RunQueue *queues;        // one run queue per core
+    uint32_t core_count;
+    uint32_t core;           // core the engine is running, scheduler_next serves its queue
+    size_t ready_count;      // processes in every run queue
+
+    PCB **blocked;           // binary min-heap on wake_time
+    size_t blocked_count;
+    size_t blocked_capacity;
+
+    uint64_t sequence;       // enqueue counter, breaks ties in insertion order
+
+    // statistics
+    uint64_t dispatches;
+    uint64_t preemptions;
+    uint64_t completed;
+    uint64_t total_turnaround;
+    uint64_t total_waiting;
+    uint64_t total_cpu;
+    uint64_t total_io;
+} Scheduler;
+
+// -----------------------------------------------------------
+
+int scheduler_parse_policy(const char *name, SchedulerPolicy *policy);
+const char *scheduler_policy_name(SchedulerPolicy policy);
+
+// -----------------------------------------------------------
+
+int scheduler_init(Scheduler *scheduler, SchedulerPolicy policy, uint32_t quantum, uint32_t core_count);
+int scheduler_reserve(Scheduler *scheduler, size_t count);
+void scheduler_ready(Scheduler *scheduler, PCB *process, uint64_t ready_time);
+PCB *scheduler_next(Scheduler *scheduler, uint64_t current_time);
+void scheduler_dispatch(Scheduler *scheduler, PCB *process, uint64_t current_time);
+void scheduler_block(Scheduler *scheduler, PCB *process, uint64_t wake_time);
+PCB *scheduler_wake(Scheduler *scheduler, uint64_t current_time);
+void scheduler_restore(Scheduler *scheduler, PCB *process, bool blocked);
+bool scheduler_next_wake(const Scheduler *scheduler, uint64_t *wake_time);
+void scheduler_exit(Scheduler *scheduler, PCB *process, uint64_t current_time);
+void scheduler_report(const Scheduler *scheduler, uint64_t end_time, FILE *out);
+void scheduler_free(Scheduler *scheduler);
+
+// -----------------------------------------------------------
+
+#endif // SCHEDULER_H
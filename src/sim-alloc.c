@@ -0,0 +1,125 @@
+#include "sim-alloc.h"
+#include "profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// hooks of the simulation running on this thread, NULL for the C library
+// (set by the SimContext functions for the length of a call, so contexts on other threads never see them)
+static _Thread_local const SimAllocator *current_allocator = NULL;
+
+// Function to route the allocations of the calling thread through a set of hooks
+/**
+ * @param allocator Pointer to the hooks, NULL for malloc / realloc / free
+ * @return The hooks used before, to be restored when the call that set them returns
+ */
+const SimAllocator *sim_alloc_use(const SimAllocator *allocator)
+{
+    const SimAllocator *previous = current_allocator;
+    current_allocator = allocator;
+    return previous;
+}
+
+// Function to get the hooks the calling thread allocates through
+/**
+ * Threads started by a simulation (the trace stream reader) adopt the hooks of the thread that started them.
+ * @return Pointer to the hooks, NULL for the C library
+ */
+const SimAllocator *sim_alloc_current(void)
+{
+    return current_allocator;
+}
+
+// Function to allocate memory
+/**
+ * @param size Number of bytes
+ * @return Pointer to the memory, NULL if it cannot be allocated
+ */
+void *sim_malloc(size_t size)
+{
+    PROFILE_COUNT(PROFILE_ALLOCATIONS, 1);
+    PROFILE_COUNT(PROFILE_ALLOCATED_BYTES, size);
+    if (current_allocator == NULL)
+    {
+        return malloc(size);
+    }
+    return current_allocator->allocate(current_allocator->user, size);
+}
+
+// Function to allocate zeroed memory for an array
+/**
+ * @param count Number of elements
+ * @param size Size of an element
+ * @return Pointer to the memory, NULL if it cannot be allocated (or count * size overflows)
+ */
+void *sim_calloc(size_t count, size_t size)
+{
+    if (current_allocator == NULL)
+    {
+        PROFILE_COUNT(PROFILE_ALLOCATIONS, 1);
+        PROFILE_COUNT(PROFILE_ALLOCATED_BYTES, count * size);
+        return calloc(count, size);
+    }
+    if (size != 0 && count > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+
+    void *pointer = sim_malloc(count * size);
+    if (pointer != NULL)
+    {
+        memset(pointer, 0, count * size);
+    }
+    return pointer;
+}
+
+// Function to resize memory
+/**
+ * @param pointer Pointer to the memory (NULL allocates)
+ * @param size New number of bytes
+ * @return Pointer to the resized memory, NULL if it cannot be resized (the old memory is kept)
+ */
+void *sim_realloc(void *pointer, size_t size)
+{
+    PROFILE_COUNT(PROFILE_ALLOCATIONS, 1);
+    PROFILE_COUNT(PROFILE_ALLOCATED_BYTES, size);
+    if (current_allocator == NULL)
+    {
+        return realloc(pointer, size);
+    }
+    return current_allocator->reallocate(current_allocator->user, pointer, size);
+}
+
+// Function to free memory
+/**
+ * @param pointer Pointer to the memory (NULL is ignored)
+ */
+void sim_free(void *pointer)
+{
+    if (pointer == NULL)
+    {
+        return;
+    }
+    if (current_allocator == NULL)
+    {
+        free(pointer);
+        return;
+    }
+    current_allocator->release(current_allocator->user, pointer);
+}
+
+// Function to copy a string
+/**
+ * @param text String to copy
+ * @return Pointer to the copy, NULL if it cannot be allocated
+ */
+char *sim_strdup(const char *text)
+{
+    size_t length = strlen(text) + 1;
+    char *copy = (char *)sim_malloc(length);
+    if (copy != NULL)
+    {
+        memcpy(copy, text, length);
+    }
+    return copy;
+}
@@ -0,0 +1,30 @@
+#ifndef SIM_ALLOC_H
+#define SIM_ALLOC_H
+
+// includes
+#include <stddef.h> // for size_t
+
+// structs
+
+// allocation hooks of an embedding application, every allocation of a simulation goes through them
+typedef struct SimAllocator
+{
+    void *(*allocate)(void *user, size_t size);                   // like malloc
+    void *(*reallocate)(void *user, void *pointer, size_t size); // like realloc (pointer may be NULL)
+    void (*release)(void *user, void *pointer);                  // like free (never called with NULL)
+    void *user;                                                  // passed to every hook
+} SimAllocator;
+
+// -----------------------------------------------------------
+
+const SimAllocator *sim_alloc_use(const SimAllocator *allocator);
+const SimAllocator *sim_alloc_current(void);
+void *sim_malloc(size_t size);
+void *sim_calloc(size_t count, size_t size);
+void *sim_realloc(void *pointer, size_t size);
+void sim_free(void *pointer);
+char *sim_strdup(const char *text);
+
+// -----------------------------------------------------------
+
+#endif // SIM_ALLOC_H
@@ -0,0 +1,601 @@
+#include "sim-context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Function to fill in the default run settings (the ones main uses without options)
+/**
+ * @param options Pointer to the settings
+ */
+void simulation_options_init(SimulationOptions *options)
+{
+    options->policy = SCHEDULER_INLINE;
+    options->quantum = SCHEDULER_DEFAULT_QUANTUM;
+    options->cores = 1;
+    options->partitions_path = NULL;
+    options->devices_path = NULL;
+    options->programs_dir = PROGRAMS_DEFAULT_DIR;
+    options->fit = FIT_BEST;
+    options->variable = false;
+    options->paging = false;
+    options->replacement = REPLACE_LRU;
+    options->frames = 0;
+    options->tlb_size = VIRTUAL_MEMORY_DEFAULT_TLB;
+    options->format = LOG_FORMAT_TEXT;
+    options->status_flush = 0;
+    options->status_keyframes = 0;
+    options->streaming = false;
+    options->install_signals = false;
+    options->timing = false;
+}
+
+// Function to initialize a simulator instance
+/**
+ * Nothing is allocated yet, the context can live anywhere (stack, arena, array of instances).
+ * @param context Pointer to the context
+ * @param options Pointer to the run settings (copied)
+ * @param allocator Pointer to the allocation hooks used by every call on this context (NULL for the C library, must outlive the context)
+ * @param report Stream errors and the end of run report are printed to
+ */
+void sim_context_init(SimContext *context, const SimulationOptions *options, const SimAllocator *allocator, FILE *report)
+{
+    memset(context, 0, sizeof(*context));
+    context->options = *options;
+    context->allocator = allocator;
+    context->report = report;
+}
+
+// Function to load the inputs of the context from files (the context owns them)
+/**
+ * Traces are parsed into the context's own program cache on their first EXEC.
+ * @param context Pointer to the context
+ * @param external_files Name of the external files
+ * @param vector_table Name of the vector table
+ * @return 0 on success, -1 if a file cannot be loaded (the error is printed)
+ */
+int sim_context_load(SimContext *context, const char *external_files, const char *vector_table)
+{
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+
+    // program names share the interning of the program cache
+    if (program_cache_init(&context->cache) != 0)
+    {
+        fprintf(context->report, "Error: Cannot allocate the program cache\n");
+        program_cache_free(&context->cache);
+        sim_alloc_use(previous);
+        return -1;
+    }
+    context->cache.programs_dir = context->options.programs_dir;
+    external_catalog_init(&context->catalog, &context->cache);
+    context->owns_inputs = true;
+    context->inputs.cache = &context->cache;
+    context->inputs.catalog = &context->catalog;
+    context->inputs.vector_table = context->vector_table;
+
+    int result = load_external_files(external_files, &context->catalog);
+    if (result == 0)
+    {
+        result = load_vector_table(vector_table, context->vector_table, &context->cache.vector_count);
+    }
+
+    sim_alloc_use(previous);
+    return result;
+}
+
+// Function to parse a trace and every program it can EXEC before the run starts
+/**
+ * Optional: without it traces are parsed on their first EXEC, in the middle of the run.
+ * @param context Pointer to the context, with its inputs loaded
+ * @param trace Name of the trace that will be booted
+ * @return 0 on success, -1 if a trace cannot be loaded (the error is printed)
+ */
+int sim_context_preload(SimContext *context, const char *trace)
+{
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    ProgramCache *cache = context->inputs.cache;
+    uint32_t trace_id = program_cache_intern(cache, trace);
+    int result = -1;
+    if (trace_id == NAME_NOT_FOUND)
+    {
+        fprintf(context->report, "Error: Out of memory interning %s\n", trace);
+    }
+    else
+    {
+        result = program_cache_load_all(cache, trace_id);
+    }
+    sim_alloc_use(previous);
+    return result;
+}
+
+// Function to use inputs loaded once for many contexts (the caller keeps them alive and unchanged)
+/**
+ * A cache shared between threads has to be frozen with every program the runs can EXEC loaded.
+ * @param context Pointer to the context
+ * @param inputs Pointer to the shared inputs
+ */
+void sim_context_share(SimContext *context, const SimulationInputs *inputs)
+{
+    context->inputs = *inputs;
+    context->owns_inputs = false;
+}
+
+// Function to set up the memory partitions of a run from the partitions file (or the default layout)
+/**
+ * @param context Pointer to the context
+ * @return 0 on success, -1 on failure (the error is printed, nothing is left allocated)
+ */
+static int load_memory(SimContext *context)
+{
+    const SimulationOptions *options = &context->options;
+
+    // Initialize memory partitions
+    memory_init(&context->memory, options->fit, options->variable);
+    if (options->partitions_path != NULL)
+    {
+        if (memory_load_partitions(&context->memory, options->partitions_path) != 0)
+        {
+            memory_free(&context->memory);
+            return -1;
+        }
+    }
+    else if (memory_load_defaults(&context->memory) != 0)
+    {
+        fprintf(context->report, "Error: Cannot allocate the default memory partitions\n");
+        memory_free(&context->memory);
+        return -1;
+    }
+    if (context->memory.partition_count == 0)
+    {
+        fprintf(context->report, "Error: No memory partitions in %s\n", options->partitions_path);
+        memory_free(&context->memory);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to set up the devices of a run from the devices file (a run without one has none)
+/**
+ * @param context Pointer to the context
+ * @return 0 on success, -1 on failure (the error is printed, nothing is left allocated)
+ */
+static int load_devices(SimContext *context)
+{
+    if (context->options.devices_path == NULL)
+    {
+        return 0;
+    }
+
+    interrupt_controller_init(&context->interrupts);
+    if (interrupt_controller_load_devices(&context->interrupts, context->options.devices_path) != 0)
+    {
+        interrupt_controller_free(&context->interrupts);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to open the execution log and system status of a run
+/**
+ * @param context Pointer to the context
+ * @param output_path Execution log file
+ * @param status_path System status file
+ * @return 0 on success, -1 on failure (the error is printed, nothing is left open)
+ */
+static int open_outputs(SimContext *context, const char *output_path, const char *status_path)
+{
+    const SimulationOptions *options = &context->options;
+
+    // Open the output file, the execution log is rendered into a ring buffer and written out in batches
+    if (log_emitter_open(&context->log, output_path, &context->inputs.cache->names, options->format) != 0)
+    {
+        fprintf(context->report, "Error: Cannot open output file %s\n", output_path);
+        return -1;
+    }
+    context->log.timing = options->timing;
+
+    // Open the system status sink once for the whole run
+    if (status_sink_open(&context->status, status_path, options->status_flush, options->format) != 0)
+    {
+        fprintf(context->report, "Error: Cannot open %s for writing\n", status_path);
+        log_emitter_close(&context->log);
+        return -1;
+    }
+    if (status_sink_use_deltas(&context->status, options->status_keyframes) != 0)
+    {
+        fprintf(context->report, "Error: Cannot allocate the delta snapshot tables of %s\n", status_path);
+        status_sink_close(&context->status);
+        log_emitter_close(&context->log);
+        return -1;
+    }
+    if (options->install_signals)
+    {
+        status_sink_install_signals(&context->status);
+    }
+    return 0;
+}
+
+// Function to flush the outputs of a run and free its state (the inputs stay)
+/**
+ * @param context Pointer to the context
+ */
+static void close_run(SimContext *context)
+{
+    if (!context->started)
+    {
+        return;
+    }
+
+    log_emitter_close(&context->log);    // write out the rest of the execution log
+    status_sink_close(&context->status); // flush the remaining snapshots
+    engine_free(&context->engine);       // free the engine state
+    if (context->options.paging)
+    {
+        // the processes still alive when the run stops hold page tables
+        for (PCB *pcb = context->pcbs.head; pcb != NULL; pcb = pcb->next)
+        {
+            virtual_memory_release(&context->paging, pcb);
+        }
+        virtual_memory_free(&context->paging);
+    }
+    pcb_table_free(&context->pcbs);      // free the PCB table
+    memory_free(&context->memory);       // free the memory partitions
+    if (context->options.devices_path != NULL)
+    {
+        interrupt_controller_free(&context->interrupts); // drop the requests still outstanding
+    }
+    if (context->options.streaming)
+    {
+        trace_stream_close(&context->stream); // stop the reader thread
+    }
+    context->started = false;
+}
+
+// Function to open the outputs of a run and boot its trace in init
+/**
+ * @param context Pointer to the context, with its inputs loaded or shared
+ * @param trace Name of the trace booted in init
+ * @param output_path Execution log file
+ * @param status_path System status file
+ * @param seed Seed of the random duration splits
+ * @return 0 on success, -1 if the run cannot be set up (the error is printed)
+ */
+int sim_context_start(SimContext *context, const char *trace, const char *output_path, const char *status_path, uint64_t seed)
+{
+    if (context->options.cores < 1 || context->options.cores > SCHEDULER_MAX_CORES || (context->options.cores > 1 && context->options.policy == SCHEDULER_INLINE))
+    {
+        // inline scheduling runs a forked child before its parent, another core would run them side by side
+        fprintf(context->report, "Error: Cannot run on %u cores with the %s scheduler\n", context->options.cores, scheduler_policy_name(context->options.policy));
+        return -1;
+    }
+    if (context->options.devices_path != NULL && (context->options.cores != 1 || context->options.policy == SCHEDULER_INLINE))
+    {
+        // devices make a process wait for its request, inline scheduling has no queue to park it in
+        fprintf(context->report, "Error: Cannot simulate devices on %u cores with the %s scheduler\n", context->options.cores, scheduler_policy_name(context->options.policy));
+        return -1;
+    }
+    if (context->options.paging && (context->options.cores != 1 || (context->options.streaming && context->options.replacement == REPLACE_OPT)))
+    {
+        // the TLB belongs to one CPU, and the optimal policy looks ahead in traces a stream has not read yet
+        fprintf(context->report, "Error: Cannot page with %s replacement on %u cores%s\n", virtual_memory_policy_name(context->options.replacement), context->options.cores,
+                context->options.streaming ? " with a streamed trace" : "");
+        return -1;
+    }
+
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    int result = load_memory(context);
+    if (result == 0 && load_devices(context) != 0)
+    {
+        memory_free(&context->memory);
+        result = -1;
+    }
+    if (result == 0 && open_outputs(context, output_path, status_path) != 0)
+    {
+        if (context->options.devices_path != NULL)
+        {
+            interrupt_controller_free(&context->interrupts);
+        }
+        memory_free(&context->memory);
+        result = -1;
+    }
+    if (result == 0)
+    {
+        ProgramCache *cache = context->inputs.cache;
+
+        // Initialize the PCB table with the init template
+        result = pcb_table_init(&context->pcbs);
+
+        // The engine owns the simulated clock and the per-process trace positions
+        if (engine_init(&context->engine, context->inputs.vector_table, &context->log, context->inputs.catalog, &context->memory, cache, &context->status, &context->pcbs,
+                        context->options.policy, context->options.quantum, context->options.cores, seed) != 0)
+        {
+            result = -1;
+        }
+        context->engine.report = context->report;
+        if (context->options.devices_path != NULL)
+        {
+            context->engine.interrupts = &context->interrupts;
+        }
+        if (context->options.paging)
+        {
+            // by default the frames cover the whole memory, one per page
+            uint64_t frames = (context->options.frames != 0) ? context->options.frames : context->memory.total / VIRTUAL_MEMORY_PAGE_SIZE;
+            if (virtual_memory_init(&context->paging, context->options.replacement, (frames > 0) ? (uint32_t)frames : 1, context->options.tlb_size) != 0)
+            {
+                result = -1;
+            }
+            context->engine.paging = &context->paging;
+        }
+        uint32_t trace_id = program_cache_intern(cache, trace);
+        context->started = true;
+        if (result != 0 || trace_id == NAME_NOT_FOUND)
+        {
+            fprintf(context->report, "Error: Cannot allocate the state of the run\n");
+            context->options.streaming = false; // nothing to close
+            close_run(context);
+            result = -1;
+        }
+
+        // a streamed trace is parsed by a reader thread while the simulation runs, memory use does not grow with its length
+        if (result == 0 && context->options.streaming)
+        {
+            if (trace_stream_open(&context->stream, trace, cache->programs_dir, &cache->names, cache->vector_count) != 0)
+            {
+                context->options.streaming = false; // nothing to close
+                close_run(context);
+                result = -1;
+            }
+            else if (program_cache_stream(cache, trace_id, &context->stream) == NULL)
+            {
+                fprintf(context->report, "Error: Cannot allocate the streamed program %s\n", trace);
+                close_run(context);
+                result = -1;
+            }
+        }
+
+        // ASSUMPION: init is initialized by a trace file
+        // engine_start(&context->engine, context->pcbs.head, trace_id);
+
+        // Fork the init process and exec the trace in it
+        if (result == 0 && engine_boot(&context->engine, trace_id) != 0)
+        {
+            fprintf(context->report, "Error: Cannot allocate the init process\n");
+            close_run(context);
+            result = -1;
+        }
+    }
+
+    sim_alloc_use(previous);
+    return result;
+}
+
+// Function to open the outputs of a run and load the simulator state of a checkpoint into it
+/**
+ * The run carries on from the checkpointed time with the checkpoint's scheduler, quantum, fit policy and
+ * partitions (they replace the context's settings). The outputs start at the checkpoint, they hold what follows it.
+ * @param context Pointer to the context, with its inputs loaded
+ * @param checkpoint_path Checkpoint file written by sim_context_checkpoint
+ * @param output_path Execution log file
+ * @param status_path System status file
+ * @return 0 on success, -1 if the checkpoint cannot be restored (the error is printed)
+ */
+int sim_context_restore(SimContext *context, const char *checkpoint_path, const char *output_path, const char *status_path)
+{
+    if (context->options.streaming || context->options.cores != 1 || context->options.devices_path != NULL || context->options.paging)
+    {
+        fprintf(context->report, "Error: A checkpoint is restored on a single core, without --stream, --devices or --paging\n");
+        return -1;
+    }
+
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    Checkpoint checkpoint;
+    int result = checkpoint_open(&checkpoint, checkpoint_path, context->report);
+    if (result == 0)
+    {
+        const CheckpointHeader *header = checkpoint.header;
+        context->options.policy = (SchedulerPolicy)header->policy;
+        context->options.quantum = header->quantum;
+        context->options.fit = (FitPolicy)header->fit;
+        context->options.variable = header->variable != 0;
+
+        // the partitions come from the checkpoint, not from the layout file
+        memory_init(&context->memory, context->options.fit, context->options.variable);
+        result = open_outputs(context, output_path, status_path);
+        if (result != 0)
+        {
+            memory_free(&context->memory);
+        }
+    }
+    if (result == 0)
+    {
+        result = pcb_table_init(&context->pcbs);
+        if (engine_init(&context->engine, context->inputs.vector_table, &context->log, context->inputs.catalog, &context->memory, context->inputs.cache, &context->status, &context->pcbs,
+                        context->options.policy, context->options.quantum, 1, 0) != 0)
+        {
+            result = -1;
+        }
+        context->engine.report = context->report;
+        context->started = true;
+        if (result != 0)
+        {
+            fprintf(context->report, "Error: Cannot allocate the state of the run\n");
+            close_run(context);
+        }
+        else if (checkpoint_restore(&checkpoint, &context->engine) != 0)
+        {
+            close_run(context);
+            result = -1;
+        }
+    }
+    if (checkpoint.header != NULL)
+    {
+        checkpoint_close(&checkpoint);
+    }
+
+    sim_alloc_use(previous);
+    return result;
+}
+
+// Function to save the simulator state of a started run to a checkpoint file
+/**
+ * Called between two steps, the run itself carries on unchanged.
+ * @param context Pointer to the context
+ * @param path Checkpoint file
+ * @return 0 on success, -1 if the state cannot be saved (the error is printed)
+ */
+int sim_context_checkpoint(const SimContext *context, const char *path)
+{
+    if (context->options.streaming)
+    {
+        // the reader thread has dropped the start of the trace, a restore could not read it again
+        fprintf(context->report, "Error: A streamed run cannot be checkpointed\n");
+        return -1;
+    }
+    if (context->options.devices_path != NULL)
+    {
+        // the outstanding requests and latched interrupts are not part of a checkpoint
+        fprintf(context->report, "Error: A run with devices cannot be checkpointed\n");
+        return -1;
+    }
+    if (context->options.paging)
+    {
+        // the frames, the TLB and the page tables are not part of a checkpoint
+        fprintf(context->report, "Error: A paged run cannot be checkpointed\n");
+        return -1;
+    }
+
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    int result = checkpoint_save(&context->engine, path);
+    sim_alloc_use(previous);
+    return result;
+}
+
+// Function to execute the next trace event of a started run
+/**
+ * @param context Pointer to the context
+ * @return false once there is no process left to run (or the run failed)
+ */
+bool sim_context_step(SimContext *context)
+{
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    bool running = engine_step(&context->engine);
+    if (!running && context->options.streaming)
+    {
+        trace_stream_stop(&context->stream); // the run is over, its counters must not move while they are reported
+    }
+    sim_alloc_use(previous);
+    return running;
+}
+
+// Function to run a started simulation to its end
+/**
+ * @param context Pointer to the context
+ * @return 0 on success, 1 if a trace could not be loaded or the streamed trace was malformed
+ */
+int sim_context_run(SimContext *context)
+{
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    engine_run(&context->engine);
+    if (context->options.streaming)
+    {
+        trace_stream_stop(&context->stream);
+    }
+
+    int exit_code = context->engine.failed ? 1 : 0;
+    if (context->options.streaming && trace_stream_error(&context->stream) != NULL)
+    {
+        // the simulation ran up to the bad line, everything before it is in the outputs
+        fprintf(context->report, "Error: %s\n", trace_stream_error(&context->stream));
+        exit_code = 1;
+    }
+
+    sim_alloc_use(previous);
+    return exit_code;
+}
+
+// Function to get the simulated clock of a started run
+/**
+ * @param context Pointer to the context
+ * @return Current simulated time (ms)
+ */
+uint64_t sim_context_time(const SimContext *context)
+{
+    return context->engine.current_time;
+}
+
+// Function to print the end of run report
+/**
+ * @param context Pointer to the context
+ */
+void sim_context_report(const SimContext *context)
+{
+    fprintf(context->report, "Simulation complete\n");
+    if (!context->inputs.cache->frozen)
+    {
+        // a frozen cache is shared by the whole batch, it is reported once at the end
+        program_cache_report(context->inputs.cache, context->report);
+    }
+    if (context->options.streaming && context->stream.joined)
+    {
+        // only once the run is over, the reader thread no longer moves the counters
+        trace_stream_report(&context->stream, context->report);
+    }
+    scheduler_report(&context->engine.scheduler, context->engine.current_time, context->report);
+    engine_report(&context->engine, context->report);
+    if (context->options.devices_path != NULL)
+    {
+        interrupt_controller_report(&context->interrupts, context->engine.current_time, context->report);
+    }
+    pcb_table_report(&context->pcbs, context->report);
+    if (context->options.paging)
+    {
+        virtual_memory_report(&context->paging, context->report);
+    }
+    else
+    {
+        memory_report(&context->memory, context->report);
+    }
+}
+
+// Function to flush the outputs and free everything the context holds
+/**
+ * @param context Pointer to the context
+ */
+void sim_context_destroy(SimContext *context)
+{
+    const SimAllocator *previous = sim_alloc_use(context->allocator);
+    close_run(context);
+    if (context->owns_inputs)
+    {
+        external_catalog_free(&context->catalog); // free the external files
+        program_cache_free(&context->cache);      // free the cached traces
+        context->owns_inputs = false;
+    }
+    sim_alloc_use(previous);
+}
+
+// Function to run one simulation on shared inputs from boot to the last process exit
+/**
+ * @param options Pointer to the run settings
+ * @param inputs Pointer to the shared inputs
+ * @param trace Name of the trace booted in init
+ * @param output_path Execution log file
+ * @param status_path System status file
+ * @param seed Seed of the random duration splits
+ * @param report Stream the end of run report (and errors) are printed to
+ * @return 0 on success, 1 if the run could not be set up or failed
+ */
+int simulation_run(const SimulationOptions *options, const SimulationInputs *inputs, const char *trace, const char *output_path, const char *status_path, uint64_t seed, FILE *report)
+{
+    SimContext context;
+    sim_context_init(&context, options, NULL, report);
+    sim_context_share(&context, inputs);
+    if (sim_context_start(&context, trace, output_path, status_path, seed) != 0)
+    {
+        return 1;
+    }
+
+    int exit_code = sim_context_run(&context);
+    sim_context_report(&context);
+    sim_context_destroy(&context);
+    return exit_code;
+}
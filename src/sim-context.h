@@ -0,0 +1,101 @@
+#ifndef SIM_CONTEXT_H
+#define SIM_CONTEXT_H
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stdbool.h> // for bool
+#include "process-simulator.h"
+#include "program-cache.h"
+#include "external-catalog.h"
+#include "scheduler.h"
+#include "memory-manager.h"
+#include "log-emitter.h"
+#include "status-sink.h"
+#include "pcb-table.h"
+#include "engine.h"
+#include "trace-stream.h"
+#include "sim-alloc.h"
+#include "checkpoint.h"
+#include "interrupt-controller.h"
+#include "virtual-memory.h"
+
+// structs
+
+// settings of a run that do not come from its input files
+typedef struct
+{
+    SchedulerPolicy policy;      // scheduling policy
+    uint32_t quantum;            // round-robin time slice (ms)
+    uint32_t cores;              // simulated CPU cores, 1 to SCHEDULER_MAX_CORES (more than one needs a policy other than inline)
+    const char *partitions_path; // memory partition layout, NULL for the six fixed partitions
+    const char *devices_path;    // device priorities and handler times, NULL for I/O that completes after a fixed delay
+    const char *programs_dir;    // directory of the programs named in an EXEC
+    FitPolicy fit;               // partition fit policy
+    bool variable;               // split and coalesce partitions
+    bool paging;                 // load programs into pages instead of partitions
+    ReplacementPolicy replacement; // page replacement policy (paging)
+    uint32_t frames;             // physical frames (paging), 0 for as many as the memory holds
+    uint32_t tlb_size;           // TLB entries (paging)
+    LogFormat format;            // text or binary outputs
+    uint32_t status_flush;       // flush the system status every n snapshots (0 = at exit)
+    uint32_t status_keyframes;   // delta system status with a full snapshot every n snapshots (0 = every snapshot is full)
+    bool streaming;              // read the trace through a TraceStream (not with shared inputs)
+    bool install_signals;        // let SIGUSR1 / SIGTERM flush the system status (one context per process)
+    bool timing;                 // time the execution log writes (--timing)
+} SimulationOptions;
+
+// read-only inputs, the same ones can be used by simulations running on several threads
+typedef struct
+{
+    ProgramCache *cache;            // parsed traces (frozen when shared between threads)
+    const ExternalCatalog *catalog; // program sizes and priorities
+    const int *vector_table;        // ISR addresses by vector
+} SimulationInputs;
+
+// one simulator instance: no global state, any number of contexts can run side by side
+typedef struct
+{
+    SimulationOptions options;
+    const SimAllocator *allocator; // allocation hooks, NULL for the C library
+    FILE *report;                  // setup errors, run errors and the end of run report
+
+    // inputs, loaded by sim_context_load (owned) or shared with sim_context_share (borrowed)
+    SimulationInputs inputs;
+    ProgramCache cache;
+    ExternalCatalog catalog;
+    int vector_table[VECTOR_TABLE_SIZE];
+    bool owns_inputs;
+
+    // state of the run, set up by sim_context_start
+    MemoryManager memory;
+    LogEmitter log;
+    StatusSink status;
+    PcbTable pcbs;
+    InterruptController interrupts; // devices of the run (with a devices file)
+    VirtualMemory paging;           // frames and TLB of a paged run
+    Engine engine;
+    TraceStream stream;
+    bool started;
+} SimContext;
+
+// -----------------------------------------------------------
+
+void simulation_options_init(SimulationOptions *options);
+void sim_context_init(SimContext *context, const SimulationOptions *options, const SimAllocator *allocator, FILE *report);
+int sim_context_load(SimContext *context, const char *external_files, const char *vector_table);
+int sim_context_preload(SimContext *context, const char *trace);
+void sim_context_share(SimContext *context, const SimulationInputs *inputs);
+int sim_context_start(SimContext *context, const char *trace, const char *output_path, const char *status_path, uint64_t seed);
+int sim_context_restore(SimContext *context, const char *checkpoint_path, const char *output_path, const char *status_path);
+int sim_context_checkpoint(const SimContext *context, const char *path);
+bool sim_context_step(SimContext *context);
+int sim_context_run(SimContext *context);
+uint64_t sim_context_time(const SimContext *context);
+void sim_context_report(const SimContext *context);
+void sim_context_destroy(SimContext *context);
+int simulation_run(const SimulationOptions *options, const SimulationInputs *inputs, const char *trace, const char *output_path, const char *status_path, uint64_t seed, FILE *report);
+
+// -----------------------------------------------------------
+
+#endif // SIM_CONTEXT_H
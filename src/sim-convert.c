@@ -0,0 +1,206 @@
+#include "log-emitter.h"
+#include "status-sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Function to read a whole file into memory
+/**
+ * @param filename Name of the file to read
+ * @param length Pointer to the size of the file
+ * @return Pointer to the contents (caller frees), or NULL if the file cannot be read
+ */
+static uint8_t *read_file(const char *filename, size_t *length)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+
+    size_t capacity = 1 << 16;
+    uint8_t *data = (uint8_t *)malloc(capacity);
+    *length = 0;
+    size_t n;
+    while (data != NULL && (n = fread(data + *length, 1, capacity - *length, file)) > 0)
+    {
+        *length += n;
+        if (*length == capacity)
+        {
+            capacity *= 2;
+            uint8_t *grown = (uint8_t *)realloc(data, capacity);
+            if (grown == NULL)
+            {
+                free(data);
+            }
+            data = grown;
+        }
+    }
+
+    fclose(file);
+    return data;
+}
+
+// Function to convert a binary execution log or system status back to the text format
+/**
+ * @param data Pointer to the binary file contents
+ * @param length Size of the file
+ * @param out Stream the text is written to
+ * @return 0 on success, -1 if the file is malformed
+ */
+static int convert(const uint8_t *data, size_t length, FILE *out)
+{
+    LogKind kind;
+    if (log_decode_header(data, length, &kind) != 0)
+    {
+        printf("Error: Not a binary simulator output file\n");
+        return -1;
+    }
+
+    // string table, filled in as definitions are met (a name is always defined before its first use)
+    char **names = NULL;
+    uint32_t name_count = 0;
+    uint32_t rows_left = 0;
+    bool delta = false; // the rows left belong to a delta snapshot
+    int result = 0;
+
+    size_t offset = LOG_BINARY_HEADER_SIZE;
+    while (offset < length && result == 0)
+    {
+        LogRecord record;
+        size_t size = log_decode_record(data + offset, length - offset, &record);
+        if (size == 0)
+        {
+            printf("Error: Truncated record at offset %zu\n", offset);
+            result = -1;
+            break;
+        }
+        size_t record_offset = offset;
+        offset += size;
+
+        if (record.code == LOG_DEFINE_NAME)
+        {
+            size_t padded = (record.duration + LOG_BINARY_RECORD_SIZE - 1) / LOG_BINARY_RECORD_SIZE * LOG_BINARY_RECORD_SIZE;
+            if (record.duration > LOG_EMITTER_MAX_NAME || offset + padded > length)
+            {
+                printf("Error: Truncated name definition at offset %zu\n", record_offset);
+                result = -1;
+                break;
+            }
+            uint32_t id = record.arg;
+            if (id >= name_count)
+            {
+                uint32_t count = (name_count == 0) ? 64 : name_count;
+                while (count <= id)
+                {
+                    count *= 2;
+                }
+                names = (char **)realloc(names, count * sizeof(char *));
+                memset(names + name_count, 0, (count - name_count) * sizeof(char *));
+                name_count = count;
+            }
+            free(names[id]);
+            names[id] = (char *)malloc(record.duration + 1);
+            memcpy(names[id], data + offset, record.duration);
+            names[id][record.duration] = '\0';
+            offset += padded;
+            continue;
+        }
+
+        // names used by the record must have been defined already
+        bool uses_name = (record.code == LOG_EXEC_LOAD || record.code == LOG_STATUS_ROW);
+        const char *name = (uses_name && record.name < name_count) ? names[record.name] : NULL;
+        if (uses_name && name == NULL)
+        {
+            printf("Error: Undefined name %u at offset %zu\n", record.name, record_offset);
+            result = -1;
+            break;
+        }
+
+        if (kind == LOG_KIND_EXECUTION && record.code < LOG_CODE_COUNT)
+        {
+            char line[LOG_EMITTER_MAX_RECORD];
+            fwrite(line, 1, log_format_text(&record, name, line), out);
+        }
+        else if (kind == LOG_KIND_STATUS && record.code == LOG_STATUS_SNAPSHOT && rows_left == 0)
+        {
+            fprintf(out, STATUS_SNAPSHOT_HEADER, (unsigned long long)record.time);
+            rows_left = record.arg;
+            delta = false;
+            if (rows_left == 0)
+            {
+                fprintf(out, STATUS_SNAPSHOT_FOOTER);
+            }
+        }
+        else if (kind == LOG_KIND_STATUS && record.code == LOG_STATUS_DELTA && rows_left == 0)
+        {
+            // a delta has no footer, the next snapshot starts right after its rows
+            fprintf(out, STATUS_DELTA_HEADER, (unsigned long long)record.time);
+            rows_left = record.arg;
+            delta = true;
+        }
+        else if (kind == LOG_KIND_STATUS && record.code == LOG_STATUS_EXIT && rows_left > 0 && delta)
+        {
+            fprintf(out, STATUS_DELTA_EXIT, (uint16_t)record.pid);
+            rows_left--;
+        }
+        else if (kind == LOG_KIND_STATUS && record.code == LOG_STATUS_PAGING && rows_left == 0)
+        {
+            fprintf(out, STATUS_PAGING_LINE, (unsigned long long)record.arg, (unsigned long long)record.name, (unsigned long long)record.duration, record.partition);
+        }
+        else if (kind == LOG_KIND_STATUS && record.code == LOG_STATUS_ROW && rows_left > 0)
+        {
+            fprintf(out, delta ? STATUS_DELTA_ROW : STATUS_SNAPSHOT_ROW, (uint16_t)record.pid, name, record.partition, record.arg);
+            if (--rows_left == 0 && !delta)
+            {
+                fprintf(out, STATUS_SNAPSHOT_FOOTER);
+            }
+        }
+        else
+        {
+            printf("Error: Unexpected record code %u at offset %zu\n", record.code, record_offset);
+            result = -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < name_count; i++)
+    {
+        free(names[i]);
+    }
+    free(names);
+    return result;
+}
+
+// Main function: sim-convert <binary_file> <text_file>
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <binary_file> <text_file>\n", argv[0]);
+        printf("Converts a --format binary execution log or system status back to the text format\n");
+        return 1;
+    }
+
+    size_t length;
+    uint8_t *data = read_file(argv[1], &length);
+    if (data == NULL)
+    {
+        printf("Error: Cannot open file %s\n", argv[1]);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out)
+    {
+        printf("Error: Cannot open output file %s\n", argv[2]);
+        free(data);
+        return 1;
+    }
+
+    int result = convert(data, length, out);
+    fclose(out);
+    free(data);
+    return (result == 0) ? 0 : 1;
+}
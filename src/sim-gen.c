@@ -0,0 +1,333 @@
+#include "random.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+// configurations
+#define GEN_VECTORS 26          // vectors used by SYSCALL and END_IO (the size of additionalFiles/vector_table.txt)
+#define GEN_PARTITION_SIZE 16   // Mb per generated partition
+#define GEN_MAX_PROGRAM_SIZE 12 // programs are 1 to this many Mb, so any of them fits a partition
+
+// structs
+
+typedef enum
+{
+    SHAPE_TREE,  // random fork/exec tree: every program is spawned once, by an earlier one
+    SHAPE_CHAIN, // deep EXEC chain: every program replaces itself with the next one
+    SHAPE_IO     // SYSCALL/END_IO heavy mix, spawned flat from the top-level trace
+} Shape;
+
+typedef struct
+{
+    Shape shape;
+    uint32_t programs; // number of generated programs
+    uint32_t events;   // events per program (and in the top-level trace)
+    uint32_t fanout;   // most programs spawned by one program (tree)
+    uint32_t next;     // next program the tree has not spawned yet
+    const char *out;   // output directory
+    Rng rng;
+} Generator;
+
+// Function to draw a duration in a range
+/**
+ * @param gen Pointer to the generator
+ * @param low Smallest duration
+ * @param high Largest duration
+ * @return Duration in [low, high]
+ */
+static uint32_t draw(Generator *gen, uint32_t low, uint32_t high)
+{
+    return low + (uint32_t)rng_below(&gen->rng, (uint64_t)(high - low) + 1);
+}
+
+// Function to write a CPU, SYSCALL or END_IO event
+/**
+ * @param gen Pointer to the generator
+ * @param out File to write to
+ * @param io_share Percent of the events that are SYSCALL or END_IO
+ */
+static void write_work(Generator *gen, FILE *out, uint32_t io_share)
+{
+    if (rng_below(&gen->rng, 100) >= io_share)
+    {
+        fprintf(out, "CPU, %u\n", draw(gen, 1, 100));
+        return;
+    }
+
+    const char *kind = (rng_below(&gen->rng, 2) == 0) ? "SYSCALL" : "END_IO";
+    fprintf(out, "%s %u, %u\n", kind, (uint32_t)rng_below(&gen->rng, GEN_VECTORS), draw(gen, 10, 300));
+}
+
+// Function to write a FORK and the EXEC of a program in the child
+/**
+ * @param gen Pointer to the generator
+ * @param out File to write to
+ * @param program Number of the program to run
+ */
+static void write_spawn(Generator *gen, FILE *out, uint32_t program)
+{
+    fprintf(out, "FORK, %u\n", draw(gen, 1, 20));
+    fprintf(out, "EXEC program%u, %u\n", program, draw(gen, 10, 80));
+}
+
+// Function to open a file in the output directory
+/**
+ * @param gen Pointer to the generator
+ * @param name File name
+ * @return The open file, or NULL (the error is printed)
+ */
+static FILE *open_output(const Generator *gen, const char *name)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", gen->out, name);
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        printf("Error: Cannot open output file %s\n", path);
+    }
+    return file;
+}
+
+// Function to write the body of a program (or of the top-level trace)
+/**
+ * @param gen Pointer to the generator
+ * @param out File to write to
+ * @param program Number of the program, 0 for the top-level trace
+ */
+static void write_program(Generator *gen, FILE *out, uint32_t program)
+{
+    uint32_t io_share = (gen->shape == SHAPE_IO) ? 80 : 30;
+
+    // spawns are spread over the program, so children run while their parent still works
+    uint32_t spawns = 0;
+    if (gen->shape == SHAPE_TREE)
+    {
+        // children are handed out breadth first, so the tree has exactly one process per program
+        uint32_t left = gen->programs - gen->next + 1;
+        spawns = (uint32_t)rng_below(&gen->rng, (uint64_t)gen->fanout + 1);
+        if (spawns == 0 && gen->next == program + 1)
+        {
+            spawns = 1; // nobody else is left to spawn the rest of the tree
+        }
+        spawns = (spawns < left) ? spawns : left;
+    }
+    else if (gen->shape == SHAPE_IO && program == 0)
+    {
+        spawns = gen->programs;
+    }
+    else if (gen->shape == SHAPE_CHAIN && program == 0)
+    {
+        spawns = 1;
+    }
+
+    // spawns go between the events at evenly spaced points
+    uint64_t total = (uint64_t)gen->events + spawns;
+    uint32_t spawned = 0;
+    for (uint64_t i = 0; i < total; i++)
+    {
+        if (spawned < spawns && i * spawns >= (uint64_t)spawned * total)
+        {
+            uint32_t child = (gen->shape == SHAPE_TREE) ? gen->next++ : spawned + 1;
+            write_spawn(gen, out, child);
+            spawned++;
+            continue;
+        }
+        write_work(gen, out, io_share);
+    }
+
+    // the chain goes on in the same process
+    if (gen->shape == SHAPE_CHAIN && program != 0 && program < gen->programs)
+    {
+        fprintf(out, "EXEC program%u, %u\n", program + 1, draw(gen, 10, 80));
+    }
+}
+
+// Function to write the whole workload
+/**
+ * @param gen Pointer to the generator
+ * @return 0 on success, -1 if a file cannot be written
+ */
+static int generate(Generator *gen)
+{
+    if (mkdir(gen->out, 0755) != 0 && errno != EEXIST)
+    {
+        printf("Error: Cannot create directory %s\n", gen->out);
+        return -1;
+    }
+
+    FILE *trace = open_output(gen, "trace.txt");
+    FILE *external = open_output(gen, "external_files.txt");
+    FILE *partitions = open_output(gen, "partitions.txt");
+    int result = (trace && external && partitions) ? 0 : -1;
+
+    if (result == 0)
+    {
+        write_program(gen, trace, 0);
+        fprintf(partitions, "# partition number, size (Mb), in address order\n");
+
+        // one partition per program and one for init: every live process can hold one at the same time
+        for (uint32_t i = 1; i <= gen->programs; i++)
+        {
+            fprintf(external, "program%u, %u\n", i, draw(gen, 1, GEN_MAX_PROGRAM_SIZE));
+        }
+        for (uint32_t i = 1; i <= gen->programs + 1; i++)
+        {
+            fprintf(partitions, "%u, %u\n", i, GEN_PARTITION_SIZE);
+        }
+    }
+
+    for (uint32_t i = 1; i <= gen->programs && result == 0; i++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "program%u.txt", i);
+        FILE *program = open_output(gen, name);
+        if (!program)
+        {
+            result = -1;
+            break;
+        }
+        write_program(gen, program, i);
+        fclose(program);
+    }
+
+    if (trace)
+    {
+        fclose(trace);
+    }
+    if (external)
+    {
+        fclose(external);
+    }
+    if (partitions)
+    {
+        fclose(partitions);
+    }
+    return result;
+}
+
+// Function to parse a positive number option
+/**
+ * @param text Option value
+ * @param value Pointer to the number
+ * @return 0 on success, -1 if it is not a number from 1 to UINT32_MAX
+ */
+static int parse_count(const char *text, uint32_t *value)
+{
+    char *end = NULL;
+    errno = 0;
+    unsigned long number = strtoul(text, &end, 10);
+    if (*text == '\0' || *text == '-' || *end != '\0' || errno != 0 || number == 0 || number > UINT32_MAX)
+    {
+        return -1;
+    }
+    *value = (uint32_t)number;
+    return 0;
+}
+
+// Function to print the command-line usage
+/**
+ * @param program Name of the executable
+ */
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [options] <output_dir>\n", program);
+    printf("Writes trace.txt, program1.txt .. programN.txt, external_files.txt and partitions.txt into output_dir\n");
+    printf("Run it with: ./sim --programs <output_dir> --partitions <output_dir>/partitions.txt <output_dir>/trace.txt <output_dir>/external_files.txt additionalFiles/vector_table.txt <output_file>\n");
+    printf("Options:\n");
+    printf("  --shape <shape>   tree (random fork/exec tree), chain (deep EXEC chain) or io (SYSCALL/END_IO heavy) (default tree)\n");
+    printf("  --programs <n>    number of programs (default 100)\n");
+    printf("  --events <n>      events per program and in the top-level trace (default 1000)\n");
+    printf("  --fanout <n>      most programs spawned by one program, tree only (default 4)\n");
+    printf("  --seed <n>        seed of the generator (default 1)\n");
+}
+
+// Main function: sim-gen [options] <output_dir>
+int main(int argc, char *argv[])
+{
+    Generator gen = {.shape = SHAPE_TREE, .programs = 100, .events = 1000, .fanout = 4, .next = 1};
+    uint64_t seed = 1;
+
+    static const struct option long_options[] = {
+        {"shape", required_argument, NULL, 's'},
+        {"programs", required_argument, NULL, 'p'},
+        {"events", required_argument, NULL, 'e'},
+        {"fanout", required_argument, NULL, 'f'},
+        {"seed", required_argument, NULL, 'r'},
+        {NULL, 0, NULL, 0}};
+
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1)
+    {
+        char *end = NULL;
+        switch (option)
+        {
+        case 's':
+            if (strcmp(optarg, "tree") == 0)
+            {
+                gen.shape = SHAPE_TREE;
+            }
+            else if (strcmp(optarg, "chain") == 0)
+            {
+                gen.shape = SHAPE_CHAIN;
+            }
+            else if (strcmp(optarg, "io") == 0)
+            {
+                gen.shape = SHAPE_IO;
+            }
+            else
+            {
+                printf("Error: Unknown shape %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'p':
+            if (parse_count(optarg, &gen.programs) != 0)
+            {
+                printf("Error: Invalid --programs value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'e':
+            if (parse_count(optarg, &gen.events) != 0)
+            {
+                printf("Error: Invalid --events value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (parse_count(optarg, &gen.fanout) != 0)
+            {
+                printf("Error: Invalid --fanout value %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'r':
+            errno = 0;
+            seed = strtoull(optarg, &end, 0);
+            if (*optarg == '\0' || *optarg == '-' || *end != '\0' || errno != 0)
+            {
+                printf("Error: Invalid --seed value %s\n", optarg);
+                return 1;
+            }
+            break;
+        default:
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind != 1)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    gen.out = argv[optind];
+    rng_seed(&gen.rng, seed);
+    return (generate(&gen) == 0) ? 0 : 1;
+}
@@ -0,0 +1,526 @@
+#define _GNU_SOURCE // for memmem
+#include "log-emitter.h"
+#include "status-sink.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// configurations
+#define KEYFRAME_MARK "\nSave Time: " // a full snapshot starts on the line after the newline
+#define MAX_LINE 512                  // longest line of a text status file
+#define MAX_PIDS 65536                // pids are 16 bits
+
+// structs
+
+// one row of the rebuilt table
+typedef struct
+{
+    uint16_t pid;
+    uint32_t partition;
+    uint32_t size;
+    char name[LOG_EMITTER_MAX_NAME + 1];
+} TableRow;
+
+// the table as of the last snapshot applied, rows in table order
+typedef struct
+{
+    TableRow *rows;
+    size_t count;
+    size_t capacity;
+    uint32_t *index;    // pid -> row + 1 (0 = the pid is not in the table)
+    uint64_t snapshots; // snapshots (full or delta) applied
+} Table;
+
+// Function to find the row of a pid
+/**
+ * @param table Pointer to the table
+ * @param pid Process id
+ * @return Index of the row, or table->count if the pid is not in the table
+ */
+static size_t table_find(const Table *table, uint16_t pid)
+{
+    return (table->index[pid] != 0) ? table->index[pid] - 1 : table->count;
+}
+
+// Function to empty the table for a full snapshot
+/**
+ * @param table Pointer to the table
+ */
+static void table_clear(Table *table)
+{
+    for (size_t i = 0; i < table->count; i++)
+    {
+        table->index[table->rows[i].pid] = 0;
+    }
+    table->count = 0;
+}
+
+// Function to remove the row of a pid (the rows after it keep their order)
+/**
+ * @param table Pointer to the table
+ * @param pid Process id
+ */
+static void table_remove(Table *table, uint16_t pid)
+{
+    size_t i = table_find(table, pid);
+    if (i < table->count)
+    {
+        memmove(&table->rows[i], &table->rows[i + 1], (table->count - i - 1) * sizeof(TableRow));
+        table->count--;
+        table->index[pid] = 0;
+        for (size_t j = i; j < table->count; j++)
+        {
+            table->index[table->rows[j].pid] = (uint32_t)j + 1;
+        }
+    }
+}
+
+// Function to change the row of a pid in place, or append it if the pid is new
+/**
+ * @param table Pointer to the table
+ * @param pid Process id
+ * @param name Program name
+ * @param partition Partition number
+ * @param size Program size
+ * @return 0 on success, -1 if the table cannot grow
+ */
+static int table_put(Table *table, uint16_t pid, const char *name, uint32_t partition, uint32_t size)
+{
+    size_t i = table_find(table, pid);
+    if (i == table->count)
+    {
+        if (table->count == table->capacity)
+        {
+            size_t capacity = (table->capacity == 0) ? 64 : table->capacity * 2;
+            TableRow *grown = (TableRow *)realloc(table->rows, capacity * sizeof(TableRow));
+            if (grown == NULL)
+            {
+                return -1;
+            }
+            table->rows = grown;
+            table->capacity = capacity;
+        }
+        table->count++;
+        table->index[pid] = (uint32_t)i + 1;
+    }
+
+    TableRow *row = &table->rows[i];
+    row->pid = pid;
+    row->partition = partition;
+    row->size = size;
+    snprintf(row->name, sizeof(row->name), "%s", name);
+    return 0;
+}
+
+// -----------------------------------------------------------
+// Text status files
+// -----------------------------------------------------------
+
+// Function to find the next full snapshot of a text status file
+/**
+ * @param data Pointer to the file contents
+ * @param length Size of the file
+ * @param from Offset to search from
+ * @param limit Offset the snapshot has to start before
+ * @param time Pointer to the time of the snapshot found
+ * @return Offset of its "Save Time" line, or length if there is no full snapshot in [from, limit)
+ */
+static size_t next_keyframe(const char *data, size_t length, size_t from, size_t limit, uint64_t *time)
+{
+    size_t mark = strlen(KEYFRAME_MARK);
+    size_t end = (limit + mark < length) ? limit + mark : length;
+    const char *found = (from < end) ? (const char *)memmem(data + from, end - from, KEYFRAME_MARK, mark) : NULL;
+    if (found == NULL || (size_t)(found - data) + 1 >= limit)
+    {
+        return length;
+    }
+    *time = strtoull(found + mark, NULL, 10);
+    return (size_t)(found - data) + 1;
+}
+
+// Function to find the last full snapshot taken at or before a time
+/**
+ * Snapshots are in time order, so the keyframes are bisected by file offset: every probe only reads up to the next keyframe.
+ * @param data Pointer to the file contents
+ * @param length Size of the file
+ * @param time Time to rebuild the table at
+ * @return Offset of the snapshot's "Save Time" line, or length if every full snapshot is later
+ */
+static size_t find_keyframe(const char *data, size_t length, uint64_t time)
+{
+    size_t best = length;
+    size_t low = 0;
+    size_t high = length;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        uint64_t found_time = 0;
+        size_t found = next_keyframe(data, length, middle, high, &found_time);
+        if (found == length || found_time > time)
+        {
+            // no keyframe in [middle, high) is early enough
+            high = middle;
+        }
+        else
+        {
+            best = found;
+            low = found + 1;
+        }
+    }
+
+    return best;
+}
+
+// Function to replay a text status file from a full snapshot up to a time
+/**
+ * @param data Pointer to the file contents
+ * @param length Size of the file
+ * @param offset Offset of the full snapshot to start from
+ * @param time Time to rebuild the table at
+ * @param table Pointer to the table
+ * @return 0 on success, -1 if a line is malformed (the error is printed)
+ */
+static int replay_text(const char *data, size_t length, size_t offset, uint64_t time, Table *table)
+{
+    bool in_keyframe = false;
+    while (offset < length)
+    {
+        // copy the line out of the mapping so it is terminated
+        const char *end = (const char *)memchr(data + offset, '\n', length - offset);
+        size_t line_length = (end != NULL) ? (size_t)(end - (data + offset)) : length - offset;
+        char line[MAX_LINE];
+        if (line_length >= sizeof(line))
+        {
+            printf("Error: Line longer than %d bytes at offset %zu\n", MAX_LINE, offset);
+            return -1;
+        }
+        memcpy(line, data + offset, line_length);
+        line[line_length] = '\0';
+        offset += line_length + 1;
+
+        unsigned long long snapshot_time;
+        unsigned short pid;
+        char name[LOG_EMITTER_MAX_NAME + 1];
+        unsigned partition;
+        unsigned size;
+        if (sscanf(line, "Save Time: %llu ms", &snapshot_time) == 1)
+        {
+            if (snapshot_time > time)
+            {
+                break;
+            }
+            table_clear(table);
+            table->snapshots++;
+            in_keyframe = true;
+        }
+        else if (sscanf(line, "Delta Time: %llu ms", &snapshot_time) == 1)
+        {
+            if (snapshot_time > time)
+            {
+                break;
+            }
+            table->snapshots++;
+            in_keyframe = false;
+        }
+        else if (in_keyframe && sscanf(line, "| %hu | %255s | %u | %u |", &pid, name, &partition, &size) == 4)
+        {
+            if (table_put(table, pid, name, partition, size) != 0)
+            {
+                printf("Error: Out of memory\n");
+                return -1;
+            }
+        }
+        else if (!in_keyframe && sscanf(line, "+ | %hu | %255s | %u | %u |", &pid, name, &partition, &size) == 4)
+        {
+            if (table_put(table, pid, name, partition, size) != 0)
+            {
+                printf("Error: Out of memory\n");
+                return -1;
+            }
+        }
+        else if (!in_keyframe && sscanf(line, "- | %hu |", &pid) == 1)
+        {
+            table_remove(table, pid);
+        }
+        else if (line[0] != '!' && line[0] != '+' && line[0] != '|' && line[0] != '\0')
+        {
+            printf("Error: Unexpected line at offset %zu: %s\n", offset - line_length - 1, line);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------
+// Binary status files
+// -----------------------------------------------------------
+
+// string table of a binary file: where each name is in the file, by id
+typedef struct
+{
+    const uint8_t **names;
+    uint32_t *lengths;
+    uint32_t count;
+} NameIndex;
+
+// Function to find the last full snapshot at or before a time, indexing the name definitions on the way
+/**
+ * Program names are defined once, on their first use, so every record up to the time is skipped over,
+ * but only the name definitions are kept: the rows before the keyframe are never applied.
+ * @param data Pointer to the file contents
+ * @param length Size of the file
+ * @param time Time to rebuild the table at
+ * @param names Pointer to the name index
+ * @param keyframe Pointer to the offset of the keyframe (length if every full snapshot is later)
+ * @return 0 on success, -1 if the file is malformed or the index cannot grow (the error is printed)
+ */
+static int scan_binary(const uint8_t *data, size_t length, uint64_t time, NameIndex *names, size_t *keyframe)
+{
+    *keyframe = length;
+    size_t offset = LOG_BINARY_HEADER_SIZE;
+    while (offset < length)
+    {
+        LogRecord record;
+        size_t size = log_decode_record(data + offset, length - offset, &record);
+        if (size == 0)
+        {
+            printf("Error: Truncated record at offset %zu\n", offset);
+            return -1;
+        }
+        size_t record_offset = offset;
+        offset += size;
+
+        if (record.code == LOG_DEFINE_NAME)
+        {
+            size_t padded = (record.duration + LOG_BINARY_RECORD_SIZE - 1) / LOG_BINARY_RECORD_SIZE * LOG_BINARY_RECORD_SIZE;
+            if (record.duration > LOG_EMITTER_MAX_NAME || offset + padded > length)
+            {
+                printf("Error: Truncated name definition at offset %zu\n", record_offset);
+                return -1;
+            }
+            if (record.arg >= names->count)
+            {
+                uint32_t count = (names->count == 0) ? 64 : names->count;
+                while (count <= record.arg)
+                {
+                    count *= 2;
+                }
+                const uint8_t **grown = (const uint8_t **)realloc(names->names, count * sizeof(*grown));
+                if (grown != NULL)
+                {
+                    names->names = grown;
+                }
+                uint32_t *lengths = (grown != NULL) ? (uint32_t *)realloc(names->lengths, count * sizeof(*lengths)) : NULL;
+                if (lengths == NULL)
+                {
+                    printf("Error: Out of memory\n");
+                    return -1;
+                }
+                names->lengths = lengths;
+                memset(names->names + names->count, 0, (count - names->count) * sizeof(*grown));
+                names->count = count;
+            }
+            names->names[record.arg] = data + offset;
+            names->lengths[record.arg] = record.duration;
+            offset += padded;
+        }
+        else if ((record.code == LOG_STATUS_SNAPSHOT || record.code == LOG_STATUS_DELTA) && record.time > time)
+        {
+            break;
+        }
+        else if (record.code == LOG_STATUS_SNAPSHOT)
+        {
+            *keyframe = record_offset;
+        }
+    }
+    return 0;
+}
+
+// Function to replay a binary status file from a full snapshot up to a time
+/**
+ * @param data Pointer to the file contents
+ * @param length Size of the file
+ * @param offset Offset of the full snapshot to start from
+ * @param time Time to rebuild the table at
+ * @param names Pointer to the name index built by scan_binary
+ * @param table Pointer to the table
+ * @return 0 on success, -1 if the file is malformed (the error is printed)
+ */
+static int replay_binary(const uint8_t *data, size_t length, size_t offset, uint64_t time, const NameIndex *names, Table *table)
+{
+    int result = 0;
+    while (offset < length && result == 0)
+    {
+        LogRecord record;
+        size_t size = log_decode_record(data + offset, length - offset, &record);
+        if (size == 0)
+        {
+            printf("Error: Truncated record at offset %zu\n", offset);
+            result = -1;
+            break;
+        }
+        size_t record_offset = offset;
+        offset += size;
+
+        if (record.code == LOG_DEFINE_NAME)
+        {
+            // indexed by scan_binary, and checked there
+            offset += (record.duration + LOG_BINARY_RECORD_SIZE - 1) / LOG_BINARY_RECORD_SIZE * LOG_BINARY_RECORD_SIZE;
+            continue;
+        }
+
+        if ((record.code == LOG_STATUS_SNAPSHOT || record.code == LOG_STATUS_DELTA) && record.time > time)
+        {
+            break;
+        }
+
+        if (record.code == LOG_STATUS_SNAPSHOT)
+        {
+            table_clear(table);
+            table->snapshots++;
+        }
+        else if (record.code == LOG_STATUS_DELTA)
+        {
+            table->snapshots++;
+        }
+        else if (record.code == LOG_STATUS_EXIT)
+        {
+            table_remove(table, (uint16_t)record.pid);
+        }
+        else if (record.code == LOG_STATUS_ROW)
+        {
+            if (record.name >= names->count || names->names[record.name] == NULL)
+            {
+                printf("Error: Undefined name %u at offset %zu\n", record.name, record_offset);
+                result = -1;
+                break;
+            }
+            char name[LOG_EMITTER_MAX_NAME + 1];
+            memcpy(name, names->names[record.name], names->lengths[record.name]);
+            name[names->lengths[record.name]] = '\0';
+            if (table_put(table, (uint16_t)record.pid, name, record.partition, record.arg) != 0)
+            {
+                printf("Error: Out of memory\n");
+                result = -1;
+            }
+        }
+        else if (record.code == LOG_STATUS_PAGING)
+        {
+            // paging counters say nothing about the PCB table
+        }
+        else
+        {
+            printf("Error: Unexpected record code %u at offset %zu\n", record.code, record_offset);
+            result = -1;
+        }
+    }
+    return result;
+}
+
+// Main function: sim-status <status_file> <time>
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: %s <status_file> <time>\n", argv[0]);
+        printf("Prints the PCB table as of a simulated time (ms) from a text or binary system status, full or --status-delta\n");
+        return 1;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    uint64_t time = strtoull(argv[2], &end, 10);
+    if (*argv[2] == '\0' || *argv[2] == '-' || *end != '\0' || errno != 0)
+    {
+        printf("Error: Invalid time %s\n", argv[2]);
+        return 1;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        printf("Error: Cannot open file %s\n", argv[1]);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return 1;
+    }
+    size_t length = (size_t)info.st_size;
+    const char *data = (length > 0) ? (const char *)mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (length > 0 && data == MAP_FAILED)
+    {
+        printf("Error: Cannot map file %s\n", argv[1]);
+        return 1;
+    }
+
+    Table table = {0};
+    table.index = (uint32_t *)calloc(MAX_PIDS, sizeof(uint32_t));
+    int result = 0;
+    LogKind kind;
+    if (table.index == NULL)
+    {
+        printf("Error: Out of memory\n");
+        result = -1;
+    }
+    else if (length >= strlen(LOG_BINARY_MAGIC) && memcmp(data, LOG_BINARY_MAGIC, strlen(LOG_BINARY_MAGIC)) == 0)
+    {
+        // the names are defined on their first use, possibly before the keyframe: they are indexed first
+        NameIndex names = {0};
+        size_t keyframe = length;
+        if (log_decode_header((const uint8_t *)data, length, &kind) != 0 || kind != LOG_KIND_STATUS)
+        {
+            printf("Error: Not a binary system status file\n");
+            result = -1;
+        }
+        else
+        {
+            result = scan_binary((const uint8_t *)data, length, time, &names, &keyframe);
+        }
+        if (result == 0 && keyframe < length)
+        {
+            result = replay_binary((const uint8_t *)data, length, keyframe, time, &names, &table);
+        }
+        free(names.names);
+        free(names.lengths);
+    }
+    else
+    {
+        // start from the last full snapshot in time, only the deltas after it are read
+        size_t keyframe = (length > 0) ? find_keyframe(data, length, time) : 0;
+        result = (keyframe < length) ? replay_text(data, length, keyframe, time, &table) : 0;
+    }
+
+    if (result == 0 && table.snapshots == 0)
+    {
+        printf("Error: No system status snapshot at or before %llu ms\n", (unsigned long long)time);
+        result = -1;
+    }
+    if (result == 0)
+    {
+        printf(STATUS_SNAPSHOT_HEADER, (unsigned long long)time);
+        for (size_t i = 0; i < table.count; i++)
+        {
+            const TableRow *row = &table.rows[i];
+            printf(STATUS_SNAPSHOT_ROW, row->pid, row->name, row->partition, row->size);
+        }
+        printf(STATUS_SNAPSHOT_FOOTER);
+    }
+
+    free(table.rows);
+    free(table.index);
+    if (length > 0)
+    {
+        munmap((void *)data, length);
+    }
+    return (result == 0) ? 0 : 1;
+}
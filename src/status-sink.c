@@ -0,0 +1,421 @@
+#include "status-sink.h"
+#include "sim-alloc.h"
+#include "profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// sink flushed by the signal handlers (only one sink can be registered at a time)
+static StatusSink *signal_sink = NULL;
+// set by SIGUSR1, serviced at the next snapshot boundary
+static volatile sig_atomic_t flush_requested = 0;
+
+// Function to write a whole buffer to a file descriptor
+/**
+ * @param fd File descriptor to write to
+ * @param data Pointer to the bytes to write
+ * @param length Number of bytes to write
+ */
+static void write_all(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return; // nothing sensible left to do (disk full, closed pipe, ...)
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+// Function to open the status sink, called once at startup
+/**
+ * @param sink Pointer to the sink to initialize
+ * @param path Path of the system status file (truncated on open)
+ * @param flush_every Number of snapshots between flushes (0 = only when the buffer is full and at exit)
+ * @param format Text snapshots or binary records
+ * @return 0 on success, -1 if the file cannot be opened or its buffer allocated
+ */
+int status_sink_open(StatusSink *sink, const char *path, uint32_t flush_every, LogFormat format)
+{
+    sink->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sink->fd < 0)
+    {
+        return -1;
+    }
+
+    sink->buffer = (char *)sim_malloc(STATUS_SINK_BUFFER_SIZE);
+    int result = name_table_init(&sink->names);
+    if (sink->buffer == NULL || result != 0)
+    {
+        name_table_free(&sink->names);
+        sim_free(sink->buffer);
+        sink->buffer = NULL;
+        close(sink->fd);
+        sink->fd = -1;
+        return -1;
+    }
+
+    sink->capacity = STATUS_SINK_BUFFER_SIZE;
+    sink->length = 0;
+    sink->committed = 0;
+    sink->flush_every = flush_every;
+    sink->pending = 0;
+    sink->format = format;
+    sink->keyframe_every = 0;
+    sink->snapshots = 0;
+    sink->rows = NULL;
+    sink->listed = NULL;
+    sink->current = NULL;
+    sink->changed = NULL;
+    sink->exited = NULL;
+
+    if (format == LOG_FORMAT_BINARY)
+    {
+        sink->length = log_encode_header(LOG_KIND_STATUS, (uint8_t *)sink->buffer);
+        sink->committed = (sig_atomic_t)sink->length;
+    }
+    return 0;
+}
+
+// Function to append a formatted record to the sink buffer
+/**
+ * @param sink Pointer to the sink
+ * @param format printf style format string
+ */
+void status_sink_printf(StatusSink *sink, const char *format, ...)
+{
+    // make room up front so the common case is a single vsnprintf
+    if (sink->capacity - sink->length < STATUS_SINK_MAX_RECORD)
+    {
+        status_sink_flush(sink);
+    }
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(sink->buffer + sink->length, sink->capacity - sink->length, format, args);
+    va_end(args);
+
+    if (n < 0)
+    {
+        return;
+    }
+
+    if ((size_t)n >= sink->capacity - sink->length)
+    {
+        // record larger than the space left, flush and format again
+        status_sink_flush(sink);
+        va_start(args, format);
+        n = vsnprintf(sink->buffer, sink->capacity, format, args);
+        va_end(args);
+        if (n < 0 || (size_t)n >= sink->capacity)
+        {
+            return; // a single record can never be larger than the whole buffer
+        }
+    }
+
+    sink->length += (size_t)n;
+}
+
+// Function to append a binary record to the sink buffer
+/**
+ * @param sink Pointer to the sink
+ * @param record Pointer to the record
+ */
+void status_sink_record(StatusSink *sink, const LogRecord *record)
+{
+    if (sink->capacity - sink->length < LOG_BINARY_MAX_RECORD)
+    {
+        status_sink_flush(sink);
+    }
+    sink->length += log_encode_record(record, (uint8_t *)sink->buffer + sink->length);
+}
+
+// Function to get the string table id of a program name, writing its definition the first time
+/**
+ * @param sink Pointer to the sink
+ * @param name Program name
+ * @return Id of the name in the binary status file
+ */
+uint32_t status_sink_name(StatusSink *sink, const char *name)
+{
+    uint32_t count = sink->names.count;
+    uint32_t id = name_table_intern(&sink->names, name);
+    if (id == count)
+    {
+        if (sink->capacity - sink->length < LOG_BINARY_MAX_NAME_RECORD)
+        {
+            status_sink_flush(sink);
+        }
+        sink->length += log_encode_name(id, name, (uint8_t *)sink->buffer + sink->length);
+    }
+    return id;
+}
+
+// Function to mark the end of a snapshot and apply the flush policy
+/**
+ * @param sink Pointer to the sink
+ */
+void status_sink_commit(StatusSink *sink)
+{
+    sink->committed = (sig_atomic_t)sink->length;
+    sink->pending++;
+
+    if ((sink->flush_every != 0 && sink->pending >= sink->flush_every) || flush_requested)
+    {
+        flush_requested = 0;
+        status_sink_flush(sink);
+    }
+}
+
+// Function to write everything buffered so far to the status file
+/**
+ * @param sink Pointer to the sink
+ */
+void status_sink_flush(StatusSink *sink)
+{
+    // keep the signal handlers from writing the same bytes while we are in the middle of it
+    sigset_t block, previous;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &previous);
+
+    PROFILE_START(write);
+    PROFILE_COUNT(PROFILE_STATUS_BYTES, sink->length);
+    write_all(sink->fd, sink->buffer, sink->length);
+    PROFILE_STOP(write, PROFILE_STATUS_WRITE);
+    sink->length = 0;
+    sink->committed = 0;
+    sink->pending = 0;
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+// Function to flush and close the sink at exit
+/**
+ * @param sink Pointer to the sink
+ */
+void status_sink_close(StatusSink *sink)
+{
+    if (sink->fd < 0)
+    {
+        return;
+    }
+
+    status_sink_flush(sink);
+    close(sink->fd);
+    sim_free(sink->buffer);
+    name_table_free(&sink->names);
+    sim_free(sink->rows);
+    sim_free(sink->listed);
+    sim_free(sink->current);
+    sim_free(sink->changed);
+    sim_free(sink->exited);
+    sink->fd = -1;
+    sink->buffer = NULL;
+    sink->rows = NULL;
+
+    if (signal_sink == sink)
+    {
+        signal_sink = NULL;
+    }
+}
+
+// -----------------------------------------------------------
+// Delta snapshots
+// -----------------------------------------------------------
+
+// Function to write only what changed between snapshots, with a full keyframe every few snapshots
+/**
+ * @param sink Pointer to an open sink, before its first snapshot
+ * @param keyframe_every Write every n-th snapshot in full (0 or 1 = every snapshot is full)
+ * @return 0 on success, -1 if the row tracking cannot be allocated
+ */
+int status_sink_use_deltas(StatusSink *sink, uint32_t keyframe_every)
+{
+    if (keyframe_every <= 1)
+    {
+        return 0;
+    }
+
+    // pids are 16 bits, so the tables are allocated once at their largest
+    sink->rows = (StatusRow *)sim_calloc(STATUS_SINK_MAX_PIDS, sizeof(StatusRow));
+    sink->listed = (uint16_t *)sim_malloc(STATUS_SINK_MAX_PIDS * sizeof(uint16_t));
+    sink->current = (uint16_t *)sim_malloc(STATUS_SINK_MAX_PIDS * sizeof(uint16_t));
+    sink->changed = (uint16_t *)sim_malloc(STATUS_SINK_MAX_PIDS * sizeof(uint16_t));
+    sink->exited = (uint16_t *)sim_malloc(2 * STATUS_SINK_MAX_PIDS * sizeof(uint16_t)); // a reused pid can exit and be listed again
+    if (sink->rows == NULL || sink->listed == NULL || sink->current == NULL || sink->changed == NULL || sink->exited == NULL)
+    {
+        return -1;
+    }
+
+    sink->keyframe_every = keyframe_every;
+    sink->listed_count = 0;
+    sink->current_count = 0;
+    return 0;
+}
+
+// Function to start a snapshot
+/**
+ * @param sink Pointer to the sink
+ * @return true if the snapshot is written in full, false if only its delta is
+ */
+bool status_sink_begin(StatusSink *sink)
+{
+    sink->snapshots++;
+    if (sink->keyframe_every == 0)
+    {
+        return true;
+    }
+
+    sink->current_count = 0;
+    sink->changed_count = 0;
+    sink->exited_count = 0;
+    sink->next_position = 0;
+    sink->appending = false;
+    return (sink->snapshots - 1) % sink->keyframe_every == 0;
+}
+
+// Function to list a row in the snapshot being taken, in table order
+/**
+ * Delta snapshots compare the row with the last one written for the pid.
+ * The table only appends and removes, so a pid kept from the previous snapshot comes after the kept pids before it
+ * and before any new pid: a pid out of that order was reused by a new process and is listed as gone and created.
+ * @param sink Pointer to the sink
+ * @param pid Process id
+ * @param name Program name
+ * @param partition Partition number
+ * @param size Program size
+ * @return Id of the name (binary format: written to the string table the first time)
+ */
+uint32_t status_sink_track(StatusSink *sink, uint16_t pid, const char *name, uint32_t partition, uint32_t size)
+{
+    uint32_t id = (sink->format == LOG_FORMAT_BINARY) ? status_sink_name(sink, name) : name_table_intern(&sink->names, name);
+    if (sink->keyframe_every == 0)
+    {
+        return id;
+    }
+
+    StatusRow *row = &sink->rows[pid];
+    bool listed = row->snapshot != 0 && row->snapshot + 1 == sink->snapshots;
+    bool kept = listed && !sink->appending && row->position >= sink->next_position;
+    if (kept)
+    {
+        sink->next_position = row->position + 1;
+        if (row->name != id || row->partition != partition || row->size != size)
+        {
+            sink->changed[sink->changed_count++] = pid;
+        }
+    }
+    else
+    {
+        if (listed)
+        {
+            sink->exited[sink->exited_count++] = pid; // reused pid: the old process is gone
+        }
+        sink->appending = true;
+        sink->changed[sink->changed_count++] = pid;
+    }
+
+    row->snapshot = sink->snapshots;
+    row->position = (uint32_t)sink->current_count;
+    row->name = id;
+    row->partition = partition;
+    row->size = size;
+    sink->current[sink->current_count++] = pid;
+    return id;
+}
+
+// Function to finish listing the rows of a snapshot: find the pids that are gone
+/**
+ * @param sink Pointer to the sink
+ */
+void status_sink_end(StatusSink *sink)
+{
+    if (sink->keyframe_every == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < sink->listed_count; i++)
+    {
+        uint16_t pid = sink->listed[i];
+        if (sink->rows[pid].snapshot != sink->snapshots)
+        {
+            sink->exited[sink->exited_count++] = pid;
+        }
+    }
+
+    // this snapshot is what the next one is compared with
+    uint16_t *previous = sink->listed;
+    sink->listed = sink->current;
+    sink->listed_count = sink->current_count;
+    sink->current = previous;
+    sink->current_count = 0;
+}
+
+// -----------------------------------------------------------
+// Signals
+// -----------------------------------------------------------
+
+// Function to handle SIGUSR1 (flush at the next snapshot)
+/**
+ * @param signum Signal number
+ */
+static void handle_flush_request(int signum)
+{
+    (void)signum;
+    flush_requested = 1;
+}
+
+// Function to handle SIGINT and SIGTERM (write complete snapshots, then die)
+/**
+ * @param signum Signal number
+ */
+static void handle_terminate(int signum)
+{
+    if (signal_sink != NULL && signal_sink->fd >= 0)
+    {
+        // only async-signal-safe calls in here: raw write of the committed bytes
+        write_all(signal_sink->fd, signal_sink->buffer, (size_t)signal_sink->committed);
+        signal_sink->committed = 0;
+        signal_sink->length = 0;
+    }
+
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
+
+// Function to register the sink with the signal handlers
+/**
+ * @param sink Pointer to the sink flushed on SIGUSR1, SIGINT and SIGTERM
+ */
+void status_sink_install_signals(StatusSink *sink)
+{
+    signal_sink = sink;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+
+    action.sa_handler = handle_flush_request;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    action.sa_handler = handle_terminate;
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+}
@@ -0,0 +1,99 @@
+#ifndef STATUS_SINK_H
+#define STATUS_SINK_H
+
+// configurations
+#define STATUS_SINK_DEFAULT_PATH "logs/system_status.txt"
+#define STATUS_SINK_BUFFER_SIZE (1 << 20) // 1 MiB user-space buffer
+#define STATUS_SINK_MAX_RECORD 384        // longest single formatted record (or binary name definition)
+#define STATUS_SINK_MAX_PIDS 65536        // pids are 16 bits, delta snapshots keep the last row of each
+
+// text snapshot layout, shared with the binary converter
+#define STATUS_SNAPSHOT_HEADER "!----------------------------------------------------------!\n" \
+                               "Save Time: %llu ms\n"                                            \
+                               "+-----------------------------------------------+\n"            \
+                               "| PID  | Program Name | Partition Number | Size |\n"            \
+                               "+-----------------------------------------------+\n"
+#define STATUS_SNAPSHOT_ROW "| %-4hu | %-12s | %-16u | %-4u |\n"
+#define STATUS_SNAPSHOT_FOOTER "+-----------------------------------------------+\n" \
+                               "!----------------------------------------------------------!\n"
+
+// delta snapshot layout: the rows created or changed since the previous snapshot, and the pids gone from it
+#define STATUS_DELTA_HEADER "Delta Time: %llu ms\n"
+#define STATUS_DELTA_ROW "+ | %-4hu | %-12s | %-16u | %-4u |\n"
+#define STATUS_DELTA_EXIT "- | %-4hu |\n"
+
+// paging counters written after a snapshot (--paging)
+#define STATUS_PAGING_LINE "Paging: %llu page faults, %llu TLB hits, %llu TLB misses, %u frames used\n"
+
+// includes
+#include <signal.h> // for sig_atomic_t
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <stdbool.h> // for bool
+#include "log-emitter.h"
+#include "name-table.h"
+
+// structs
+
+// last row written for a pid, what delta snapshots compare against
+typedef struct
+{
+    uint32_t snapshot;  // number of the last snapshot listing the pid (0 = never listed)
+    uint32_t position;  // place of the pid in that snapshot
+    uint32_t name;      // program name id in the sink's name table
+    uint32_t partition; // partition number
+    uint32_t size;      // program size
+} StatusRow;
+
+typedef struct
+{
+    int fd;                           // output file descriptor, opened once at startup
+    char *buffer;                     // user-space buffer holding pending snapshots
+    size_t capacity;                  // size of the buffer
+    size_t length;                    // bytes currently in the buffer
+    volatile sig_atomic_t committed;  // bytes belonging to complete snapshots (safe to write from a signal)
+    uint32_t flush_every;             // flush after this many snapshots (0 = only when full / at exit)
+    uint32_t pending;                 // snapshots written since the last flush
+    LogFormat format;                 // text snapshots or binary records
+    NameTable names;                  // binary format: program names already written to the string table (delta snapshots: every name)
+
+    // delta snapshots (status_sink_use_deltas), rows are tracked while a snapshot is taken
+    uint32_t keyframe_every;          // write every n-th snapshot in full (0 = every snapshot is full)
+    uint32_t snapshots;               // snapshots taken so far
+    StatusRow *rows;                  // last row written for every pid, indexed by pid
+    uint16_t *listed;                 // pids of the previous snapshot, in table order
+    uint16_t *current;                // pids of the snapshot being taken, in table order
+    uint16_t *changed;                // pids created or changed since the previous snapshot, in table order
+    uint16_t *exited;                 // pids of the previous snapshot that are gone (or were reused by a new process)
+    size_t listed_count;              // entries in listed
+    size_t current_count;             // entries in current
+    size_t changed_count;             // entries in changed
+    size_t exited_count;              // entries in exited
+    uint32_t next_position;           // smallest place in the previous snapshot a surviving pid can have
+    bool appending;                   // a new pid was met, every pid after it is new too
+} StatusSink;
+
+// -----------------------------------------------------------
+
+int status_sink_open(StatusSink *sink, const char *path, uint32_t flush_every, LogFormat format);
+void status_sink_printf(StatusSink *sink, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void status_sink_record(StatusSink *sink, const LogRecord *record);
+uint32_t status_sink_name(StatusSink *sink, const char *name);
+void status_sink_commit(StatusSink *sink);
+void status_sink_flush(StatusSink *sink);
+void status_sink_close(StatusSink *sink);
+
+// -----------------------------------------------------------
+
+int status_sink_use_deltas(StatusSink *sink, uint32_t keyframe_every);
+bool status_sink_begin(StatusSink *sink);
+uint32_t status_sink_track(StatusSink *sink, uint16_t pid, const char *name, uint32_t partition, uint32_t size);
+void status_sink_end(StatusSink *sink);
+
+// -----------------------------------------------------------
+
+void status_sink_install_signals(StatusSink *sink);
+
+// -----------------------------------------------------------
+
+#endif // STATUS_SINK_H
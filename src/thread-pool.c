@@ -0,0 +1,173 @@
+#include "thread-pool.h"
+#include "sim-alloc.h"
+#include <stdlib.h>
+#include <stdbool.h>
+
+// argument of a worker thread
+typedef struct
+{
+    ThreadPool *pool;
+    unsigned index;
+} Worker;
+
+// Function to take the next item of a worker's own deque
+/**
+ * @param deque Pointer to the worker's deque
+ * @param item Pointer to the item taken
+ * @return false if the deque is empty
+ */
+static bool pop_own(WorkDeque *deque, size_t *item)
+{
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->head < deque->tail;
+    if (found)
+    {
+        *item = --deque->tail;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Function to move half of another worker's items (at least one) into an empty deque
+/**
+ * Victims are tried in order after the thief, the first one with work left is robbed.
+ * @param pool Pointer to the pool
+ * @param thief Index of the worker that ran out of items
+ * @return false if every deque is empty (no more items will ever appear)
+ */
+static bool steal(ThreadPool *pool, unsigned thief)
+{
+    for (unsigned offset = 1; offset < pool->thread_count; offset++)
+    {
+        WorkDeque *victim = &pool->deques[(thief + offset) % pool->thread_count];
+
+        pthread_mutex_lock(&victim->lock);
+        size_t left = victim->tail - victim->head;
+        if (left == 0)
+        {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+
+        // the items at the head are the ones the victim would have run last
+        size_t taken = (left + 1) / 2;
+        size_t head = victim->head;
+        victim->head += taken;
+        pthread_mutex_unlock(&victim->lock);
+
+        WorkDeque *own = &pool->deques[thief];
+        pthread_mutex_lock(&own->lock);
+        own->head = head;
+        own->tail = head + taken;
+        pthread_mutex_unlock(&own->lock);
+
+        pthread_mutex_lock(&pool->steals_lock);
+        pool->steals++;
+        pthread_mutex_unlock(&pool->steals_lock);
+        return true;
+    }
+    return false;
+}
+
+// Function run by every worker thread: drain the own deque, then steal until nothing is left
+/**
+ * @param argument Pointer to the worker
+ * @return NULL
+ */
+static void *worker_main(void *argument)
+{
+    Worker *worker = (Worker *)argument;
+    ThreadPool *pool = worker->pool;
+    WorkDeque *own = &pool->deques[worker->index];
+
+    do
+    {
+        size_t item;
+        while (pop_own(own, &item))
+        {
+            pool->task(pool->context, item, worker->index);
+        }
+    } while (steal(pool, worker->index));
+    return NULL;
+}
+
+// Function to run a task for items 0 .. item_count - 1 on a pool of threads
+/**
+ * Every worker starts with an equal contiguous range, a worker that runs out steals half of what another has left.
+ * Items never create new items, so a worker that finds every deque empty is done.
+ * Nothing is lost when the pool cannot be set up: without deques the calling thread runs every item in order,
+ * and the items of a thread that cannot be started are stolen by the others.
+ * @param item_count Number of items
+ * @param thread_count Number of threads (capped at the number of items and THREAD_POOL_MAX_THREADS)
+ * @param task Function run for every item
+ * @param context Passed to the task
+ * @return Number of steals
+ */
+uint64_t thread_pool_run(size_t item_count, unsigned thread_count, ThreadPoolTask task, void *context)
+{
+    if (thread_count > THREAD_POOL_MAX_THREADS)
+    {
+        thread_count = THREAD_POOL_MAX_THREADS;
+    }
+    if (thread_count > item_count)
+    {
+        thread_count = (unsigned)item_count;
+    }
+    if (thread_count == 0)
+    {
+        return 0;
+    }
+
+    ThreadPool pool;
+    pool.deques = (WorkDeque *)sim_malloc(thread_count * sizeof(WorkDeque));
+    if (pool.deques == NULL)
+    {
+        for (size_t item = 0; item < item_count; item++)
+        {
+            task(context, item, 0);
+        }
+        return 0;
+    }
+    pool.thread_count = thread_count;
+    pool.task = task;
+    pool.context = context;
+    pool.steals = 0;
+    pthread_mutex_init(&pool.steals_lock, NULL);
+
+    for (unsigned i = 0; i < thread_count; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].head = item_count * i / thread_count;
+        pool.deques[i].tail = item_count * (i + 1) / thread_count;
+    }
+
+    // the calling thread is worker 0
+    pthread_t threads[THREAD_POOL_MAX_THREADS];
+    Worker workers[THREAD_POOL_MAX_THREADS];
+    bool started[THREAD_POOL_MAX_THREADS] = {false};
+    for (unsigned i = 0; i < thread_count; i++)
+    {
+        workers[i].pool = &pool;
+        workers[i].index = i;
+        if (i > 0)
+        {
+            started[i] = pthread_create(&threads[i], NULL, worker_main, &workers[i]) == 0;
+        }
+    }
+    worker_main(&workers[0]);
+    for (unsigned i = 1; i < thread_count; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (unsigned i = 0; i < thread_count; i++)
+    {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool.steals_lock);
+    sim_free(pool.deques);
+    return pool.steals;
+}
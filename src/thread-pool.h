@@ -0,0 +1,41 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// configurations
+#define THREAD_POOL_MAX_THREADS 256
+
+// includes
+#include <stddef.h> // for size_t
+#include <stdint.h> // for int types
+#include <pthread.h>
+
+// structs
+
+// function run for every item, worker is the index of the thread running it
+typedef void (*ThreadPoolTask)(void *context, size_t item, unsigned worker);
+
+// items still owned by one worker: [head, tail), the owner takes from the tail, thieves from the head
+typedef struct
+{
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} WorkDeque;
+
+typedef struct
+{
+    WorkDeque *deques;           // one per worker
+    unsigned thread_count;       // number of workers
+    ThreadPoolTask task;         // function run for every item
+    void *context;               // passed to the task
+    uint64_t steals;             // successful steals
+    pthread_mutex_t steals_lock; // guards steals
+} ThreadPool;
+
+// -----------------------------------------------------------
+
+uint64_t thread_pool_run(size_t item_count, unsigned thread_count, ThreadPoolTask task, void *context);
+
+// -----------------------------------------------------------
+
+#endif // THREAD_POOL_H
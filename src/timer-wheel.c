@@ -0,0 +1,207 @@
+#include "timer-wheel.h"
+#include <string.h>
+#include <assert.h>
+
+// Function to find the level a time sits on relative to the wheel's time
+/**
+ * @param now Time of the wheel
+ * @param expires Expiry of the timer (not before now)
+ * @return Level of the highest 6 bit group where the two times differ (0 if they are in the same 64 ms)
+ */
+static uint32_t level_of(uint64_t now, uint64_t expires)
+{
+    uint64_t diff = now ^ expires;
+    if (diff == 0)
+    {
+        return 0;
+    }
+    return (uint32_t)(63 - __builtin_clzll(diff)) / TIMER_WHEEL_BITS;
+}
+
+// Function to find the slot of a time on a level
+/**
+ * @param time Time
+ * @param level Level
+ * @return Slot index of the time's 6 bit group on that level
+ */
+static uint32_t slot_of(uint64_t time, uint32_t level)
+{
+    return (uint32_t)(time >> (level * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SLOTS - 1);
+}
+
+// Function to append a timer to the slot it belongs to at the wheel's time
+/**
+ * @param wheel Pointer to the timer wheel
+ * @param entry Pointer to the timer
+ */
+static void place(TimerWheel *wheel, TimerEntry *entry)
+{
+    uint32_t level = level_of(wheel->now, entry->expires);
+    uint32_t slot = slot_of(entry->expires, level);
+
+    entry->next = NULL;
+    if (wheel->slots[level][slot] == NULL)
+    {
+        wheel->slots[level][slot] = entry;
+        wheel->occupied[level] |= 1ULL << slot;
+    }
+    else
+    {
+        wheel->tails[level][slot]->next = entry;
+    }
+    wheel->tails[level][slot] = entry;
+}
+
+// Function to move the wheel's time forward, bringing the timers of the blocks it enters down a level
+/**
+ * Only the slot holding the new time can change level on each level: the timers of a level share the bits above
+ * it with the old time, and none of them expires before the new one.
+ * @param wheel Pointer to the timer wheel
+ * @param now New time (not after the next expiry)
+ */
+static void advance(TimerWheel *wheel, uint64_t now)
+{
+    if (now <= wheel->now)
+    {
+        return;
+    }
+    wheel->now = now;
+
+    // from the top down, a timer moved down is looked at again when its new level comes
+    for (uint32_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+    {
+        uint32_t slot = slot_of(now, level);
+        TimerEntry *entry = wheel->slots[level][slot];
+        if (entry == NULL)
+        {
+            continue;
+        }
+        wheel->slots[level][slot] = NULL;
+        wheel->tails[level][slot] = NULL;
+        wheel->occupied[level] &= ~(1ULL << slot);
+        while (entry != NULL)
+        {
+            TimerEntry *next = entry->next;
+            place(wheel, entry);
+            wheel->cascades++;
+            entry = next;
+        }
+    }
+}
+
+// Function to initialize an empty timer wheel
+/**
+ * @param wheel Pointer to the timer wheel
+ * @param now Time the wheel starts at
+ */
+void timer_wheel_init(TimerWheel *wheel, uint64_t now)
+{
+    memset(wheel, 0, sizeof(*wheel));
+    pool_init(&wheel->entries, sizeof(TimerEntry), TIMER_WHEEL_SLAB_SIZE);
+    wheel->now = now;
+}
+
+// Function to add a timer
+/**
+ * @param wheel Pointer to the timer wheel
+ * @param expires Time the timer fires (a time already passed fires on the next expire)
+ * @param payload Caller's data handed back when the timer fires
+ * @return 0 on success, -1 if the timer cannot be allocated
+ */
+int timer_wheel_add(TimerWheel *wheel, uint64_t expires, uint64_t payload)
+{
+    TimerEntry *entry = (TimerEntry *)pool_alloc(&wheel->entries);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    entry->expires = (expires < wheel->now) ? wheel->now : expires;
+    entry->payload = payload;
+    place(wheel, entry);
+
+    wheel->count++;
+    wheel->scheduled++;
+    wheel->peak = (wheel->count > wheel->peak) ? wheel->count : wheel->peak;
+    return 0;
+}
+
+// Function to find the time the next timer fires
+/**
+ * @param wheel Pointer to the timer wheel
+ * @param expires Pointer to the expiry of the earliest timer
+ * @return false if the wheel is empty
+ */
+bool timer_wheel_next(const TimerWheel *wheel, uint64_t *expires)
+{
+    for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (wheel->occupied[level] == 0)
+        {
+            continue;
+        }
+
+        // the timers of a level are never before the wheel's own slot on it, so there is no wrap around
+        uint64_t later = wheel->occupied[level] & (~0ULL << slot_of(wheel->now, level));
+        assert(later != 0);
+        uint32_t slot = (uint32_t)__builtin_ctzll(later);
+
+        // level 0 slots hold a single time, a higher slot spans a block of them
+        uint64_t earliest = UINT64_MAX;
+        for (const TimerEntry *entry = wheel->slots[level][slot]; entry != NULL; entry = entry->next)
+        {
+            earliest = (entry->expires < earliest) ? entry->expires : earliest;
+        }
+        *expires = earliest;
+        return true;
+    }
+    return false;
+}
+
+// Function to fire the next timer due by a given time
+/**
+ * Timers fire in expiry order, timers with the same expiry in the order they were added.
+ * @param wheel Pointer to the timer wheel
+ * @param now Current time
+ * @param expires Pointer to the expiry of the fired timer
+ * @param payload Pointer to the payload of the fired timer
+ * @return false if no timer is due (the wheel's time is moved to now)
+ */
+bool timer_wheel_expire(TimerWheel *wheel, uint64_t now, uint64_t *expires, uint64_t *payload)
+{
+    uint64_t next;
+    if (!timer_wheel_next(wheel, &next) || next > now)
+    {
+        advance(wheel, now);
+        return false;
+    }
+
+    // at its own time every timer of the next expiry is on level 0
+    advance(wheel, next);
+    uint32_t slot = slot_of(next, 0);
+    TimerEntry *entry = wheel->slots[0][slot];
+    wheel->slots[0][slot] = entry->next;
+    if (entry->next == NULL)
+    {
+        wheel->tails[0][slot] = NULL;
+        wheel->occupied[0] &= ~(1ULL << slot);
+    }
+
+    *expires = entry->expires;
+    *payload = entry->payload;
+    pool_release(&wheel->entries, entry);
+    wheel->count--;
+    return true;
+}
+
+// Function to free the timer wheel
+/**
+ * @param wheel Pointer to the timer wheel
+ */
+void timer_wheel_free(TimerWheel *wheel)
+{
+    pool_free(&wheel->entries);
+    memset(wheel->slots, 0, sizeof(wheel->slots));
+    memset(wheel->tails, 0, sizeof(wheel->tails));
+    memset(wheel->occupied, 0, sizeof(wheel->occupied));
+    wheel->count = 0;
+}
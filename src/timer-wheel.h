@@ -0,0 +1,54 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// configurations
+#define TIMER_WHEEL_BITS 6                         // slots per level = 1 << TIMER_WHEEL_BITS
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 11                      // 11 levels of 6 bits cover every 64 bit time
+#define TIMER_WHEEL_SLAB_SIZE 256                  // timers carved out of one pool slab
+
+// includes
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "pool.h"
+
+// structs
+
+typedef struct TimerEntry
+{
+    struct TimerEntry *next; // next timer of the same slot, in insertion order
+    uint64_t expires;        // time the timer fires (ms)
+    uint64_t payload;        // caller's data
+} TimerEntry;
+
+// Hierarchical timer wheel: a timer sits on the level of the highest 6 bit group where its expiry differs from
+// the wheel's time, in the slot of that group. Every timer of level 0 expires within the current 64 ms, and each
+// level only holds timers later than the ones below it, so the next expiry is found from the occupancy bits
+// without sorting. Timers move down a level as the wheel's time reaches their block.
+typedef struct
+{
+    TimerEntry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // first timer of each slot
+    TimerEntry *tails[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; // last timer of each slot, appends keep the slots FIFO
+    uint64_t occupied[TIMER_WHEEL_LEVELS];                    // bit per non-empty slot
+    uint64_t now;            // time the wheel has advanced to, no timer expires before it
+    size_t count;            // timers in the wheel
+    Pool entries;            // timer storage, fired timers are recycled
+
+    // statistics
+    uint64_t scheduled;      // timers added
+    uint64_t cascades;       // timers moved down a level
+    size_t peak;             // most timers in the wheel at once
+} TimerWheel;
+
+// -----------------------------------------------------------
+
+void timer_wheel_init(TimerWheel *wheel, uint64_t now);
+int timer_wheel_add(TimerWheel *wheel, uint64_t expires, uint64_t payload);
+bool timer_wheel_next(const TimerWheel *wheel, uint64_t *expires);
+bool timer_wheel_expire(TimerWheel *wheel, uint64_t now, uint64_t *expires, uint64_t *payload);
+void timer_wheel_free(TimerWheel *wheel);
+
+// -----------------------------------------------------------
+
+#endif // TIMER_WHEEL_H
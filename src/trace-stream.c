@@ -0,0 +1,394 @@
+#include "trace-stream.h"
+#include "sim-alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// -----------------------------------------------------------
+// Reader thread
+// -----------------------------------------------------------
+
+// Function to hand a batch of parsed events (and the names they use) to the engine
+/**
+ * Waits while the window is full.
+ * @param stream Pointer to the stream
+ * @param batch Parsed events
+ * @param count Number of events in the batch
+ * @return false if the stream is being closed or a name cannot be published (the scanner holds the error)
+ */
+static bool publish(TraceStream *stream, const TraceEvent *batch, size_t count)
+{
+    pthread_mutex_lock(&stream->lock);
+    while (!stream->stop && stream->produced + count - stream->base > TRACE_STREAM_WINDOW)
+    {
+        stream->reader_waits++;
+        pthread_cond_wait(&stream->consumed_cond, &stream->lock);
+    }
+    if (stream->stop)
+    {
+        pthread_mutex_unlock(&stream->lock);
+        return false;
+    }
+
+    // names first, so the engine can resolve every EXEC of the batch
+    while (stream->published_count < stream->reader_names.count)
+    {
+        if (stream->published_count == stream->published_capacity)
+        {
+            uint32_t capacity = (stream->published_capacity == 0) ? 16 : stream->published_capacity * 2;
+            char **published = (char **)sim_realloc(stream->published, capacity * sizeof(char *));
+            if (published == NULL)
+            {
+                break;
+            }
+            stream->published = published;
+            stream->published_capacity = capacity;
+        }
+        stream->published[stream->published_count] = sim_strdup(name_table_get(&stream->reader_names, stream->published_count));
+        if (stream->published[stream->published_count] == NULL)
+        {
+            break;
+        }
+        stream->published_count++;
+    }
+    if (stream->published_count < stream->reader_names.count)
+    {
+        // the batch is dropped, the engine sees the trace end before it
+        pthread_mutex_unlock(&stream->lock);
+        scanner_fail(&stream->scanner, "out of memory publishing program %s", name_table_get(&stream->reader_names, stream->published_count));
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        stream->window[(stream->produced + i) & (TRACE_STREAM_WINDOW - 1)] = batch[i];
+    }
+    stream->produced += count;
+    pthread_cond_signal(&stream->produced_cond);
+    pthread_mutex_unlock(&stream->lock);
+    return true;
+}
+
+// Function run by the reader thread: read the trace a chunk at a time and parse it into the window
+/**
+ * @param argument Pointer to the stream
+ * @return NULL
+ */
+static void *reader_main(void *argument)
+{
+    TraceStream *stream = (TraceStream *)argument;
+    sim_alloc_use(stream->allocator); // the engine frees what the reader allocates
+    char *chunk = (char *)sim_malloc(TRACE_STREAM_CHUNK);
+    TraceEvent batch[TRACE_STREAM_BATCH];
+    size_t batched = 0;
+    size_t kept = 0; // start of a line carried over from the previous chunk
+    bool end_of_file = false;
+    bool running = true;
+    if (chunk == NULL)
+    {
+        scanner_fail(&stream->scanner, "cannot allocate a %d byte read buffer", TRACE_STREAM_CHUNK);
+        running = false;
+    }
+
+    while (running && !end_of_file)
+    {
+        ssize_t n = read(stream->fd, chunk + kept, TRACE_STREAM_CHUNK - kept);
+        if (n < 0)
+        {
+            scanner_fail(&stream->scanner, "read error: %s", strerror(errno));
+            break;
+        }
+        end_of_file = (n == 0);
+        size_t length = kept + (size_t)n;
+
+        // only whole lines are parsed, the last partial line waits for the next chunk
+        size_t complete = length;
+        if (!end_of_file)
+        {
+            while (complete > 0 && chunk[complete - 1] != '\n')
+            {
+                complete--;
+            }
+            if (complete == 0 && length == TRACE_STREAM_CHUNK)
+            {
+                scanner_feed(&stream->scanner, chunk, length);
+                scanner_fail(&stream->scanner, "line longer than %d bytes", TRACE_STREAM_CHUNK);
+                break;
+            }
+        }
+
+        scanner_feed(&stream->scanner, chunk, complete);
+        while (running && scanner_next_line(&stream->scanner))
+        {
+            TraceEvent event = {0};
+            if (parse_trace_event(&stream->scanner, &stream->reader_names, stream->vector_count, &event) != 0)
+            {
+                running = false;
+                break;
+            }
+
+            batch[batched++] = event;
+            if (batched == TRACE_STREAM_BATCH)
+            {
+                running = publish(stream, batch, batched);
+                batched = 0;
+            }
+        }
+
+        memmove(chunk, chunk + complete, length - complete);
+        kept = length - complete;
+    }
+
+    if (running && batched > 0)
+    {
+        publish(stream, batch, batched);
+    }
+    sim_free(chunk);
+
+    pthread_mutex_lock(&stream->lock);
+    stream->done = true;
+    pthread_cond_signal(&stream->produced_cond);
+    pthread_mutex_unlock(&stream->lock);
+    return NULL;
+}
+
+// -----------------------------------------------------------
+// Engine side
+// -----------------------------------------------------------
+
+// Function to open a trace and start reading it in the background
+/**
+ * @param stream Pointer to the stream
+ * @param filename Name of the trace file (resolved like load_trace)
+ * @param programs_dir Directory of the programs named in an EXEC
+ * @param names Pointer to the name table EXEC program names are interned in (only used by the engine thread)
+ * @param vector_count Vectors in the vector table
+ * @return 0 on success, -1 if the file cannot be opened, its window allocated or its reader started (the error is printed)
+ */
+int trace_stream_open(TraceStream *stream, const char *filename, const char *programs_dir, NameTable *names, uint32_t vector_count)
+{
+    memset(stream, 0, sizeof(*stream));
+    trace_file_path(programs_dir, filename, stream->path, sizeof(stream->path));
+    stream->fd = open(stream->path, O_RDONLY);
+    if (stream->fd < 0)
+    {
+        printf("Error: Cannot open file %s\n", stream->path);
+        return -1;
+    }
+
+    stream->window = (TraceEvent *)sim_malloc(TRACE_STREAM_WINDOW * sizeof(TraceEvent));
+    if (stream->window == NULL || name_table_init(&stream->reader_names) != 0)
+    {
+        printf("Error: Cannot allocate the window of %s\n", stream->path);
+        name_table_free(&stream->reader_names);
+        sim_free(stream->window);
+        close(stream->fd);
+        return -1;
+    }
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->produced_cond, NULL);
+    pthread_cond_init(&stream->consumed_cond, NULL);
+    scanner_feed(&stream->scanner, NULL, 0);
+    stream->scanner.path = stream->path;
+    stream->names = names;
+    stream->vector_count = vector_count;
+    stream->allocator = sim_alloc_current();
+
+    if (pthread_create(&stream->reader, NULL, reader_main, stream) != 0)
+    {
+        printf("Error: Cannot start the reader thread of %s\n", stream->path);
+        name_table_free(&stream->reader_names);
+        sim_free(stream->window);
+        pthread_cond_destroy(&stream->produced_cond);
+        pthread_cond_destroy(&stream->consumed_cond);
+        pthread_mutex_destroy(&stream->lock);
+        close(stream->fd);
+        return -1;
+    }
+    return 0;
+}
+
+// Function to translate the reader's id of an EXEC program to the simulator's program id
+/**
+ * @param stream Pointer to the stream
+ * @param reader_id Id of the name in the reader's table
+ * @return Program id in the shared name table, NAME_NOT_FOUND if it cannot be allocated
+ */
+static uint32_t resolve_name(TraceStream *stream, uint32_t reader_id)
+{
+    if (reader_id < stream->id_count && stream->ids[reader_id] != 0)
+    {
+        return stream->ids[reader_id] - 1;
+    }
+
+    if (reader_id >= stream->id_count)
+    {
+        uint32_t count = (stream->id_count == 0) ? 16 : stream->id_count;
+        while (count <= reader_id)
+        {
+            count *= 2;
+        }
+        uint32_t *ids = (uint32_t *)sim_realloc(stream->ids, count * sizeof(uint32_t));
+        if (ids == NULL)
+        {
+            return NAME_NOT_FOUND;
+        }
+        stream->ids = ids;
+        memset(&stream->ids[stream->id_count], 0, (count - stream->id_count) * sizeof(uint32_t));
+        stream->id_count = count;
+    }
+
+    // the published names array can move while the reader adds names
+    pthread_mutex_lock(&stream->lock);
+    uint32_t program_id = name_table_intern(stream->names, stream->published[reader_id]);
+    pthread_mutex_unlock(&stream->lock);
+
+    if (program_id != NAME_NOT_FOUND)
+    {
+        stream->ids[reader_id] = program_id + 1;
+    }
+    return program_id;
+}
+
+// Function to get an event of the trace, waiting for the reader if it is not parsed yet
+/**
+ * Only events from the last released one on can be read.
+ * @param stream Pointer to the stream
+ * @param index Index of the event in the trace
+ * @param event Pointer to the event
+ * @return false if the trace ends before the event (or the reader failed, or an EXEC program cannot be interned)
+ */
+bool trace_stream_get(TraceStream *stream, size_t index, TraceEvent *event)
+{
+    assert(index >= stream->released);
+
+    if (index >= stream->available)
+    {
+        pthread_mutex_lock(&stream->lock);
+        while (index >= stream->produced && !stream->done)
+        {
+            // hand back the room the engine is done with before waiting on the reader
+            stream->base = stream->released;
+            pthread_cond_signal(&stream->consumed_cond);
+            stream->engine_waits++;
+            pthread_cond_wait(&stream->produced_cond, &stream->lock);
+        }
+        stream->available = stream->produced;
+        pthread_mutex_unlock(&stream->lock);
+
+        if (index >= stream->available)
+        {
+            return false;
+        }
+    }
+
+    *event = stream->window[index & (TRACE_STREAM_WINDOW - 1)];
+    stream->used = (index + 1 > stream->used) ? index + 1 : stream->used;
+    if (event->type == EVENT_EXEC)
+    {
+        event->program_id = resolve_name(stream, event->program_id);
+        if (event->program_id == NAME_NOT_FOUND)
+        {
+            stream->out_of_memory = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to tell the reader the engine no longer needs the events before an index
+/**
+ * The event at index itself is kept (a preempted CPU burst is read again).
+ * @param stream Pointer to the stream
+ * @param index Index of the event being executed
+ */
+void trace_stream_release(TraceStream *stream, size_t index)
+{
+    if (index <= stream->released)
+    {
+        return;
+    }
+    stream->released = index;
+
+    // the reader is told in steps of a quarter window, not on every event
+    if (stream->released - stream->base >= TRACE_STREAM_WINDOW / 4)
+    {
+        pthread_mutex_lock(&stream->lock);
+        stream->base = stream->released;
+        pthread_cond_signal(&stream->consumed_cond);
+        pthread_mutex_unlock(&stream->lock);
+    }
+}
+
+// Function to stop the reader once the run is over (the stream stays readable until it is closed)
+/**
+ * Nothing it shares with the engine changes afterwards, so the error and the counters are stable.
+ * @param stream Pointer to the stream
+ */
+void trace_stream_stop(TraceStream *stream)
+{
+    if (stream->joined)
+    {
+        return;
+    }
+    pthread_mutex_lock(&stream->lock);
+    stream->stop = true;
+    pthread_cond_signal(&stream->consumed_cond);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->reader, NULL);
+    stream->joined = true;
+}
+
+// Function to get the error that stopped the reader
+/**
+ * @param stream Pointer to the stream, stopped with trace_stream_stop
+ * @return "file:line:column: message", or NULL if the trace was read to the end
+ */
+const char *trace_stream_error(const TraceStream *stream)
+{
+    assert(stream->joined);
+    if (stream->out_of_memory)
+    {
+        return "out of memory interning an EXEC program";
+    }
+    return (stream->done && stream->scanner.error[0] != '\0') ? stream->scanner.error : NULL;
+}
+
+// Function to print the stream counters at the end of the run
+/**
+ * @param stream Pointer to the stream, stopped with trace_stream_stop
+ * @param out Stream to print to
+ */
+void trace_stream_report(const TraceStream *stream, FILE *out)
+{
+    // the events the engine used, what the reader had parsed ahead of it depends on thread timing
+    assert(stream->joined);
+    fprintf(out, "Trace stream: %zu events read through a %d event window, reader waited %llu times, engine waited %llu times\n",
+            stream->used, TRACE_STREAM_WINDOW, (unsigned long long)stream->reader_waits, (unsigned long long)stream->engine_waits);
+}
+
+// Function to stop the reader and free the stream
+/**
+ * @param stream Pointer to the stream
+ */
+void trace_stream_close(TraceStream *stream)
+{
+    trace_stream_stop(stream);
+
+    for (uint32_t i = 0; i < stream->published_count; i++)
+    {
+        sim_free(stream->published[i]);
+    }
+    sim_free(stream->published);
+    sim_free(stream->ids);
+    sim_free(stream->window);
+    name_table_free(&stream->reader_names);
+    pthread_cond_destroy(&stream->produced_cond);
+    pthread_cond_destroy(&stream->consumed_cond);
+    pthread_mutex_destroy(&stream->lock);
+    close(stream->fd);
+    stream->window = NULL;
+}
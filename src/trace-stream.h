@@ -0,0 +1,72 @@
+#ifndef TRACE_STREAM_H
+#define TRACE_STREAM_H
+
+// configurations
+#define TRACE_STREAM_WINDOW (1 << 16) // events held between the reader and the engine (power of two)
+#define TRACE_STREAM_CHUNK (1 << 20)  // bytes read from the file at a time, also the longest line
+#define TRACE_STREAM_BATCH 256        // events parsed before they are handed to the engine
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stddef.h>  // for size_t
+#include <stdint.h>  // for int types
+#include <stdbool.h> // for bool
+#include <pthread.h>
+#include "process-simulator.h"
+#include "name-table.h"
+#include "loader.h"
+#include "sim-alloc.h"
+
+// structs
+
+// bounded read-ahead window over a trace, filled by a background reader thread
+typedef struct TraceStream
+{
+    // shared with the reader thread, guarded by lock
+    pthread_mutex_t lock;
+    pthread_cond_t produced_cond; // signalled when events are added or the reader is done
+    pthread_cond_t consumed_cond; // signalled when room is made or the stream is closed
+    TraceEvent *window;           // ring of TRACE_STREAM_WINDOW events, event i is in slot i % TRACE_STREAM_WINDOW
+    size_t produced;              // events parsed so far (event indexes below this are in the window)
+    size_t base;                  // oldest event the engine may still read (slots below are free)
+    char **published;             // EXEC program names by reader id
+    uint32_t published_count;     // names in published
+    uint32_t published_capacity;  // allocated slots in published
+    bool done;                    // the reader reached the end of the file or an error
+    bool stop;                    // the stream is being closed, the reader gives up
+    uint64_t reader_waits;        // times the reader found the window full
+
+    // owned by the reader thread
+    pthread_t reader;
+    int fd;              // trace file
+    NameTable reader_names; // EXEC program names seen by the reader (reader ids)
+    Scanner scanner;     // tokenizer over the current chunk, keeps the line count across chunks
+    char path[4096];     // trace file name for error messages
+    const SimAllocator *allocator; // allocation hooks of the simulation, adopted by the reader thread
+    uint32_t vector_count; // vectors in the vector table
+
+    // owned by the engine thread
+    NameTable *names;     // program names shared with the simulator
+    uint32_t *ids;        // reader id -> program id + 1 (0 = not interned yet)
+    uint32_t id_count;    // allocated slots in ids
+    size_t available;     // events known to be in the window without taking the lock
+    size_t released;      // events below this are no longer needed
+    uint64_t engine_waits; // times the engine caught up with the reader
+    bool out_of_memory;   // an EXEC program name could not be interned, the trace was cut there
+    size_t used;          // events the engine has read (one past the furthest index)
+    bool joined;          // the reader has been stopped and joined
+} TraceStream;
+
+// -----------------------------------------------------------
+
+int trace_stream_open(TraceStream *stream, const char *filename, const char *programs_dir, NameTable *names, uint32_t vector_count);
+bool trace_stream_get(TraceStream *stream, size_t index, TraceEvent *event);
+void trace_stream_release(TraceStream *stream, size_t index);
+void trace_stream_stop(TraceStream *stream);
+const char *trace_stream_error(const TraceStream *stream);
+void trace_stream_report(const TraceStream *stream, FILE *out);
+void trace_stream_close(TraceStream *stream);
+
+// -----------------------------------------------------------
+
+#endif // TRACE_STREAM_H
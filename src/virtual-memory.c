@@ -0,0 +1,430 @@
+#include "virtual-memory.h"
+#include "sim-alloc.h"
+#include "program-cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static const char *policy_names[] = {"fifo", "lru", "clock", "opt"};
+
+// -----------------------------------------------------------
+// Policies
+// -----------------------------------------------------------
+
+// Function to parse the name of a replacement policy
+/**
+ * @param name Name of the policy (fifo, lru, clock or opt)
+ * @param policy Pointer to the parsed policy
+ * @return 0 on success, -1 if the name is unknown
+ */
+int virtual_memory_parse_policy(const char *name, ReplacementPolicy *policy)
+{
+    for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++)
+    {
+        if (strcmp(name, policy_names[i]) == 0)
+        {
+            *policy = (ReplacementPolicy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Function to get the name of a replacement policy
+/**
+ * @param policy Replacement policy
+ * @return Name of the policy
+ */
+const char *virtual_memory_policy_name(ReplacementPolicy policy)
+{
+    return policy_names[policy];
+}
+
+// -----------------------------------------------------------
+// Reference model
+// -----------------------------------------------------------
+
+// Function to find the pages a CPU burst touches
+/**
+ * The traces carry no addresses, so a burst touches a run of consecutive pages of the image (wrapping around), one
+ * more for every VIRTUAL_MEMORY_MS_PER_PAGE ms it runs, up to VIRTUAL_MEMORY_WORKING_SET. Every
+ * VIRTUAL_MEMORY_PHASE events of the trace share a working set at a page picked by hashing the phase, and each
+ * burst starts on its first or second page: the same event touches the same pages every time it runs, in every
+ * process running it.
+ * @param page_count Pages in the image (at least 1)
+ * @param index Index of the CPU event in the trace
+ * @param duration Duration of the burst
+ * @param first Pointer to the first page touched
+ * @return Number of pages touched
+ */
+uint32_t virtual_memory_references(uint32_t page_count, size_t index, uint32_t duration, uint32_t *first)
+{
+    uint64_t phase = ((uint64_t)(index / VIRTUAL_MEMORY_PHASE) + 1) * 0x9E3779B97F4A7C15ULL;
+    *first = (uint32_t)(((phase >> 32) + (index & 1)) % page_count);
+    uint32_t count = 1 + duration / VIRTUAL_MEMORY_MS_PER_PAGE;
+    count = (count < VIRTUAL_MEMORY_WORKING_SET) ? count : VIRTUAL_MEMORY_WORKING_SET;
+    return (count < page_count) ? count : page_count;
+}
+
+// Function to find how far ahead a process touches one of its pages again
+/**
+ * @param owner Pointer to the process owning the image
+ * @param page Page of the image
+ * @param start Index of the first trace event to look at
+ * @return Events from start to the next burst touching the page, UINT64_MAX if none does before the image is
+ *         replaced, the trace ends or VIRTUAL_MEMORY_OPT_LOOKAHEAD events have been looked at
+ */
+static uint64_t next_use(const PCB *owner, uint32_t page, size_t start)
+{
+    if (owner->program == NULL)
+    {
+        return UINT64_MAX;
+    }
+
+    TraceEvent event;
+    for (size_t distance = 0; distance < VIRTUAL_MEMORY_OPT_LOOKAHEAD && program_event(owner->program, start + distance, &event); distance++)
+    {
+        if (event.type == EVENT_EXEC)
+        {
+            break; // the image is gone after that
+        }
+        if (event.type != EVENT_CPU)
+        {
+            continue;
+        }
+        uint32_t first;
+        uint32_t count = virtual_memory_references(owner->page_count, start + distance, event.duration, &first);
+        if ((page + owner->page_count - first) % owner->page_count < count)
+        {
+            return distance;
+        }
+    }
+    return UINT64_MAX;
+}
+
+// Function to pick the frame to take from its page
+/**
+ * @param memory Pointer to the virtual memory (every frame in use)
+ * @param image Pointer to the process whose reference faulted
+ * @param index Index of the trace event making the reference
+ * @return Frame of the victim page
+ */
+static uint32_t pick_victim(VirtualMemory *memory, const PCB *image, size_t index)
+{
+    Frame *frames = memory->frames;
+    uint32_t victim = 0;
+
+    switch (memory->policy)
+    {
+    case REPLACE_FIFO:
+        for (uint32_t i = 1; i < memory->frame_count; i++)
+        {
+            victim = (frames[i].loaded < frames[victim].loaded) ? i : victim;
+        }
+        break;
+    case REPLACE_LRU:
+        for (uint32_t i = 1; i < memory->frame_count; i++)
+        {
+            victim = (frames[i].last_use < frames[victim].last_use) ? i : victim;
+        }
+        break;
+    case REPLACE_CLOCK:
+        // second chance: a referenced frame loses its bit and the hand moves on, at most one full turn
+        while (frames[memory->hand].referenced)
+        {
+            frames[memory->hand].referenced = false;
+            memory->hand = (memory->hand + 1) % memory->frame_count;
+        }
+        victim = memory->hand;
+        memory->hand = (memory->hand + 1) % memory->frame_count;
+        break;
+    case REPLACE_OPT:
+    {
+        // the process faulting is still in its burst, the others resume at their next event
+        uint64_t furthest = 0;
+        for (uint32_t i = 0; i < memory->frame_count; i++)
+        {
+            const PCB *owner = frames[i].owner;
+            uint64_t distance = next_use(owner, frames[i].page, (owner == image) ? index : owner->pc);
+            if (distance > furthest || i == 0)
+            {
+                furthest = distance;
+                victim = i;
+            }
+            if (distance == UINT64_MAX)
+            {
+                break;
+            }
+        }
+        break;
+    }
+    }
+    return victim;
+}
+
+// -----------------------------------------------------------
+// TLB
+// -----------------------------------------------------------
+
+// Function to look a page up in the TLB
+/**
+ * @param memory Pointer to the virtual memory
+ * @param pid Process owning the image
+ * @param page Page of the image
+ * @return Pointer to the entry, NULL on a miss
+ */
+static TlbEntry *tlb_find(VirtualMemory *memory, uint16_t pid, uint32_t page)
+{
+    for (uint32_t i = 0; i < memory->tlb_size; i++)
+    {
+        if (memory->tlb[i].pid == pid && memory->tlb[i].page == page)
+        {
+            return &memory->tlb[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to cache a translation, replacing an empty entry or else the least recently used one
+/**
+ * @param memory Pointer to the virtual memory
+ * @param pid Process owning the image
+ * @param page Page of the image
+ * @param frame Frame holding the page
+ */
+static void tlb_insert(VirtualMemory *memory, uint16_t pid, uint32_t page, uint32_t frame)
+{
+    TlbEntry *slot = &memory->tlb[0];
+    for (uint32_t i = 0; i < memory->tlb_size && slot->pid != 0; i++)
+    {
+        TlbEntry *entry = &memory->tlb[i];
+        slot = (entry->pid == 0 || entry->last_use < slot->last_use) ? entry : slot;
+    }
+    *slot = (TlbEntry){.pid = pid, .page = page, .frame = frame, .last_use = memory->clock};
+}
+
+// Function to drop the cached translations of an image, or of one of its pages
+/**
+ * @param memory Pointer to the virtual memory
+ * @param pid Process owning the image
+ * @param page Page to drop, UINT32_MAX for every page of the image
+ */
+static void tlb_invalidate(VirtualMemory *memory, uint16_t pid, uint32_t page)
+{
+    for (uint32_t i = 0; i < memory->tlb_size; i++)
+    {
+        TlbEntry *entry = &memory->tlb[i];
+        if (entry->pid == pid && (page == UINT32_MAX || entry->page == page))
+        {
+            entry->pid = 0;
+        }
+    }
+}
+
+// -----------------------------------------------------------
+// Virtual memory
+// -----------------------------------------------------------
+
+// Function to initialize the virtual memory with every frame free and an empty TLB
+/**
+ * @param memory Pointer to the virtual memory
+ * @param policy Page replacement policy
+ * @param frame_count Physical frames (at least 1)
+ * @param tlb_size TLB entries (at least 1)
+ * @return 0 on success, -1 if the frames or the TLB cannot be allocated (the memory can still be freed)
+ */
+int virtual_memory_init(VirtualMemory *memory, ReplacementPolicy policy, uint32_t frame_count, uint32_t tlb_size)
+{
+    memset(memory, 0, sizeof(*memory));
+    memory->policy = policy;
+    memory->frame_count = frame_count;
+    memory->tlb_size = tlb_size;
+    memory->frames = (Frame *)sim_calloc(frame_count, sizeof(Frame));
+    memory->free_frames = (uint32_t *)sim_malloc(frame_count * sizeof(uint32_t));
+    memory->tlb = (TlbEntry *)sim_calloc(tlb_size, sizeof(TlbEntry));
+    if (memory->frames == NULL || memory->free_frames == NULL || memory->tlb == NULL)
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        memory->free_frames[i] = frame_count - 1 - i;
+    }
+    memory->free_count = frame_count;
+    return 0;
+}
+
+// Function to give a process an empty page table for a new image (nothing is loaded until it is touched)
+/**
+ * @param memory Pointer to the virtual memory
+ * @param process Pointer to the process (its old image, if any, must have been released)
+ * @param size Size of the image (Mb)
+ * @return 0 on success, -1 if the page table cannot be allocated
+ */
+int virtual_memory_map(VirtualMemory *memory, PCB *process, uint32_t size)
+{
+    assert(process->page_table == NULL);
+    uint32_t page_count = (size + VIRTUAL_MEMORY_PAGE_SIZE - 1) / VIRTUAL_MEMORY_PAGE_SIZE;
+    page_count = (page_count > 0) ? page_count : 1;
+
+    process->page_table = (uint32_t *)sim_malloc(page_count * sizeof(uint32_t));
+    if (process->page_table == NULL)
+    {
+        return -1;
+    }
+    for (uint32_t page = 0; page < page_count; page++)
+    {
+        process->page_table[page] = VIRTUAL_MEMORY_NO_FRAME;
+    }
+    process->page_count = page_count;
+    memory->pages_mapped += page_count;
+    return 0;
+}
+
+// Function to free the frames and the page table of a process' image
+/**
+ * @param memory Pointer to the virtual memory
+ * @param process Pointer to the process (a process without an image is left alone)
+ */
+void virtual_memory_release(VirtualMemory *memory, PCB *process)
+{
+    if (process->page_table == NULL)
+    {
+        return;
+    }
+
+    for (uint32_t page = 0; page < process->page_count; page++)
+    {
+        uint32_t frame = process->page_table[page];
+        if (frame != VIRTUAL_MEMORY_NO_FRAME)
+        {
+            memory->frames[frame].owner = NULL;
+            memory->free_frames[memory->free_count++] = frame;
+            memory->frames_used--;
+        }
+    }
+    tlb_invalidate(memory, process->pid, UINT32_MAX);
+
+    sim_free(process->page_table);
+    process->page_table = NULL;
+    process->page_count = 0;
+}
+
+// Function to translate one reference to a page, loading the page on a fault
+/**
+ * A TLB miss walks the page table; a page not resident takes a free frame, or the frame of the victim picked by
+ * the replacement policy when none is left.
+ * @param memory Pointer to the virtual memory
+ * @param image Pointer to the process owning the image (a forked child touches its parent's)
+ * @param page Page of the image
+ * @param index Index of the trace event making the reference (the optimal policy looks ahead from it)
+ * @param access Pointer to the outcome of the reference
+ */
+void virtual_memory_access(VirtualMemory *memory, PCB *image, uint32_t page, size_t index, PageAccess *access)
+{
+    assert(image->page_table != NULL && page < image->page_count);
+    memory->clock++;
+    memset(access, 0, sizeof(*access));
+
+    TlbEntry *entry = tlb_find(memory, image->pid, page);
+    if (entry != NULL)
+    {
+        memory->tlb_hits++;
+        entry->last_use = memory->clock;
+        access->tlb_hit = true;
+        access->frame = entry->frame;
+    }
+    else
+    {
+        memory->tlb_misses++;
+        access->frame = image->page_table[page];
+        if (access->frame == VIRTUAL_MEMORY_NO_FRAME)
+        {
+            memory->faults++;
+            access->fault = true;
+            if (memory->free_count > 0)
+            {
+                access->frame = memory->free_frames[--memory->free_count];
+                memory->frames_used++;
+            }
+            else
+            {
+                access->frame = pick_victim(memory, image, index);
+                Frame *victim = &memory->frames[access->frame];
+                victim->owner->page_table[victim->page] = VIRTUAL_MEMORY_NO_FRAME;
+                tlb_invalidate(memory, victim->owner->pid, victim->page);
+                memory->evictions++;
+                access->evicted = true;
+                access->evicted_page = victim->page;
+                access->evicted_pid = victim->owner->pid;
+            }
+            image->page_table[page] = access->frame;
+            memory->frames[access->frame] = (Frame){.owner = image, .page = page, .loaded = memory->clock};
+        }
+        tlb_insert(memory, image->pid, page, access->frame);
+    }
+
+    Frame *frame = &memory->frames[access->frame];
+    frame->referenced = true;
+    frame->last_use = memory->clock;
+}
+
+// Function to add the paging counters to the system status (only when there were references since the last time)
+/**
+ * @param memory Pointer to the virtual memory
+ * @param status Pointer to the system status sink
+ * @param time Time of the snapshot the counters follow
+ */
+void virtual_memory_save_status(VirtualMemory *memory, StatusSink *status, uint64_t time)
+{
+    if (memory->clock == memory->status_clock)
+    {
+        return;
+    }
+    memory->status_clock = memory->clock;
+
+    if (status->format == LOG_FORMAT_BINARY)
+    {
+        LogRecord record = {.code = LOG_STATUS_PAGING, .time = time, .arg = (uint32_t)memory->faults, .duration = (uint32_t)memory->tlb_misses,
+                            .name = (uint32_t)memory->tlb_hits, .partition = memory->frames_used};
+        status_sink_record(status, &record);
+    }
+    else
+    {
+        status_sink_printf(status, STATUS_PAGING_LINE, (unsigned long long)memory->faults, (unsigned long long)memory->tlb_hits,
+                           (unsigned long long)memory->tlb_misses, memory->frames_used);
+    }
+    status_sink_commit(status);
+}
+
+// Function to print the paging counters at the end of the run
+/**
+ * @param memory Pointer to the virtual memory
+ * @param out Stream to print to
+ */
+void virtual_memory_report(const VirtualMemory *memory, FILE *out)
+{
+    uint64_t references = memory->tlb_hits + memory->tlb_misses;
+    fprintf(out, "Paging (%s): %u frames of %uMb, %u in use, %llu pages mapped; %llu references, %llu page faults (%.2f%%), %llu evictions\n",
+            virtual_memory_policy_name(memory->policy), memory->frame_count, VIRTUAL_MEMORY_PAGE_SIZE, memory->frames_used,
+            (unsigned long long)memory->pages_mapped, (unsigned long long)references, (unsigned long long)memory->faults,
+            (references > 0) ? 100.0 * (double)memory->faults / (double)references : 0.0, (unsigned long long)memory->evictions);
+    fprintf(out, "TLB: %u entries, %llu hits, %llu misses (%.2f%% hit rate)\n", memory->tlb_size, (unsigned long long)memory->tlb_hits,
+            (unsigned long long)memory->tlb_misses, (references > 0) ? 100.0 * (double)memory->tlb_hits / (double)references : 0.0);
+}
+
+// Function to free the frames and the TLB (the page tables go with their processes)
+/**
+ * @param memory Pointer to the virtual memory
+ */
+void virtual_memory_free(VirtualMemory *memory)
+{
+    sim_free(memory->frames);
+    sim_free(memory->free_frames);
+    sim_free(memory->tlb);
+    memory->frames = NULL;
+    memory->free_frames = NULL;
+    memory->tlb = NULL;
+}
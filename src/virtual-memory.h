@@ -0,0 +1,100 @@
+#ifndef VIRTUAL_MEMORY_H
+#define VIRTUAL_MEMORY_H
+
+// configurations
+#define VIRTUAL_MEMORY_PAGE_SIZE 1       // Mb per page and per frame (program sizes are whole Mb)
+#define VIRTUAL_MEMORY_DEFAULT_TLB 16    // TLB entries
+#define VIRTUAL_MEMORY_MAX_TLB 4096
+#define VIRTUAL_MEMORY_MS_PER_PAGE 10    // a CPU burst touches one more page of its image every 10 ms...
+#define VIRTUAL_MEMORY_WORKING_SET 4     // ...up to the pages of its working set
+#define VIRTUAL_MEMORY_PHASE 8           // trace events sharing a working set (locality phase)
+#define VIRTUAL_MEMORY_WALK_TIME 1       // ms a TLB miss spends walking the page table
+#define VIRTUAL_MEMORY_FAULT_TIME 8      // ms to bring a page in from the backing store
+#define VIRTUAL_MEMORY_EVICT_TIME 1      // ms to unmap a victim page and drop its TLB entry
+#define VIRTUAL_MEMORY_OPT_LOOKAHEAD 64  // trace events the optimal policy looks ahead in each process
+#define VIRTUAL_MEMORY_NO_FRAME UINT32_MAX
+
+// includes
+#include <stdio.h>   // for FILE
+#include <stdint.h>  // for int types
+#include <stddef.h>  // for size_t
+#include <stdbool.h> // for bool
+#include "process-simulator.h"
+
+// structs
+
+typedef enum
+{
+    REPLACE_FIFO,  // evict the page loaded first
+    REPLACE_LRU,   // evict the page used least recently
+    REPLACE_CLOCK, // second chance: the hand skips (and clears) referenced frames
+    REPLACE_OPT    // evict the page used again furthest in the future (Belady)
+} ReplacementPolicy;
+
+typedef struct
+{
+    PCB *owner;              // process whose page is in the frame, NULL if the frame is free
+    uint32_t page;           // page of the owner's image held by the frame
+    bool referenced;         // CLOCK reference bit
+    uint64_t loaded;         // FIFO: access count when the page came in
+    uint64_t last_use;       // LRU: access count of its last use
+} Frame;
+
+// fully associative TLB entry, tagged with the pid so a context switch does not flush the TLB
+typedef struct
+{
+    uint16_t pid;            // 0 for an empty entry
+    uint32_t page;
+    uint32_t frame;
+    uint64_t last_use;       // the least recently used entry is replaced on a miss
+} TlbEntry;
+
+// outcome of one memory reference
+typedef struct
+{
+    bool tlb_hit;
+    bool fault;              // the page was not resident
+    uint32_t frame;          // frame holding the page
+    bool evicted;            // the fault took the frame from another page
+    uint32_t evicted_page;
+    uint16_t evicted_pid;
+} PageAccess;
+
+typedef struct
+{
+    ReplacementPolicy policy;
+    Frame *frames;
+    uint32_t frame_count;
+    uint32_t frames_used;
+    uint32_t *free_frames;   // stack of the free frames, the lowest frame on top
+    uint32_t free_count;
+    uint32_t hand;           // CLOCK hand
+    TlbEntry *tlb;
+    uint32_t tlb_size;
+    uint64_t clock;          // memory references so far, the FIFO and LRU stamps
+
+    // statistics
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    uint64_t faults;
+    uint64_t evictions;
+    uint64_t pages_mapped;   // pages of every image mapped so far
+    uint64_t status_clock;   // references counted in the last status line (no new line until there are more)
+} VirtualMemory;
+
+// -----------------------------------------------------------
+
+int virtual_memory_parse_policy(const char *name, ReplacementPolicy *policy);
+const char *virtual_memory_policy_name(ReplacementPolicy policy);
+int virtual_memory_init(VirtualMemory *memory, ReplacementPolicy policy, uint32_t frame_count, uint32_t tlb_size);
+int virtual_memory_map(VirtualMemory *memory, PCB *process, uint32_t size);
+void virtual_memory_release(VirtualMemory *memory, PCB *process);
+uint32_t virtual_memory_references(uint32_t page_count, size_t index, uint32_t duration, uint32_t *first);
+void virtual_memory_access(VirtualMemory *memory, PCB *image, uint32_t page, size_t index, PageAccess *access);
+void virtual_memory_save_status(VirtualMemory *memory, StatusSink *status, uint64_t time);
+void virtual_memory_report(const VirtualMemory *memory, FILE *out);
+void virtual_memory_free(VirtualMemory *memory);
+
+// -----------------------------------------------------------
+
+#endif // VIRTUAL_MEMORY_H